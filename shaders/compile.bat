@@ -4,4 +4,10 @@ C:\VulkanSDK\1.3.261.1\Bin\glslc.exe C:\Users\locti\OneDrive\Documents\VisualStu
 C:\VulkanSDK\1.3.261.1\Bin\glslc.exe C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\wireframe_shader.frag -o C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\wireframe_shader.frag.spv
 C:\VulkanSDK\1.3.261.1\Bin\glslc.exe C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\point_light.vert -o C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\point_light.vert.spv
 C:\VulkanSDK\1.3.261.1\Bin\glslc.exe C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\point_light.frag -o C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\point_light.frag.spv
+C:\VulkanSDK\1.3.261.1\Bin\glslc.exe C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\particle.vert -o C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\particle.vert.spv
+C:\VulkanSDK\1.3.261.1\Bin\glslc.exe C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\particle.frag -o C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\particle.frag.spv
+C:\VulkanSDK\1.3.261.1\Bin\glslc.exe C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\gpu_particle.vert -o C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\gpu_particle.vert.spv
+C:\VulkanSDK\1.3.261.1\Bin\glslc.exe C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\gpu_particle_simulate.comp -o C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\gpu_particle_simulate.comp.spv
+C:\VulkanSDK\1.3.261.1\Bin\glslc.exe C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\gpu_particle_emit.comp -o C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\gpu_particle_emit.comp.spv
+C:\VulkanSDK\1.3.261.1\Bin\glslc.exe C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\gpu_particle_finalize.comp -o C:\Users\locti\OneDrive\Documents\VisualStudioProjects\Flatbread\shaders\gpu_particle_finalize.comp.spv
 pause
\ No newline at end of file
@@ -0,0 +1,53 @@
+#version 450
+
+#extension GL_KHR_vulkan_glsl : enable
+#extension GL_EXT_nonuniform_qualifier : enable
+
+layout (location = 0) out vec2 fragOffset;
+layout (location = 1) out vec4 fragColor;
+
+const vec2 OFFSETS[6] = vec2[](
+	vec2(-1.0,-1.0),
+	vec2( 1.0,-1.0),
+	vec2(-1.0, 1.0),
+	vec2( 1.0,-1.0),
+	vec2( 1.0, 1.0),
+	vec2(-1.0, 1.0)
+);
+
+layout(set = 0, binding = 0) uniform GlobalUBO {
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+} ubo;
+
+// Matches Particle in gpu_particle_common.glsl
+struct Particle {
+	vec2 position;
+	vec2 velocity;
+	float life;
+	float invLifetime;
+	uint color;
+	uint padding;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer ParticleBuffer {
+	Particle particles[];
+} particleBuffers[];
+
+layout(push_constant) uniform Push {
+	vec4 startColor;
+	vec4 endColor;
+	uint bufferIndex;
+	float size;
+} push;
+
+void main(){
+	Particle particle = particleBuffers[push.bufferIndex].particles[gl_InstanceIndex];
+
+	fragOffset = OFFSETS[gl_VertexIndex];
+	float age = 1.0 - particle.life * particle.invLifetime;
+	fragColor = unpackUnorm4x8(particle.color) * mix(push.startColor, push.endColor, age);
+
+	vec2 positionWorld = particle.position + fragOffset * push.size;
+	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * vec4(positionWorld, 1.0, 1.0);
+}
@@ -0,0 +1,54 @@
+// Shared by the gpu_particle shaders, must match GpuParticleRenderSystem
+
+#extension GL_EXT_nonuniform_qualifier : enable
+
+struct Particle {
+	vec2 position;
+	vec2 velocity;
+	float life;
+	float invLifetime;
+	uint color;
+	uint padding;
+};
+
+// Bindless storage buffers, see DescriptorManager::BUFFER. Both blocks alias the same binding
+layout(std430, set = 0, binding = 1) buffer ParticleBuffer {
+	Particle particles[];
+} particleBuffers[];
+
+layout(std430, set = 0, binding = 1) buffer StateBuffer {
+	// Live particles in particleBuffers[sourceBuffer] and particleBuffers[targetBuffer], indexed by source / 1 - source
+	uint alive[2];
+	uint padding0[2];
+	// VkDrawIndirectCommand
+	uint drawVertexCount;
+	uint drawInstanceCount;
+	uint drawFirstVertex;
+	uint drawFirstInstance;
+	// VkDispatchIndirectCommand of the next simulate pass
+	uint dispatchX;
+	uint dispatchY;
+	uint dispatchZ;
+	uint padding1;
+} stateBuffers[];
+
+layout(push_constant) uniform Push {
+	vec2 origin;
+	vec2 spawnExtents;
+	vec2 velocity;
+	vec2 velocityVariance;
+	vec2 acceleration;
+	float lifetime;
+	float lifetimeVariance;
+	float colorVariance;
+	float dt;
+	uint emitCount;
+	uint seed;
+	uint capacity;
+	uint source;
+	uint sourceBuffer;
+	uint targetBuffer;
+	uint stateBuffer;
+} push;
+
+const uint WORKGROUP_SIZE = 64;
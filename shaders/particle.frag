@@ -0,0 +1,14 @@
+#version 450
+
+layout (location = 0) in vec2 fragOffset;
+layout (location = 1) in vec4 fragColor;
+layout (location = 0) out vec4 outColor;
+
+void main(){
+	float dist = dot(fragOffset, fragOffset);
+	if(dist > 1) {
+		discard;
+	}
+	// Soft round particle
+	outColor = vec4(fragColor.rgb, fragColor.a * (1 - dist));
+}
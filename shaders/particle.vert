@@ -0,0 +1,50 @@
+#version 450
+
+#extension GL_KHR_vulkan_glsl : enable
+#extension GL_EXT_nonuniform_qualifier : enable
+
+layout (location = 0) out vec2 fragOffset;
+layout (location = 1) out vec4 fragColor;
+
+const vec2 OFFSETS[6] = vec2[](
+	vec2(-1.0,-1.0),
+	vec2( 1.0,-1.0),
+	vec2(-1.0, 1.0),
+	vec2( 1.0,-1.0),
+	vec2( 1.0, 1.0),
+	vec2(-1.0, 1.0)
+);
+
+layout(set = 0, binding = 0) uniform GlobalUBO {
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+} ubo;
+
+// Matches ParticleInstance in render_snapshot.h
+struct Particle {
+	vec2 position;
+	float age;
+	uint color;
+};
+
+// Bindless storage buffers, see DescriptorManager::BUFFER
+layout(std430, set = 0, binding = 1) readonly buffer ParticleBuffer {
+	Particle particles[];
+} particleBuffers[];
+
+layout(push_constant) uniform Push {
+	vec4 startColor;
+	vec4 endColor;
+	uint bufferIndex;
+	float size;
+} push;
+
+void main(){
+	Particle particle = particleBuffers[push.bufferIndex].particles[gl_InstanceIndex];
+
+	fragOffset = OFFSETS[gl_VertexIndex];
+	fragColor = unpackUnorm4x8(particle.color) * mix(push.startColor, push.endColor, particle.age);
+
+	vec2 positionWorld = particle.position + fragOffset * push.size;
+	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * vec4(positionWorld, 1.0, 1.0);
+}
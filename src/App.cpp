@@ -1,13 +1,27 @@
 #include "App.h"
 #include "engine/ecs/entity_components.h"
 #include "engine/render_system/spriteRenderSystem.h"
+#include "engine/render_system/particleRenderSystem.h"
+#include "engine/render_system/gpuParticleRenderSystem.h"
+#include "engine/spatial/spatial_hash.h"
+#include "engine/spatial/broadphase_system.h"
+#include "engine/physics/collision_system.h"
+#include "engine/physics/physics_system.h"
+#include "physicsBenchmarkScene.h"
+#include "saveBenchmark.h"
+#include "engine/ecs/save_journal.h"
 #include "keyboardController.h"
+#include "inputRecording.h"
 
 #include <initializer_list>
 #include <windows.h>
 #include <iostream>
 #include <random>
 #include <chrono>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <cstdio>
 //#include<unistd.h> for linux
 
 
@@ -30,6 +44,12 @@ App::App() {
 
 	ECSCoordiantor->Init();
 	ECSCoordiantor->RegisterComponent<TransformComponent>();
+	ECSCoordiantor->RegisterComponent<BoundsComponent>();
+	ECSCoordiantor->RegisterComponent<ColliderComponent>();
+	ECSCoordiantor->RegisterComponent<VelocityComponent>();
+	ECSCoordiantor->RegisterComponent<MassComponent>();
+	ECSCoordiantor->RegisterComponent<ParticleEmitterComponent>();
+	ECSCoordiantor->RegisterComponent<GpuParticleEmitterComponent>();
 
 	//Camera setting needs to move into its own class
 	setOrthographicProjection(-10, 10, -10, 10, 0, -10);
@@ -46,13 +66,66 @@ void App::run()
 	//signature.set(ecs.GetComponentType<TextureComponent>());
 	ECSCoordiantor->SetSystemSignature<SpriteRenderSystem>(signature);
 
+	auto broadphaseSystem = ECSCoordiantor->RegisterSystem<BroadphaseSystem>();
+	ECS::Signature boundsSignature = signature;
+	boundsSignature.set(ECSCoordiantor->GetComponentType<BoundsComponent>());
+	ECSCoordiantor->SetSystemSignature<BroadphaseSystem>(boundsSignature);
+
+	// Registered after the broadphase so it sees this step's pairs
+	auto collisionSystem = ECSCoordiantor->RegisterSystem<CollisionSystem>(broadphaseSystem);
+	ECS::Signature colliderSignature = signature;
+	colliderSignature.set(ECSCoordiantor->GetComponentType<ColliderComponent>());
+	ECSCoordiantor->SetSystemSignature<CollisionSystem>(colliderSignature);
+
+	// Resolves this step's contacts, so it comes after the collision system
+	auto physicsSystem = ECSCoordiantor->RegisterSystem<PhysicsSystem>(collisionSystem);
+	ECS::Signature bodySignature = signature;
+	bodySignature.set(ECSCoordiantor->GetComponentType<VelocityComponent>());
+	bodySignature.set(ECSCoordiantor->GetComponentType<MassComponent>());
+	ECSCoordiantor->SetSystemSignature<PhysicsSystem>(bodySignature);
+
+	// Neighbour queries over every transform for culling. Registered after the physics system so it is rebuilt from
+	// the positions the step ends with, whenever something moved
+	auto spatialHashSystem = ECSCoordiantor->RegisterSystem<SpatialHashSystem>(2.0f);
+	ECSCoordiantor->SetSystemSignature<SpatialHashSystem>(signature);
+	spriteRenderSystem->setSpatialHash(spatialHashSystem.get());
+
+	// Its pipeline needs particle.vert.spv and particle.frag.spv (shaders/compile.bat), so it only exists when a scene uses it
+	std::shared_ptr<ParticleRenderSystem> particleRenderSystem;
+	if (particleBenchmarkParticles > 0 && !gpuParticleBenchmark) {
+		particleRenderSystem = ECSCoordiantor->RegisterSystem<ParticleRenderSystem>(device, renderer.getSwapchainRenderPass(), *descriptorManager);
+		ECS::Signature emitterSignature = signature;
+		emitterSignature.set(ECSCoordiantor->GetComponentType<ParticleEmitterComponent>());
+		ECSCoordiantor->SetSystemSignature<ParticleRenderSystem>(emitterSignature);
+	}
+
+	// Same for the compute and draw pipelines of the GPU particles
+	std::shared_ptr<GpuParticleRenderSystem> gpuParticleRenderSystem;
+	if (particleBenchmarkParticles > 0 && gpuParticleBenchmark) {
+		gpuParticleRenderSystem = ECSCoordiantor->RegisterSystem<GpuParticleRenderSystem>(device, renderer.getSwapchainRenderPass(), *descriptorManager);
+		ECS::Signature gpuEmitterSignature = signature;
+		gpuEmitterSignature.set(ECSCoordiantor->GetComponentType<GpuParticleEmitterComponent>());
+		ECSCoordiantor->SetSystemSignature<GpuParticleRenderSystem>(gpuEmitterSignature);
+	}
+	ECSCoordiantor->SetBudgetOverrunCallback([](const char* systemName, const ECS::SystemStats& stats) {
+		std::cout << systemName << " went over its budget (" << stats.lastUpdateMicroseconds << "us)\n";
+	});
+
 	KeyboardMovementController kCon{};
 
-	std::srand(std::time(nullptr)); // use current time as seed for random generator
+	// A replay rebuilds the random scene of its recording
+	InputReplay replay;
+	bool replaying = !replayInputPath.empty();
+	if (replaying && !replay.open(replayInputPath.c_str())) return;
+	uint32_t seed = replaying ? replay.seed() : static_cast<uint32_t>(std::time(nullptr));
+	std::srand(seed); // use current time as seed for random generator
 	int random_value = std::rand();
 	std::cout << "Random value on [0, " << RAND_MAX << "]: " << random_value << "\n";
-	Entity removal;
-	for (int n = 0; n != 10; ++n)
+	const uint32_t spriteCount = 10;
+	std::vector<glm::vec2> translations(spriteCount);
+	std::vector<uint32_t> zOrders(spriteCount);
+	std::vector<float> rotations(spriteCount);
+	for (uint32_t n = 0; n != spriteCount; ++n)
 	{
 		int x = 11;
 		while (x > 10)
@@ -70,22 +143,163 @@ void App::run()
 		while (r > 3)
 			r = 1 + std::rand() / ((RAND_MAX + 1u));
 
-		Entity entity = ECSCoordiantor->CreateEntity();
-		if (n == 5) removal = entity;
-		TransformComponent comp{};
-		comp.setTranslation({x-5,y-5});
-		comp.setZ(z);
-		comp.setRotation(r);
-		ECSCoordiantor->AddComponent(entity, comp);
+		translations[n] = { x - 5, y - 5 };
+		zOrders[n] = z;
+		rotations[n] = r;
 		std::cout << x << " " << y << "\n";
 	}
 
+	ECS::Prefab spritePrefab = ECSCoordiantor->CreatePrefab();
+	spritePrefab.Add(TransformComponent{}).Add(BoundsComponent{}).Add(ColliderComponent::MakeAABB({ 1.0f, 1.0f }));
+	std::vector<Entity> sprites = ECSCoordiantor->Instantiate(spritePrefab, spriteCount, {
+		spritePrefab.Patch(&TransformComponent::setTranslation, translations.data()),
+		spritePrefab.Patch(&TransformComponent::setZ, zOrders.data()),
+		spritePrefab.Patch(&TransformComponent::setRotation, rotations.data())
+	});
+	Entity removal = sprites[5];
+
+	if (physicsBenchmarkBodies > 0) {
+		createPhysicsBenchmarkScene(*ECSCoordiantor, physicsBenchmarkBodies);
+	}
+	if (particleBenchmarkParticles > 0) {
+		// One emitter that keeps particleBenchmarkParticles alive once it has run for a lifetime
+		Entity emitter = ECSCoordiantor->CreateEntity();
+		ECSCoordiantor->AddComponent(emitter, TransformComponent{ 0.0f, -8.0f, 0 });
+		ParticleEmitterComponent particles{};
+		particles.capacity = particleBenchmarkParticles;
+		particles.lifetime = 2.0f;
+		particles.rate = particleBenchmarkParticles / particles.lifetime;
+		particles.velocity = { 0.0f, 12.0f };
+		particles.velocityVariance = { 4.0f, 3.0f };
+		particles.spawnExtents = { 0.5f, 0.1f };
+		particles.startColor = { 1.0f, 0.8f, 0.3f, 1.0f };
+		particles.endColor = { 0.8f, 0.1f, 0.0f, 0.0f };
+		particles.colorVariance = 0.3f;
+		particles.size = 0.03f;
+		if (gpuParticleBenchmark) {
+			GpuParticleEmitterComponent gpuParticles{};
+			static_cast<ParticleEmitterComponent&>(gpuParticles) = particles;
+			ECSCoordiantor->AddComponent(emitter, gpuParticles);
+		}
+		else {
+			ECSCoordiantor->AddComponent(emitter, particles);
+		}
+	}
+	auto lastReport = currentTime;
+
 	Entity movingEntity = ECSCoordiantor->CreateEntity();
 	TransformComponent comp{};
 	comp.setZ(1);
 	TransformComponent* added = ECSCoordiantor->AddComponent(movingEntity, comp);
+	ECSCoordiantor->AddComponent(movingEntity, BoundsComponent{});
+	ECSCoordiantor->AddComponent(movingEntity, ColliderComponent::MakeCircle(1.0f));
+
+	if (recover && !ECS::SaveJournal::Recover(*ECSCoordiantor)) {
+		std::cout << "No autosave to recover\n";
+	}
+
+	InputRecordingScene scene{};
+	scene.physicsBodies = physicsBenchmarkBodies;
+	scene.particles = particleBenchmarkParticles;
+	scene.flags = (gpuParticleBenchmark ? INPUT_SCENE_GPU_PARTICLES : 0) | (recover ? INPUT_SCENE_RECOVERED : 0);
+	if (replaying || !recordInputPath.empty()) scene.stateHash = ECSCoordiantor->StateHash();
+	if (replaying && replay.scene() != scene) {
+		const InputRecordingScene& recorded = replay.scene();
+		std::cout << "Not replaying " << replayInputPath << ", it was recorded on a different scene: " << recorded.physicsBodies
+			<< " physics bodies, " << recorded.particles << ((recorded.flags & INPUT_SCENE_GPU_PARTICLES) ? " GPU" : "") << " particles"
+			<< ((recorded.flags & INPUT_SCENE_RECOVERED) ? ", recovered" : "") << ", scene hash " << recorded.stateHash << " instead of "
+			<< scene.stateHash << "\n";
+		return;
+	}
+	ECS::SaveJournal journal{ *ECSCoordiantor };
+	std::future<bool> pendingAutosave;
+	auto lastAutosave = currentTime;
+
+	// A replay saves and loads its own file, leaving the player's save alone. While recording or replaying, Load only
+	// reads what the session saved, a save left over from earlier would not be there when the recording is replayed
+	const char* savePath = replaying ? "replayState.dat" : "gameState.dat";
+	bool sessionSavesOnly = replaying || !recordInputPath.empty();
+	bool saved = false;
+	std::future<bool> pendingSave;
+	if (replaying) std::remove(savePath);
+
+	// Everything the simulation does with one frame of input. Live frames and replayed frames go through here alike
+	float accumulator = 0.0f;
+	auto simulateFrame = [&](const InputFrame& input) {
+		accumulator += (std::min)(input.frameTime, MAX_FRAME_TIME);
+
+		if (input.pressed(InputAction::RemoveSprite)) {
+			ECSCoordiantor->DestroyEntity(removal);
+		}
+
+		// Captured between frames, encoded and written on the I/O thread
+		if (input.pressed(InputAction::Save)) {
+			pendingSave = ECSCoordiantor->SerializeAsync(savePath, [path = std::string(savePath)](bool success) {
+				std::cout << (success ? "Saved " : "Saving failed: ") << path << "\n";
+			});
+			saved = true;
+		}
+		// Deserialize waits for a save to the same path that is still being written
+		if (input.pressed(InputAction::Load)) {
+			if (sessionSavesOnly && !saved) std::cout << "Nothing saved in this session yet\n";
+			else ECSCoordiantor->Deserialize(savePath);
+		}
+
+		// Fixed step simulation
+		int steps = 0;
+		while (accumulator >= SIMULATION_STEP && steps < MAX_SIMULATION_STEPS) {
+			ECSCoordiantor->ForEachComponent<TransformComponent>([](Entity, TransformComponent& transform) {
+				transform.storePreviousState();
+			});
 
-	while (!window.shouldClose()) {
+			// controlling entity with keyboard
+			kCon.move(input, SIMULATION_STEP, movingEntity);
+			ECSCoordiantor->UpdateSystems(SIMULATION_STEP);
+
+			accumulator -= SIMULATION_STEP;
+			steps++;
+		}
+		// Fell too far behind, drop the remaining time instead of catching up
+		if (steps == MAX_SIMULATION_STEPS) accumulator = (std::min)(accumulator, SIMULATION_STEP);
+	};
+
+	if (replaying) {
+		// Headless: nothing is rendered and the window stays hidden, the frames run back to back as fast as they simulate
+		glfwHideWindow(window.window);
+		auto replayStart = std::chrono::high_resolution_clock::now();
+		InputFrame input;
+		while (replay.next(input)) {
+			simulateFrame(input);
+			if (!replay.check(*ECSCoordiantor)) break;
+		}
+		bool matched = replay.finish(*ECSCoordiantor);
+		float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - replayStart).count();
+		std::cout << "Replay: " << replay.frameCount() << " frames in " << milliseconds << "ms, "
+			<< milliseconds / (std::max)(replay.frameCount(), 1u) << "ms per frame\n";
+		if (matched) std::cout << "Replay matches the recording, " << replay.checkedHashes() << " state hashes checked\n";
+		else std::cout << "Replay diverged from the recording by frame " << replay.firstMismatch() << "\n";
+		if (pendingSave.valid()) pendingSave.wait();
+		std::remove(savePath);
+		return;
+	}
+
+	InputRecorder recorder;
+	if (!recordInputPath.empty()) recorder.open(recordInputPath.c_str(), seed, scene);
+
+	// The render thread records and submits frame N while this thread simulates frame N+1
+	std::exception_ptr renderError;
+	std::atomic<bool> renderFailed{ false };
+	std::thread renderThread([&]() {
+		try {
+			renderLoop(*spriteRenderSystem, particleRenderSystem.get(), gpuParticleRenderSystem.get());
+		}
+		catch (...) {
+			renderError = std::current_exception();
+			renderFailed = true;
+		}
+	});
+
+	while (!window.shouldClose() && !renderFailed) {
 		//Event call function can block therefore we measure the newtime after
 		glfwPollEvents();
 
@@ -94,37 +308,92 @@ void App::run()
 		float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
 		currentTime = newTime;
 
-		// controlling entity with keyboard
-		kCon.move(window.window, frameTime, movingEntity);
-		if (kCon.pressed(window.window, GLFW_KEY_Q)) {
-			ECSCoordiantor->DestroyEntity(removal);
-		}
+		InputFrame input = kCon.poll(window.window, frameTime);
+		simulateFrame(input);
+		if (recorder.isOpen()) recorder.record(input, *ECSCoordiantor);
 
-		if (kCon.pressed(window.window, GLFW_KEY_E)) {
-			ECSCoordiantor->Serialize();
+		bool report = newTime - lastReport >= std::chrono::seconds(1);
+		if (report) lastReport = newTime;
+		if (report && physicsBenchmarkBodies > 0) {
+			ECS::SystemStats stats = ECSCoordiantor->GetSystemStats<PhysicsSystem>();
+			std::cout << "Physics: " << physicsSystem->BodyCount() << " bodies, " << physicsSystem->ConstraintCount() << " contacts, "
+				<< physicsSystem->IslandCount() << " islands, " << stats.lastUpdateMicroseconds << "us per step\n";
+		}
+		// GPU particles can't be counted without reading them back
+		if (report && particleBenchmarkParticles > 0 && !gpuParticleBenchmark) {
+			ECS::SystemStats stats = ECSCoordiantor->GetSystemStats<ParticleRenderSystem>();
+			std::cout << "Particles: " << particleRenderSystem->getParticleCount() << " alive, " << stats.lastUpdateMicroseconds << "us per step\n";
+		}
+		// Reloads the world at a wall clock moment a replay can't reproduce, so it does not run while recording
+		if (report && saveBenchmark && recorder.isOpen()) {
+			std::cout << "Save benchmark skipped while recording input\n";
+			saveBenchmark = false;
 		}
-		if (kCon.pressed(window.window, GLFW_KEY_T)) {
-			ECSCoordiantor->Deserialize();
+		if (report && saveBenchmark) {
+			runSaveBenchmark(*ECSCoordiantor);
+			saveBenchmark = false;
 		}
+		// Skipped while the previous autosave is still being written instead of queueing snapshots up
+		bool autosaveDue = autosaveInterval > 0.0f && std::chrono::duration<float>(newTime - lastAutosave).count() >= autosaveInterval;
+		if (autosaveDue && (!pendingAutosave.valid() || pendingAutosave.wait_for(std::chrono::seconds(0)) == std::future_status::ready)) {
+			if (pendingAutosave.valid() && !pendingAutosave.get()) std::cout << "Autosave failed\n";
+			pendingAutosave = journal.Autosave();
+			lastAutosave = newTime;
+		}
+		float alpha = accumulator / SIMULATION_STEP;
+
+		// Render thread still draws the previous snapshot, keep simulating and polling events
+		RenderSnapshot* snapshot = snapshots.tryBeginWrite(std::chrono::milliseconds(1));
+		if (snapshot == nullptr) continue;
+
+		snapshot->projectionMatrix = projectionMatrix;
+		snapshot->viewMatrix = viewMatrix;
+		spriteRenderSystem->extract(*snapshot, alpha);
+		if (particleRenderSystem) particleRenderSystem->extract(*snapshot, alpha);
+		if (gpuParticleRenderSystem) gpuParticleRenderSystem->extract(*snapshot);
+		snapshots.publish();
+	}
+
+	if (recorder.isOpen()) recorder.close(*ECSCoordiantor);
 
+	snapshots.close();
+	renderThread.join();
+	if (renderError) std::rethrow_exception(renderError);
+}
 
+void App::renderLoop(SpriteRenderSystem& spriteRenderSystem, ParticleRenderSystem* particleRenderSystem, GpuParticleRenderSystem* gpuParticleRenderSystem)
+{
+	while (const RenderSnapshot* snapshot = snapshots.acquire()) {
 		VkCommandBuffer cmd = renderer.beginPrimaryCMD();
+		if (cmd == nullptr) {
+			// Swapchain was recreated, this snapshot is dropped
+			snapshots.release();
+			continue;
+		}
 		VkDescriptorSet set = descriptorManager->getDescriptorSet(renderer.getFrameIndex());
 		
 		UBOstruct ubo{};
-		ubo.projectionMatrix = projectionMatrix;
-		ubo.viewMatrix = viewMatrix;
+		ubo.projectionMatrix = snapshot->projectionMatrix;
+		ubo.viewMatrix = snapshot->viewMatrix;
 
 		uboBuffer->writeToBuffer(&ubo);
 		uboBuffer->flush();
 
+		// Compute work has to be recorded outside of the render pass
+		if (gpuParticleRenderSystem) gpuParticleRenderSystem->simulate(cmd, set, *snapshot);
+
 		renderer.beginSwapChainRenderPass(cmd);
 
-		spriteRenderSystem->render(cmd, set);
+		spriteRenderSystem.render(cmd, set, *snapshot);
+		if (particleRenderSystem) particleRenderSystem->render(cmd, set, renderer.getFrameIndex(), *snapshot);
+		if (gpuParticleRenderSystem) gpuParticleRenderSystem->render(cmd, set, *snapshot);
 
 		renderer.endCurrentRenderPass(cmd);
+		// Everything is recorded, the simulation thread can refill the slot while this thread submits and presents
+		snapshots.release();
 		renderer.endPrimaryCMD();
 	}
+	vkDeviceWaitIdle(Device::device());
 }
 
 void App::createUBO()
@@ -6,12 +6,18 @@
 #include "engine/descriptor_manager.h"
 #include "engine/buffer.h"
 #include "engine/ecs/entity_component_system.h"
+#include "engine/render_system/render_snapshot.h"
 
 #include <glm/glm.hpp>
+#include <string>
 
 //Max number of texture / buffer bound.
 #define DESCRIPTOR_COUNT 1000
 
+class SpriteRenderSystem;
+class ParticleRenderSystem;
+class GpuParticleRenderSystem;
+
 class App {
 public:
 	struct UBOstruct {
@@ -24,6 +30,31 @@ public:
     };
 	void run();
 	void createUBO();
+	// Adds the physics benchmark scene with this many bodies to run() and reports the step time every second
+	void setPhysicsBenchmark(uint32_t bodyCount) { physicsBenchmarkBodies = bodyCount; }
+	// Adds an emitter keeping this many particles alive to run() and reports the particle step time every second.
+	// With gpu the emitter is simulated by compute shaders instead
+	void setParticleBenchmark(uint32_t particleCount, bool gpu = false) { particleBenchmarkParticles = particleCount; gpuParticleBenchmark = gpu; }
+	// Runs runSaveBenchmark on the world once run() has simulated for a second
+	void setSaveBenchmark(bool enabled) { saveBenchmark = enabled; }
+	// Autosaves the world to autosave.dat and autosave.journal every interval seconds, 0 turns it off
+	void setAutosave(float interval) { autosaveInterval = interval; }
+	// Restores the world from the last autosave before run() starts simulating
+	void setRecover(bool enabled) { recover = enabled; }
+	// Records the input and frame times of run() to path together with the scene options, see inputRecording.h.
+	// Load then only reads what was saved during the recording, and the save benchmark is skipped
+	void setRecordInput(const std::string& path) { recordInputPath = path; }
+	// Makes run() replay the recording at path headless and as fast as possible instead of reading the keyboard,
+	// then print the replay time and whether the world still matches the recorded state hashes. Refuses recordings
+	// made with other scene options, and saves and loads replayState.dat instead of gameState.dat
+	void setReplayInput(const std::string& path) { replayInputPath = path; }
+
+	// The simulation always advances in steps of SIMULATION_STEP seconds, independent of the display rate
+	static constexpr float SIMULATION_STEP = 1.0f / 60.0f;
+	// Frame times above this are clamped and at most MAX_SIMULATION_STEPS are run per frame
+	// so that a slow frame can not cause an ever growing number of simulation steps
+	static constexpr float MAX_FRAME_TIME = 0.25f;
+	static constexpr int MAX_SIMULATION_STEPS = 8;
 private:
 	Window window{ 800, 800, "Flatbread" };
 	Device device{ window };
@@ -33,6 +64,20 @@ private:
 	std::unique_ptr<Buffer> uboBuffer;
 	//ECS::Coordinator ecs{};
 
+	// Filled by the simulation thread in run(), drawn by the render thread in renderLoop()
+	RenderSnapshotBuffer snapshots;
+	// The particle systems are null when no scene needs them
+	void renderLoop(SpriteRenderSystem& spriteRenderSystem, ParticleRenderSystem* particleRenderSystem, GpuParticleRenderSystem* gpuParticleRenderSystem);
+
+	uint32_t physicsBenchmarkBodies = 0;
+	uint32_t particleBenchmarkParticles = 0;
+	bool gpuParticleBenchmark = false;
+	bool saveBenchmark = false;
+	float autosaveInterval = 0.0f;
+	bool recover = false;
+	std::string recordInputPath;
+	std::string replayInputPath;
+
 	//Camera
     glm::mat4 viewMatrix;
     glm::mat4 projectionMatrix;
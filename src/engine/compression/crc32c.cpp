@@ -0,0 +1,179 @@
+#include "crc32c.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <nmmintrin.h>
+#define CRC32C_HARDWARE
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CRC32C_TARGET
+#else
+#include <cpuid.h>
+// Compiled for SSE4.2 on its own, only called after the CPU check
+#define CRC32C_TARGET __attribute__((target("sse4.2")))
+#endif
+#endif
+
+namespace {
+	// Reflected Castagnoli polynomial
+	constexpr uint32_t POLY = 0x82F63B78u;
+
+	struct Tables {
+		uint32_t slice[8][256];
+		// x^(2^k) mod POLY, for shifting a CRC over 2^k zero bits
+		uint32_t powers[32];
+	};
+
+	// a * b mod POLY in the reflected bit order
+	uint32_t multiplyModPoly(uint32_t a, uint32_t b)
+	{
+		uint32_t m = 1u << 31;
+		uint32_t product = 0;
+		for (;;) {
+			if (a & m) {
+				product ^= b;
+				if ((a & (m - 1)) == 0) break;
+			}
+			m >>= 1;
+			b = b & 1 ? (b >> 1) ^ POLY : b >> 1;
+		}
+		return product;
+	}
+
+	const Tables& tables()
+	{
+		static const Tables built = []() {
+			Tables t{};
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t crc = i;
+				for (int bit = 0; bit < 8; bit++) crc = crc & 1 ? (crc >> 1) ^ POLY : crc >> 1;
+				t.slice[0][i] = crc;
+			}
+			for (uint32_t i = 0; i < 256; i++) {
+				for (int s = 1; s < 8; s++) t.slice[s][i] = (t.slice[s - 1][i] >> 8) ^ t.slice[0][t.slice[s - 1][i] & 0xFF];
+			}
+			// x^1 is 0x40000000 reflected
+			uint32_t power = 1u << 30;
+			for (int k = 0; k < 32; k++) {
+				t.powers[k] = power;
+				power = multiplyModPoly(power, power);
+			}
+			return t;
+		}();
+		return built;
+	}
+
+	// x^(8 * bytes) mod POLY
+	uint32_t shiftOperator(uint64_t bytes)
+	{
+		const Tables& t = tables();
+		uint32_t op = 1u << 31;
+		uint64_t bits = bytes * 8;
+		for (int k = 0; bits != 0; k++, bits >>= 1) {
+			if (bits & 1) op = multiplyModPoly(t.powers[k % 32], op);
+		}
+		return op;
+	}
+
+	// Works on the raw register, without the inversions before and after
+	uint32_t crcTable(const unsigned char* p, size_t size, uint32_t state)
+	{
+		const Tables& t = tables();
+		while (size >= 8) {
+			uint32_t low;
+			uint32_t high;
+			std::memcpy(&low, p, 4);
+			std::memcpy(&high, p + 4, 4);
+			low ^= state;
+			state = t.slice[7][low & 0xFF] ^ t.slice[6][(low >> 8) & 0xFF] ^ t.slice[5][(low >> 16) & 0xFF] ^ t.slice[4][low >> 24] ^
+				t.slice[3][high & 0xFF] ^ t.slice[2][(high >> 8) & 0xFF] ^ t.slice[1][(high >> 16) & 0xFF] ^ t.slice[0][high >> 24];
+			p += 8;
+			size -= 8;
+		}
+		while (size-- > 0) state = (state >> 8) ^ t.slice[0][(state ^ *p++) & 0xFF];
+		return state;
+	}
+
+#ifdef CRC32C_HARDWARE
+	// Bytes per stream of the interleaved loop. The crc32 instruction has a latency of 3 cycles but a throughput of 1,
+	// so three independent streams keep it busy. Their results are joined with shiftOperator
+	constexpr size_t STREAM_BYTES = 4096;
+
+	CRC32C_TARGET uint32_t crcHardwareTail(const unsigned char* p, size_t size, uint64_t state)
+	{
+		while (size >= 8) {
+			uint64_t word;
+			std::memcpy(&word, p, 8);
+			state = _mm_crc32_u64(state, word);
+			p += 8;
+			size -= 8;
+		}
+		uint32_t state32 = static_cast<uint32_t>(state);
+		while (size-- > 0) state32 = _mm_crc32_u8(state32, *p++);
+		return state32;
+	}
+
+	CRC32C_TARGET uint32_t crcHardware(const unsigned char* p, size_t size, uint32_t state)
+	{
+		static const uint32_t shift1 = shiftOperator(STREAM_BYTES);
+		static const uint32_t shift2 = shiftOperator(2 * STREAM_BYTES);
+		while (size >= 3 * STREAM_BYTES) {
+			uint64_t a = state;
+			uint64_t b = 0;
+			uint64_t c = 0;
+			for (size_t i = 0; i < STREAM_BYTES; i += 8) {
+				uint64_t wa;
+				uint64_t wb;
+				uint64_t wc;
+				std::memcpy(&wa, p + i, 8);
+				std::memcpy(&wb, p + STREAM_BYTES + i, 8);
+				std::memcpy(&wc, p + 2 * STREAM_BYTES + i, 8);
+				a = _mm_crc32_u64(a, wa);
+				b = _mm_crc32_u64(b, wb);
+				c = _mm_crc32_u64(c, wc);
+			}
+			state = multiplyModPoly(shift2, static_cast<uint32_t>(a)) ^ multiplyModPoly(shift1, static_cast<uint32_t>(b)) ^ static_cast<uint32_t>(c);
+			p += 3 * STREAM_BYTES;
+			size -= 3 * STREAM_BYTES;
+		}
+		return crcHardwareTail(p, size, state);
+	}
+
+	bool detectHardware()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 20)) != 0;
+#else
+		unsigned int eax, ebx, ecx, edx;
+		return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSE4_2) != 0;
+#endif
+	}
+#endif
+}
+
+bool compression::crc32cHardware()
+{
+#ifdef CRC32C_HARDWARE
+	static const bool available = detectHardware();
+	return available;
+#else
+	return false;
+#endif
+}
+
+uint32_t compression::crc32c(const void* data, size_t size, uint32_t crc)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+#ifdef CRC32C_HARDWARE
+	if (crc32cHardware()) return ~crcHardware(p, size, ~crc);
+#endif
+	return ~crcTable(p, size, ~crc);
+}
+
+uint32_t compression::crc32cCombine(uint32_t crcA, uint32_t crcB, uint64_t sizeB)
+{
+	return multiplyModPoly(shiftOperator(sizeB), crcA) ^ crcB;
+}
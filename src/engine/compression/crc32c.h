@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32C (Castagnoli, the polynomial of the SSE4.2 crc32 instruction, iSCSI and ext4).
+// Uses the crc32 instruction when the CPU has it, checked once at runtime, and slicing by 8 tables otherwise.
+// Both give the same values, so checksums written on one machine verify on any other.
+namespace compression {
+	// Continues crc over size more bytes, start with 0. crc32c(b, crc32c(a)) equals the CRC of a followed by b
+	uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+
+	// CRC of a followed by b from the CRCs of both and the size of b, without touching the data
+	uint32_t crc32cCombine(uint32_t crcA, uint32_t crcB, uint64_t sizeB);
+
+	// True when crc32c runs on the crc32 instruction
+	bool crc32cHardware();
+}
@@ -0,0 +1,119 @@
+#include "filters.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FILTERS_SSE2
+#endif
+
+void compression::shuffle32(const char* src, char* dst, size_t size)
+{
+	size_t words = size / 4;
+	size_t i = 0;
+#ifdef FILTERS_SSE2
+	// 16 words per iteration, three rounds of byte interleaving transpose the 16x4 byte matrix into 2 planes per register
+	for (; i + 16 <= words; i += 16) {
+		__m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+		__m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4 + 16));
+		__m128i a2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4 + 32));
+		__m128i a3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4 + 48));
+		for (int round = 0; round < 3; round++) {
+			__m128i b0 = _mm_unpacklo_epi8(a0, a1);
+			__m128i b1 = _mm_unpackhi_epi8(a0, a1);
+			__m128i b2 = _mm_unpacklo_epi8(a2, a3);
+			__m128i b3 = _mm_unpackhi_epi8(a2, a3);
+			a0 = b0;
+			a1 = b1;
+			a2 = b2;
+			a3 = b3;
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi64(a0, a2));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + words + i), _mm_unpackhi_epi64(a0, a2));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + words * 2 + i), _mm_unpacklo_epi64(a1, a3));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + words * 3 + i), _mm_unpackhi_epi64(a1, a3));
+	}
+#endif
+	for (; i < words; i++) {
+		for (size_t b = 0; b < 4; b++) dst[b * words + i] = src[i * 4 + b];
+	}
+	if (size > words * 4) std::memcpy(dst + words * 4, src + words * 4, size - words * 4);
+}
+
+void compression::unshuffle32(const char* src, char* dst, size_t size)
+{
+	size_t words = size / 4;
+	size_t i = 0;
+#ifdef FILTERS_SSE2
+	for (; i + 16 <= words; i += 16) {
+		__m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		__m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + words + i));
+		__m128i p2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + words * 2 + i));
+		__m128i p3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + words * 3 + i));
+		// Byte b of word j sits at plane b, column j. Interleave the planes back into words
+		__m128i l01 = _mm_unpacklo_epi8(p0, p1);
+		__m128i h01 = _mm_unpackhi_epi8(p0, p1);
+		__m128i l23 = _mm_unpacklo_epi8(p2, p3);
+		__m128i h23 = _mm_unpackhi_epi8(p2, p3);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_unpacklo_epi16(l01, l23));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4 + 16), _mm_unpackhi_epi16(l01, l23));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4 + 32), _mm_unpacklo_epi16(h01, h23));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4 + 48), _mm_unpackhi_epi16(h01, h23));
+	}
+#endif
+	for (; i < words; i++) {
+		for (size_t b = 0; b < 4; b++) dst[i * 4 + b] = src[b * words + i];
+	}
+	if (size > words * 4) std::memcpy(dst + words * 4, src + words * 4, size - words * 4);
+}
+
+void compression::deltaEncode32(char* data, size_t size, uint32_t stride)
+{
+	size_t words = size / 4;
+	if (stride == 0 || words <= stride) return;
+	// Back to front so every word is subtracted from the original of its predecessor
+	size_t i = words;
+#ifdef FILTERS_SSE2
+	// Four words at once only read words that are not written yet when the stride is at least four
+	if (stride >= 4) {
+		for (; i >= stride + 4; i -= 4) {
+			char* p = data + (i - 4) * 4;
+			__m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			__m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p - stride * 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_sub_epi32(current, previous));
+		}
+	}
+#endif
+	for (; i > stride; i--) {
+		uint32_t current, previous;
+		std::memcpy(&current, data + (i - 1) * 4, 4);
+		std::memcpy(&previous, data + (i - 1 - stride) * 4, 4);
+		current -= previous;
+		std::memcpy(data + (i - 1) * 4, &current, 4);
+	}
+}
+
+void compression::deltaDecode32(char* data, size_t size, uint32_t stride)
+{
+	size_t words = size / 4;
+	if (stride == 0 || words <= stride) return;
+	size_t i = stride;
+#ifdef FILTERS_SSE2
+	// Front to back, the four predecessors are already decoded when the stride is at least four
+	if (stride >= 4) {
+		for (; i + 4 <= words; i += 4) {
+			char* p = data + i * 4;
+			__m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			__m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p - stride * 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_add_epi32(current, previous));
+		}
+	}
+#endif
+	for (; i < words; i++) {
+		uint32_t current, previous;
+		std::memcpy(&current, data + i * 4, 4);
+		std::memcpy(&previous, data + (i - stride) * 4, 4);
+		current += previous;
+		std::memcpy(data + i * 4, &current, 4);
+	}
+}
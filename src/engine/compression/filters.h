@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Reversible pre-filters that make arrays of floats and integers easier to compress with lzCompress.
+// Both work on 32 bit little endian words, a trailing partial word is left as it is.
+namespace compression {
+	// Transposes the bytes of the 32 bit words: all first bytes, then all second bytes and so on. The sign and exponent
+	// bytes of similar floats end up next to each other and form long runs
+	void shuffle32(const char* src, char* dst, size_t size);
+	void unshuffle32(const char* src, char* dst, size_t size);
+
+	// In place, replaces every word with its difference to the word stride words earlier, e.g. the same field of the
+	// previous record. Sorted IDs and repeated values become runs of small numbers
+	void deltaEncode32(char* data, size_t size, uint32_t stride);
+	void deltaDecode32(char* data, size_t size, uint32_t stride);
+}
@@ -0,0 +1,207 @@
+#include "lz.h"
+
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+	constexpr uint32_t HASH_LOG = 14;
+	constexpr size_t MIN_MATCH = 4;
+	constexpr size_t MAX_OFFSET = 65535;
+	// The last match has to end LAST_LITERALS bytes before the end and start MATCH_LIMIT bytes before it,
+	// which lets the decoder copy 8 bytes at a time without checking every byte
+	constexpr size_t LAST_LITERALS = 5;
+	constexpr size_t MATCH_LIMIT = 12;
+	// Every 2^SKIP_TRIGGER misses in a row the search step grows by one, incompressible data is skipped quickly
+	constexpr uint32_t SKIP_TRIGGER = 6;
+
+	uint32_t read32(const char* p)
+	{
+		uint32_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	uint32_t hash32(uint32_t v)
+	{
+		return (v * 2654435761u) >> (32 - HASH_LOG);
+	}
+
+	char* writeLength(char* op, size_t length)
+	{
+		while (length >= 255) {
+			*op++ = static_cast<char>(255);
+			length -= 255;
+		}
+		*op++ = static_cast<char>(length);
+		return op;
+	}
+
+	char* writeSequence(char* op, const char* literals, size_t literalLength, size_t offset, size_t matchLength)
+	{
+		char* token = op++;
+		uint8_t high = literalLength >= 15 ? 15 : static_cast<uint8_t>(literalLength);
+		if (literalLength >= 15) op = writeLength(op, literalLength - 15);
+		if (literalLength > 0) std::memcpy(op, literals, literalLength);
+		op += literalLength;
+
+		uint8_t low = 0;
+		if (offset != 0) {
+			*op++ = static_cast<char>(offset & 0xFF);
+			*op++ = static_cast<char>(offset >> 8);
+			size_t extra = matchLength - MIN_MATCH;
+			low = extra >= 15 ? 15 : static_cast<uint8_t>(extra);
+			if (extra >= 15) op = writeLength(op, extra - 15);
+		}
+		*token = static_cast<char>((high << 4) | low);
+		return op;
+	}
+
+	// Bytes from a that equal the bytes from b, a stops at end. Compares 8 bytes at a time
+	size_t matchingBytes(const char* a, const char* b, const char* end)
+	{
+		const char* start = a;
+		while (a + 8 <= end) {
+			uint64_t x, y;
+			std::memcpy(&x, a, 8);
+			std::memcpy(&y, b, 8);
+			uint64_t diff = x ^ y;
+			if (diff != 0) {
+				// Little endian, the lowest non zero byte is the first one that differs
+				while ((diff & 0xFF) == 0) {
+					diff >>= 8;
+					a++;
+				}
+				return a - start;
+			}
+			a += 8;
+			b += 8;
+		}
+		while (a < end && *a == *b) {
+			a++;
+			b++;
+		}
+		return a - start;
+	}
+
+	// Returns false when the length runs past end
+	bool readLength(const uint8_t*& ip, const uint8_t* end, size_t& length)
+	{
+		uint8_t b;
+		do {
+			if (ip >= end) return false;
+			b = *ip++;
+			length += b;
+		} while (b == 255);
+		return true;
+	}
+}
+
+size_t compression::lzCompressBound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+size_t compression::lzCompress(const char* src, size_t size, char* dst)
+{
+	char* op = dst;
+	const char* anchor = src;
+	if (size < MATCH_LIMIT + 1) {
+		return writeSequence(op, anchor, size, 0, 0) - dst;
+	}
+
+	std::vector<uint32_t> table(size_t(1) << HASH_LOG, 0);
+	const char* ip = src + 1;
+	const char* matchLimit = src + size - MATCH_LIMIT;
+	const char* matchEnd = src + size - LAST_LITERALS;
+
+	while (ip < matchLimit) {
+		// Find a 4 byte match
+		const char* match = nullptr;
+		uint32_t misses = 1u << SKIP_TRIGGER;
+		while (true) {
+			uint32_t sequence = read32(ip);
+			uint32_t h = hash32(sequence);
+			const char* candidate = src + table[h];
+			table[h] = static_cast<uint32_t>(ip - src);
+			if (candidate < ip && static_cast<size_t>(ip - candidate) <= MAX_OFFSET && read32(candidate) == sequence) {
+				match = candidate;
+				break;
+			}
+			ip += misses++ >> SKIP_TRIGGER;
+			if (ip >= matchLimit) break;
+		}
+		if (match == nullptr) break;
+
+		// Extend backwards over literals that also match
+		while (ip > anchor && match > src && ip[-1] == match[-1]) {
+			ip--;
+			match--;
+		}
+
+		const char* scan = ip + MIN_MATCH + matchingBytes(ip + MIN_MATCH, match + MIN_MATCH, matchEnd);
+		op = writeSequence(op, anchor, ip - anchor, ip - match, scan - ip);
+
+		// Index a position inside the match so the next search has a recent candidate
+		if (scan - 2 > src) table[hash32(read32(scan - 2))] = static_cast<uint32_t>(scan - 2 - src);
+		ip = scan;
+		anchor = ip;
+	}
+
+	return writeSequence(op, anchor, src + size - anchor, 0, 0) - dst;
+}
+
+bool compression::lzDecompress(const char* src, size_t size, char* dst, size_t rawSize)
+{
+	const uint8_t* ip = reinterpret_cast<const uint8_t*>(src);
+	const uint8_t* iend = ip + size;
+	char* op = dst;
+	char* oend = dst + rawSize;
+
+	while (ip < iend) {
+		uint8_t token = *ip++;
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !readLength(ip, iend, literalLength)) return false;
+		if (literalLength > static_cast<size_t>(iend - ip) || literalLength > static_cast<size_t>(oend - op)) return false;
+		if (literalLength > 0) std::memcpy(op, ip, literalLength);
+		ip += literalLength;
+		op += literalLength;
+
+		// The last sequence ends after its literals
+		if (ip == iend) break;
+
+		if (iend - ip < 2) return false;
+		size_t offset = ip[0] | (size_t(ip[1]) << 8);
+		ip += 2;
+		if (offset == 0 || offset > static_cast<size_t>(op - dst)) return false;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !readLength(ip, iend, matchLength)) return false;
+		matchLength += MIN_MATCH;
+		if (matchLength > static_cast<size_t>(oend - op)) return false;
+
+		const char* match = op - offset;
+		char* end = op + matchLength;
+		// A short offset repeats a pattern. Copying the pattern after itself doubles the distance until 8 byte copies
+		// no longer overlap, any multiple of the offset repeats the same pattern
+		while (op < end && static_cast<size_t>(op - match) < 8) {
+			size_t chunk = (std::min)(static_cast<size_t>(op - match), static_cast<size_t>(end - op));
+			std::memcpy(op, match, chunk);
+			op += chunk;
+		}
+		if (oend - end >= 8) {
+			// The last copy may run up to 7 bytes past the match, which stays inside dst and is overwritten later
+			while (op < end) {
+				std::memcpy(op, match, 8);
+				op += 8;
+				match += 8;
+			}
+			op = end;
+		}
+		else {
+			while (op < end) *op++ = *match++;
+		}
+	}
+	return op == oend;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// LZ4 style block codec: greedy matching on 4 byte sequences through a hash table, no entropy coding, so both
+// directions run at memory speed. A block is a series of sequences, each a token byte (literal length in the high
+// nibble, match length - 4 in the low nibble, 15 meaning more length bytes follow), the literals, a 16 bit little
+// endian match offset and the extra match length bytes. The last sequence has literals only.
+namespace compression {
+	// Largest possible output of lzCompress for size input bytes
+	size_t lzCompressBound(size_t size);
+
+	// Returns the number of bytes written to dst, which must hold lzCompressBound(size) bytes
+	size_t lzCompress(const char* src, size_t size, char* dst);
+
+	// Decodes exactly rawSize bytes into dst. Returns false for corrupt input, never reads or writes out of bounds
+	bool lzDecompress(const char* src, size_t size, char* dst, size_t rawSize);
+}
@@ -0,0 +1,45 @@
+#include "cpu_features.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace {
+	bool detectAvx2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+		__cpuid(info, 1);
+		// The OS has to save the YMM registers on context switches
+		bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+		__cpuidex(info, 7, 0);
+		return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+		unsigned int eax, ebx, ecx, edx;
+		if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || (ecx & bit_OSXSAVE) == 0) return false;
+		// The OS has to save the YMM registers on context switches
+		unsigned int xcr0Low, xcr0High;
+		__asm__("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+		if ((xcr0Low & 6) != 6) return false;
+		return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_AVX2) != 0;
+#endif
+	}
+}
+
+bool cpuHasAvx2()
+{
+	static const bool available = detectAvx2();
+	return available;
+}
+#else
+bool cpuHasAvx2()
+{
+	return false;
+}
+#endif
@@ -0,0 +1,5 @@
+#pragma once
+
+// Instruction sets that are picked at runtime. The build only assumes SSE2, code for newer sets is compiled into
+// functions of its own (target attribute on GCC and Clang, plain intrinsics on MSVC) and called after this check
+bool cpuHasAvx2();
@@ -0,0 +1,125 @@
+#include "component_reflection.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+namespace {
+    uint32_t ScalarSize(ECS::SaveFieldType type)
+    {
+        switch (type) {
+        case ECS::SaveFieldType::Float32:
+        case ECS::SaveFieldType::Int32:
+        case ECS::SaveFieldType::UInt32:
+            return 4;
+        case ECS::SaveFieldType::Int8:
+        case ECS::SaveFieldType::UInt8:
+        case ECS::SaveFieldType::Bool:
+            return 1;
+        default:
+            return 0;
+        }
+    }
+
+    double ReadScalar(const char* at, ECS::SaveFieldType type)
+    {
+        switch (type) {
+        case ECS::SaveFieldType::Float32: { float v; std::memcpy(&v, at, 4); return v; }
+        case ECS::SaveFieldType::Int32: { int32_t v; std::memcpy(&v, at, 4); return v; }
+        case ECS::SaveFieldType::UInt32: { uint32_t v; std::memcpy(&v, at, 4); return v; }
+        case ECS::SaveFieldType::Int8: return static_cast<int8_t>(*at);
+        case ECS::SaveFieldType::UInt8: return static_cast<uint8_t>(*at);
+        case ECS::SaveFieldType::Bool: return *at != 0 ? 1.0 : 0.0;
+        default: return 0.0;
+        }
+    }
+
+    // Integers saturate instead of wrapping, NaN becomes 0
+    template<typename I>
+    I Saturate(double value)
+    {
+        if (!(value == value)) return 0;
+        double low = static_cast<double>(std::numeric_limits<I>::min());
+        double high = static_cast<double>(std::numeric_limits<I>::max());
+        return static_cast<I>(std::min(std::max(std::trunc(value), low), high));
+    }
+
+    void WriteScalar(char* at, ECS::SaveFieldType type, double value)
+    {
+        switch (type) {
+        case ECS::SaveFieldType::Float32: { float v = static_cast<float>(value); std::memcpy(at, &v, 4); break; }
+        case ECS::SaveFieldType::Int32: { int32_t v = Saturate<int32_t>(value); std::memcpy(at, &v, 4); break; }
+        case ECS::SaveFieldType::UInt32: { uint32_t v = Saturate<uint32_t>(value); std::memcpy(at, &v, 4); break; }
+        case ECS::SaveFieldType::Int8: *at = static_cast<char>(Saturate<int8_t>(value)); break;
+        case ECS::SaveFieldType::UInt8: *at = static_cast<char>(Saturate<uint8_t>(value)); break;
+        case ECS::SaveFieldType::Bool: *at = value != 0.0 ? 1 : 0; break;
+        default: break;
+        }
+    }
+}
+
+ECS::RecordConversion::RecordConversion(const SaveFieldEntry* saved, uint32_t savedCount, uint32_t savedRecordSize,
+    const std::vector<SaveFieldEntry>& current, uint32_t recordSize, std::vector<char> defaultRecord) :
+    inputSize{ savedRecordSize },
+    outputSize{ recordSize },
+    defaults{ std::move(defaultRecord) }
+{
+    for (const SaveFieldEntry& field : current) {
+        const SaveFieldEntry* match = nullptr;
+        for (uint32_t i = 0; i < savedCount && match == nullptr; i++) {
+            if (std::strncmp(saved[i].name, field.name, SAVE_FIELD_NAME_SIZE) == 0) match = &saved[i];
+        }
+        // Fields the caller could not check are treated as missing
+        if (match == nullptr || match->offset > savedRecordSize || match->size > savedRecordSize - match->offset) continue;
+
+        if (match->type == field.type) {
+            // Equal fields, or vectors and arrays that kept their type but not their length
+            uint32_t size = std::min(match->size, field.size);
+            if (field.type == SaveFieldType::Opaque && match->size != field.size) continue;
+            copies.push_back({ match->offset, field.offset, size });
+        }
+        else {
+            uint32_t fromScalar = ScalarSize(match->type);
+            uint32_t toScalar = ScalarSize(field.type);
+            if (fromScalar == 0 || toScalar == 0) continue;
+            uint32_t lanes = std::min(match->size / fromScalar, field.size / toScalar);
+            if (lanes > 0) converts.push_back({ match->offset, field.offset, match->type, field.type, lanes });
+        }
+    }
+
+    // Fields that stayed next to each other in both layouts are copied together
+    std::sort(copies.begin(), copies.end(), [](const Copy& a, const Copy& b) { return a.to < b.to; });
+    std::vector<Copy> merged;
+    for (const Copy& copy : copies) {
+        if (!merged.empty() && merged.back().from + merged.back().size == copy.from && merged.back().to + merged.back().size == copy.to) {
+            merged.back().size += copy.size;
+        }
+        else {
+            merged.push_back(copy);
+        }
+    }
+    copies = std::move(merged);
+}
+
+void ECS::RecordConversion::Run(const char* input, uint32_t count, char* output) const
+{
+    // One pass over the whole array per step, starting from default components
+    for (uint32_t i = 0; i < count; i++) std::memcpy(output + uint64_t(i) * outputSize, defaults.data(), outputSize);
+    for (const Copy& copy : copies) {
+        for (uint32_t i = 0; i < count; i++) {
+            std::memcpy(output + uint64_t(i) * outputSize + copy.to, input + uint64_t(i) * inputSize + copy.from, copy.size);
+        }
+    }
+    for (const Convert& convert : converts) {
+        uint32_t fromScalar = ScalarSize(convert.fromType);
+        uint32_t toScalar = ScalarSize(convert.toType);
+        for (uint32_t i = 0; i < count; i++) {
+            const char* from = input + uint64_t(i) * inputSize + convert.from;
+            char* to = output + uint64_t(i) * outputSize + convert.to;
+            for (uint32_t lane = 0; lane < convert.lanes; lane++) {
+                WriteScalar(to + lane * toScalar, convert.toType, ReadScalar(from + lane * fromScalar, convert.fromType));
+            }
+        }
+    }
+}
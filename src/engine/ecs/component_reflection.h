@@ -0,0 +1,210 @@
+#pragma once
+#include "save_format.h"
+
+#include <glm/glm.hpp>
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+// Compile time description of the fields of a component. Inside the component
+//     REFLECT_COMPONENT(VelocityComponent, linear, angular)
+// lists the fields that make up its save record, in record order. Fields that are left out are not saved.
+// Reflected components must be standard layout so offsetof works on them.
+// The save file carries the field list next to the records, so a save stays loadable after fields are added,
+// removed, reordered or change type, see RecordConversion.
+namespace ECS {
+	struct FieldInfo {
+		const char* name;
+		// Offset in the component
+		uint32_t offset;
+		uint32_t size;
+		SaveFieldType type;
+	};
+
+	template<typename F>
+	struct GlmVectorScalar { using type = void; };
+
+	template<> struct GlmVectorScalar<glm::vec2> { using type = float; };
+	template<> struct GlmVectorScalar<glm::vec3> { using type = float; };
+	template<> struct GlmVectorScalar<glm::vec4> { using type = float; };
+
+	// Type of the scalars a field is made of, arrays and glm vectors are made of their elements
+	template<typename F>
+	constexpr SaveFieldType FieldTypeOf()
+	{
+		if constexpr (std::is_array<F>::value) return FieldTypeOf<std::remove_all_extents_t<F>>();
+		else if constexpr (!std::is_void<typename GlmVectorScalar<F>::type>::value) return FieldTypeOf<typename GlmVectorScalar<F>::type>();
+		else if constexpr (std::is_enum<F>::value) return FieldTypeOf<std::underlying_type_t<F>>();
+		else if constexpr (std::is_same<F, float>::value) return SaveFieldType::Float32;
+		else if constexpr (std::is_same<F, bool>::value) return SaveFieldType::Bool;
+		else if constexpr (std::is_integral<F>::value && sizeof(F) == 4) return std::is_signed<F>::value ? SaveFieldType::Int32 : SaveFieldType::UInt32;
+		else if constexpr (std::is_integral<F>::value && sizeof(F) == 1) return std::is_signed<F>::value ? SaveFieldType::Int8 : SaveFieldType::UInt8;
+		else return SaveFieldType::Opaque;
+	}
+
+	template<typename F>
+	constexpr FieldInfo MakeFieldInfo(const char* name, size_t offset)
+	{
+		static_assert(std::is_trivially_copyable<F>::value, "Reflected fields are copied byte for byte");
+		return { name, static_cast<uint32_t>(offset), static_cast<uint32_t>(sizeof(F)), FieldTypeOf<F>() };
+	}
+
+	template<typename... Fields>
+	constexpr std::array<FieldInfo, sizeof...(Fields)> MakeFieldList(Fields... fields) { return { fields... }; }
+
+	template<typename T, typename = void>
+	struct IsReflected : std::false_type {};
+
+	template<typename T>
+	struct IsReflected<T, std::void_t<decltype(T::ReflectedFields())>> : std::true_type {};
+
+	// A reflected component may also declare
+	//     void OnLoaded();
+	// which runs after its fields were read from a save record
+	template<typename T, typename = void>
+	struct HasOnLoaded : std::false_type {};
+
+	template<typename T>
+	struct HasOnLoaded<T, std::void_t<decltype(std::declval<T&>().OnLoaded())>> : std::true_type {};
+
+	// The save record packs the reflected fields back to back
+	template<typename T>
+	constexpr uint32_t ReflectedRecordSize()
+	{
+		uint32_t size = 0;
+		for (const FieldInfo& field : T::ReflectedFields()) size += field.size;
+		return size;
+	}
+
+	// True when the record is the component byte for byte, so whole arrays of them can be copied at once
+	template<typename T>
+	constexpr bool ReflectionCoversLayout()
+	{
+		uint32_t offset = 0;
+		for (const FieldInfo& field : T::ReflectedFields()) {
+			if (field.offset != offset) return false;
+			offset += field.size;
+		}
+		return offset == sizeof(T);
+	}
+
+	// Offset of the field in the save record of T
+	template<typename T>
+	constexpr uint32_t ReflectedRecordOffset(uint32_t index)
+	{
+		uint32_t offset = 0;
+		for (uint32_t i = 0; i < index; i++) offset += T::ReflectedFields()[i].size;
+		return offset;
+	}
+
+	// Field list as it is stored in a save, offsets are record offsets
+	template<typename T>
+	std::vector<SaveFieldEntry> ReflectedRecordLayout()
+	{
+		constexpr auto fields = T::ReflectedFields();
+		std::vector<SaveFieldEntry> layout(fields.size());
+		for (uint32_t i = 0; i < fields.size(); i++) {
+			SaveFieldEntry& entry = layout[i];
+			for (uint32_t c = 0; c < SAVE_FIELD_NAME_SIZE - 1 && fields[i].name[c] != '\0'; c++) entry.name[c] = fields[i].name[c];
+			entry.type = fields[i].type;
+			entry.offset = ReflectedRecordOffset<T>(i);
+			entry.size = fields[i].size;
+		}
+		return layout;
+	}
+
+	// One memcpy per field with the offsets and sizes known at compile time, so each becomes a plain load and store
+	template<typename T, size_t... I>
+	void WriteReflectedFields(const char* base, char* record, std::index_sequence<I...>)
+	{
+		constexpr auto fields = T::ReflectedFields();
+		(std::memcpy(record + ReflectedRecordOffset<T>(I), base + fields[I].offset, fields[I].size), ...);
+	}
+
+	template<typename T, size_t... I>
+	void ReadReflectedFields(char* base, const char* record, std::index_sequence<I...>)
+	{
+		constexpr auto fields = T::ReflectedFields();
+		(std::memcpy(base + fields[I].offset, record + ReflectedRecordOffset<T>(I), fields[I].size), ...);
+	}
+
+	template<typename T>
+	void WriteReflectedRecord(const T& component, char* record)
+	{
+		WriteReflectedFields<T>(reinterpret_cast<const char*>(&component), record, std::make_index_sequence<T::ReflectedFields().size()>());
+	}
+
+	template<typename T>
+	void ReadReflectedRecord(T& component, const char* record)
+	{
+		ReadReflectedFields<T>(reinterpret_cast<char*>(&component), record, std::make_index_sequence<T::ReflectedFields().size()>());
+	}
+
+	// Turns records saved with one field list into records of another. Fields are matched by name: equal fields are
+	// copied, numeric fields that changed type are converted lane by lane, vectors that grew or shrank keep their
+	// common lanes and everything else gets the value of a default constructed component.
+	// Built once per loaded block and then run over all of its records
+	class RecordConversion {
+	public:
+		RecordConversion(const SaveFieldEntry* saved, uint32_t savedCount, uint32_t savedRecordSize,
+			const std::vector<SaveFieldEntry>& current, uint32_t recordSize, std::vector<char> defaultRecord);
+
+		uint32_t InputRecordSize() const { return inputSize; }
+		uint32_t OutputRecordSize() const { return outputSize; }
+
+		// output holds count records of OutputRecordSize bytes
+		void Run(const char* input, uint32_t count, char* output) const;
+
+	private:
+		struct Copy {
+			uint32_t from;
+			uint32_t to;
+			uint32_t size;
+		};
+		struct Convert {
+			uint32_t from;
+			uint32_t to;
+			SaveFieldType fromType;
+			SaveFieldType toType;
+			uint32_t lanes;
+		};
+
+		uint32_t inputSize;
+		uint32_t outputSize;
+		std::vector<char> defaults;
+		std::vector<Copy> copies;
+		std::vector<Convert> converts;
+	};
+}
+
+#define REFLECT_EXPAND(x) x
+#define REFLECT_FIELD(Type, field) ECS::MakeFieldInfo<decltype(Type::field)>(#field, offsetof(Type, field))
+#define REFLECT_EACH_1(Type, f) REFLECT_FIELD(Type, f)
+#define REFLECT_EACH_2(Type, f, ...) REFLECT_FIELD(Type, f), REFLECT_EXPAND(REFLECT_EACH_1(Type, __VA_ARGS__))
+#define REFLECT_EACH_3(Type, f, ...) REFLECT_FIELD(Type, f), REFLECT_EXPAND(REFLECT_EACH_2(Type, __VA_ARGS__))
+#define REFLECT_EACH_4(Type, f, ...) REFLECT_FIELD(Type, f), REFLECT_EXPAND(REFLECT_EACH_3(Type, __VA_ARGS__))
+#define REFLECT_EACH_5(Type, f, ...) REFLECT_FIELD(Type, f), REFLECT_EXPAND(REFLECT_EACH_4(Type, __VA_ARGS__))
+#define REFLECT_EACH_6(Type, f, ...) REFLECT_FIELD(Type, f), REFLECT_EXPAND(REFLECT_EACH_5(Type, __VA_ARGS__))
+#define REFLECT_EACH_7(Type, f, ...) REFLECT_FIELD(Type, f), REFLECT_EXPAND(REFLECT_EACH_6(Type, __VA_ARGS__))
+#define REFLECT_EACH_8(Type, f, ...) REFLECT_FIELD(Type, f), REFLECT_EXPAND(REFLECT_EACH_7(Type, __VA_ARGS__))
+#define REFLECT_EACH_9(Type, f, ...) REFLECT_FIELD(Type, f), REFLECT_EXPAND(REFLECT_EACH_8(Type, __VA_ARGS__))
+#define REFLECT_EACH_10(Type, f, ...) REFLECT_FIELD(Type, f), REFLECT_EXPAND(REFLECT_EACH_9(Type, __VA_ARGS__))
+#define REFLECT_EACH_11(Type, f, ...) REFLECT_FIELD(Type, f), REFLECT_EXPAND(REFLECT_EACH_10(Type, __VA_ARGS__))
+#define REFLECT_EACH_12(Type, f, ...) REFLECT_FIELD(Type, f), REFLECT_EXPAND(REFLECT_EACH_11(Type, __VA_ARGS__))
+#define REFLECT_EACH_13(Type, f, ...) REFLECT_FIELD(Type, f), REFLECT_EXPAND(REFLECT_EACH_12(Type, __VA_ARGS__))
+#define REFLECT_EACH_14(Type, f, ...) REFLECT_FIELD(Type, f), REFLECT_EXPAND(REFLECT_EACH_13(Type, __VA_ARGS__))
+#define REFLECT_EACH_15(Type, f, ...) REFLECT_FIELD(Type, f), REFLECT_EXPAND(REFLECT_EACH_14(Type, __VA_ARGS__))
+#define REFLECT_EACH_16(Type, f, ...) REFLECT_FIELD(Type, f), REFLECT_EXPAND(REFLECT_EACH_15(Type, __VA_ARGS__))
+// The extra REFLECT_EXPAND passes make MSVC's traditional preprocessor split __VA_ARGS__ like everyone else
+#define REFLECT_PICK(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, NAME, ...) NAME
+#define REFLECT_EACH(Type, ...) REFLECT_EXPAND(REFLECT_EXPAND(REFLECT_PICK(__VA_ARGS__, \
+	REFLECT_EACH_16, REFLECT_EACH_15, REFLECT_EACH_14, REFLECT_EACH_13, REFLECT_EACH_12, REFLECT_EACH_11, REFLECT_EACH_10, REFLECT_EACH_9, \
+	REFLECT_EACH_8, REFLECT_EACH_7, REFLECT_EACH_6, REFLECT_EACH_5, REFLECT_EACH_4, REFLECT_EACH_3, REFLECT_EACH_2, REFLECT_EACH_1))(Type, __VA_ARGS__))
+
+// Up to 16 fields
+#define REFLECT_COMPONENT(Type, ...) \
+	static constexpr auto ReflectedFields() { return ECS::MakeFieldList(REFLECT_EACH(Type, __VA_ARGS__)); }
@@ -1,6 +1,14 @@
 #include "entity_component_system.h"
 #include "entity_components.h"
+#include "save_format.h"
+#include "entity_remap.h"
+#include "../mapped_file.h"
+#include "../thread_pool.h"
+#include "../compression/crc32c.h"
+#include <string>
+#include <exception>
 #include <fstream>
+#include <iostream>
 
 ECS::Coordinator* ECS::Coordinator::_globalCoordinator = nullptr;
 
@@ -15,50 +23,555 @@ void ECS::Coordinator::DeleteCoordinator()
     if (_globalCoordinator != nullptr) delete _globalCoordinator;
 }
 
-void ECS::Coordinator::Serialize()
+namespace {
+    bool LoadFailed(const char* path, const char* reason)
+    {
+        std::cerr << "Failed to load " << path << ": " << reason << "\n";
+        return false;
+    }
+
+    // A save file whose header, table of contents, checksums and entity list passed every check, with every block decoded
+    struct OpenedSave {
+        std::shared_ptr<MappedFile> file;
+        std::vector<ECS::SaveBlockEntry> toc;
+        // Raw contents of each block, either inside the mapping or in decoded. Layout blocks are 64 byte aligned too
+        std::vector<const char*> data;
+        std::shared_ptr<std::vector<std::vector<char>>> decoded;
+        // Indexed by the saved entity ID
+        std::vector<bool> saved;
+
+        const Entity* Entities() const { return reinterpret_cast<const Entity*>(data[0]); }
+        uint32_t EntityCount() const { return toc[0].count; }
+    };
+
+    // A component block whose type is registered with the same record size
+    struct SavedPool {
+        std::shared_ptr<ECS::IComponentArray> pool;
+        const char* typeName;
+        ComponentType type;
+        size_t block;
+        // Set when the fields of the component changed since the save
+        std::shared_ptr<const ECS::RecordConversion> conversion;
+    };
+
+    bool SameLayout(const ECS::SaveFieldEntry* saved, uint32_t savedCount, const std::vector<ECS::SaveFieldEntry>& current)
+    {
+        if (savedCount != current.size()) return false;
+        for (uint32_t i = 0; i < savedCount; i++) {
+            if (std::strncmp(saved[i].name, current[i].name, ECS::SAVE_FIELD_NAME_SIZE) != 0 || saved[i].type != current[i].type ||
+                saved[i].offset != current[i].offset || saved[i].size != current[i].size) return false;
+        }
+        return true;
+    }
+
+    // Records of the pool in the current layout. Matching layouts are used in place, the others are converted into scratch
+    const char* SavedRecords(const OpenedSave& save, const SavedPool& loaded, std::vector<char>& scratch)
+    {
+        const ECS::SaveBlockEntry& entry = save.toc[loaded.block];
+        const char* records = save.data[loaded.block] + ECS::SaveRecordsOffset(entry.count);
+        if (loaded.conversion == nullptr) return records;
+        scratch.resize(uint64_t(entry.count) * loaded.conversion->OutputRecordSize());
+        loaded.conversion->Run(records, entry.count, scratch.data());
+        return scratch.data();
+    }
+
+    bool OpenSave(const char* path, OpenedSave& save)
+    {
+        using namespace ECS;
+        save.file = std::make_shared<MappedFile>();
+        if (!save.file->open(path)) return LoadFailed(path, "cannot open file");
+        const char* base = save.file->data();
+        uint64_t fileSize = save.file->size();
+
+        SaveHeader header{};
+        if (fileSize < sizeof(SaveHeader)) return LoadFailed(path, "truncated header");
+        std::memcpy(&header, base, sizeof(SaveHeader));
+        if (std::memcmp(header.magic, SAVE_MAGIC, sizeof(SAVE_MAGIC)) != 0) return LoadFailed(path, "not a save file");
+        if (header.version != SAVE_VERSION) return LoadFailed(path, "unsupported version");
+        if (header.fileSize != fileSize) return LoadFailed(path, "file size does not match the header");
+        if (header.blockCount == 0 || sizeof(SaveHeader) + uint64_t(sizeof(SaveBlockEntry)) * header.blockCount > fileSize) return LoadFailed(path, "bad table of contents");
+
+        std::vector<SaveBlockEntry>& toc = save.toc;
+        toc.resize(header.blockCount);
+        std::memcpy(toc.data(), base + sizeof(SaveHeader), sizeof(SaveBlockEntry) * toc.size());
+        if (SaveHeaderChecksum(header, toc.data()) != header.checksum) return LoadFailed(path, "header checksum mismatch");
+
+        // Raw blocks are 64 byte aligned inside the page aligned mapping, so their entity arrays and records are used in place
+        save.data.assign(toc.size(), nullptr);
+        std::vector<uint32_t> encodedBlocks;
+        for (size_t i = 0; i < toc.size(); i++) {
+            const SaveBlockEntry& entry = toc[i];
+            bool entities = entry.kind == SaveBlockKind::Entities;
+            if (entities != (i == 0)) return LoadFailed(path, "the entity block must come first");
+            if (entry.name[SAVE_NAME_SIZE - 1] != '\0') return LoadFailed(path, "bad component name");
+            if (entry.offset % SAVE_BLOCK_ALIGNMENT != 0 || entry.offset > fileSize || entry.size > fileSize - entry.offset) return LoadFailed(path, "block outside of the file");
+            uint64_t expected = 0;
+            if (entities) expected = uint64_t(entry.count) * sizeof(Entity);
+            else if (entry.kind == SaveBlockKind::Components) expected = SaveRecordsOffset(entry.count) + uint64_t(entry.count) * entry.recordSize;
+            else if (entry.kind == SaveBlockKind::Layout && entry.recordSize == sizeof(SaveFieldEntry)) expected = uint64_t(entry.count) * sizeof(SaveFieldEntry);
+            else return LoadFailed(path, "unknown block kind");
+            if (entry.count > MAX_ENTITIES || entry.rawSize != expected) return LoadFailed(path, "block size does not match its count");
+            if (entry.encoding == SaveBlockEncoding::Raw) {
+                if (entry.size != entry.rawSize) return LoadFailed(path, "block size does not match its count");
+                save.data[i] = base + entry.offset;
+            }
+            else {
+                if (entry.encoding != SaveBlockEncoding::Lz || entry.filter > SaveBlockFilter::DeltaShuffle) return LoadFailed(path, "unknown block encoding");
+                encodedBlocks.push_back(static_cast<uint32_t>(i));
+            }
+        }
+
+        // The checksums read the whole file, let the OS fetch it in large reads instead of one page fault at a time
+        save.file->prefetch(0, fileSize);
+
+        // Every block is checked against its checksum and the compressed ones are decoded, in parallel.
+        // Also in lazy mode: the entity IDs are needed right away and nothing may be loaded from a damaged file.
+        // The CRC runs at memory speed, so the check costs about as much as faulting the pages in
+        save.decoded = std::make_shared<std::vector<std::vector<char>>>(toc.size());
+        std::vector<uint8_t> corrupt(toc.size(), 0);
+        std::vector<uint8_t> decodeFailed(toc.size(), 0);
+        ThreadPool::global().parallelFor(static_cast<uint32_t>(toc.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+            for (uint32_t i = begin; i < end; i++) {
+                corrupt[i] = compression::crc32c(base + toc[i].offset, toc[i].size) != toc[i].checksum;
+                if (!corrupt[i] && save.data[i] == nullptr) decodeFailed[i] = !DecodeSaveBlock(toc[i], base + toc[i].offset, (*save.decoded)[i]);
+            }
+        });
+        for (size_t i = 0; i < toc.size(); i++) {
+            if (corrupt[i]) {
+                std::cerr << "Checksum mismatch in block " << i << (toc[i].name[0] != '\0' ? " " : "") << toc[i].name << "\n";
+                return LoadFailed(path, "corrupt block");
+            }
+        }
+        for (uint32_t i : encodedBlocks) {
+            if (decodeFailed[i]) return LoadFailed(path, "corrupt compressed block");
+            save.data[i] = (*save.decoded)[i].data();
+        }
+
+        save.saved.assign(MAX_ENTITIES, false);
+        const Entity* savedEntities = save.Entities();
+        for (uint32_t i = 0; i < save.EntityCount(); i++) {
+            if (savedEntities[i] >= MAX_ENTITIES || save.saved[savedEntities[i]]) return LoadFailed(path, "bad entity list");
+            save.saved[savedEntities[i]] = true;
+        }
+        return true;
+    }
+
+    // Collects the blocks that can be loaded into the registered pools and checks their entity IDs, one block per worker
+    bool FindSavedPools(ECS::ComponentManager& componentManager, const OpenedSave& save, const char* path, std::vector<SavedPool>& pools)
+    {
+        std::unordered_map<std::string, size_t> layouts;
+        for (size_t i = 1; i < save.toc.size(); i++) {
+            if (save.toc[i].kind == ECS::SaveBlockKind::Layout) layouts[save.toc[i].name] = i;
+        }
+
+        for (size_t i = 1; i < save.toc.size(); i++) {
+            const ECS::SaveBlockEntry& entry = save.toc[i];
+            if (entry.kind != ECS::SaveBlockKind::Components) continue;
+            const char* typeName = componentManager.FindTypeName(entry.name);
+            if (typeName == nullptr) {
+                std::cerr << "Skipping unregistered component " << entry.name << " in " << path << "\n";
+                continue;
+            }
+            auto pool = componentManager.GetComponentArray(typeName);
+            SavedPool loaded{ pool, typeName, componentManager.GetComponentType(typeName), i, nullptr };
+
+            // With the field lists of both sides the records can be matched up field by field, otherwise only the size can be checked
+            std::vector<ECS::SaveFieldEntry> current = pool->RecordLayout();
+            auto layout = layouts.find(entry.name);
+            if (!current.empty() && layout != layouts.end()) {
+                const ECS::SaveFieldEntry* saved = reinterpret_cast<const ECS::SaveFieldEntry*>(save.data[layout->second]);
+                uint32_t savedCount = save.toc[layout->second].count;
+                if (pool->RecordSize() != entry.recordSize || !SameLayout(saved, savedCount, current)) {
+                    std::vector<char> defaults(pool->RecordSize());
+                    pool->DefaultRecord(defaults.data());
+                    loaded.conversion = std::make_shared<ECS::RecordConversion>(saved, savedCount, entry.recordSize, current, pool->RecordSize(), std::move(defaults));
+                }
+            }
+            else if (pool->RecordSize() != entry.recordSize) {
+                std::cerr << "Skipping " << entry.name << " in " << path << ", its size changed\n";
+                continue;
+            }
+            pools.push_back(std::move(loaded));
+        }
+
+        std::vector<uint8_t> badIds(pools.size(), 0);
+        ThreadPool::global().parallelFor(static_cast<uint32_t>(pools.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+            for (uint32_t p = begin; p < end; p++) {
+                const Entity* ids = reinterpret_cast<const Entity*>(save.data[pools[p].block]);
+                for (uint32_t j = 0; j < save.toc[pools[p].block].count && !badIds[p]; j++) {
+                    badIds[p] = ids[j] >= MAX_ENTITIES || !save.saved[ids[j]];
+                }
+            }
+        });
+        for (uint8_t bad : badIds) {
+            if (bad) return LoadFailed(path, "component of an entity that was not saved");
+        }
+        return true;
+    }
+}
+
+std::shared_ptr<ECS::SaveSnapshot> ECS::Coordinator::CaptureSnapshot(const SaveSnapshot* previous)
 {
-    std::ofstream fs("gameState.dat", std::ios::binary);
+    // Fills the pools of a lazy load, which also lets go of the mapping before the file is overwritten
+    componentManager->ResolveDeferredLoads();
+
+    auto snapshot = std::make_shared<SaveSnapshot>();
 
+    std::vector<Entity> living;
+    registry->GetLivingEntities(living);
+    SaveSnapshot::Block entityBlock{};
+    entityBlock.entry.kind = SaveBlockKind::Entities;
+    // Sorted IDs become a run of ones after the delta filter
+    entityBlock.entry.encoding = saveCompression ? SaveBlockEncoding::Lz : SaveBlockEncoding::Raw;
+    entityBlock.entry.filter = SaveBlockFilter::DeltaShuffle;
+    entityBlock.entry.count = static_cast<uint32_t>(living.size());
+    entityBlock.data = std::make_shared<std::vector<char>>(reinterpret_cast<const char*>(living.data()), reinterpret_cast<const char*>(living.data() + living.size()));
+    snapshot->blocks.push_back(std::move(entityBlock));
+
+    std::vector<std::shared_ptr<IComponentArray>> pools;
+    std::vector<size_t> poolBlocks;
     for (auto it = componentManager->getComponentTypeIteratorBegin(); it != componentManager->getComponentTypeIteratorEnd(); it++) {
-        auto compArray = componentManager->GetComponentArraySerializable(it->first);
-        uint32_t stride = compArray->compSize/sizeof(SerializableComponent);
-        uint32_t structNameLen = strlen(it->first);
-        uint32_t compCount = compArray->size;
-        fs.write(reinterpret_cast<const char*>(&structNameLen), sizeof(uint32_t));
-        fs.write(reinterpret_cast<const char*>(it->first), sizeof(char) * (structNameLen+1));
-        fs.write(reinterpret_cast<const char*>(&compCount), sizeof(uint32_t));
-        
-        //Remember that intel-based system uses little-endian
-        for (uint32_t i = 0; i < compArray->size;i++) {
-            compArray->componentArray[i * stride].Serialize(fs);
-        }
-    }
-    const char* eof = "EOF";
-    fs.write(eof, sizeof(char) * 3);
-    fs.close();
+        auto compArray = componentManager->GetComponentArray(it->first);
+        uint32_t recordSize = compArray->RecordSize();
+        if (recordSize == 0) continue;
+        assert(strlen(it->first) < SAVE_NAME_SIZE && "Component name too long for the save format");
+
+        SaveSnapshot::Block block{};
+        strncpy(block.entry.name, it->first, SAVE_NAME_SIZE - 1);
+        block.entry.kind = SaveBlockKind::Components;
+        block.entry.encoding = saveCompression ? SaveBlockEncoding::Lz : SaveBlockEncoding::Raw;
+        block.entry.filter = SaveBlockFilter::DeltaShuffle;
+        block.entry.count = compArray->Size();
+        block.entry.recordSize = recordSize;
+        block.poolId = compArray->poolId;
+        block.version = compArray->Version();
+        const SaveSnapshot::Block* unchanged = nullptr;
+        if (previous != nullptr && block.version != IComponentArray::UNTRACKED_VERSION) {
+            for (auto const& old : previous->blocks) {
+                if (old.poolId == block.poolId && old.version == block.version) unchanged = &old;
+            }
+        }
+        if (unchanged != nullptr) {
+            block.data = unchanged->data;
+        }
+        else {
+            poolBlocks.push_back(snapshot->blocks.size());
+            pools.push_back(compArray);
+        }
+        snapshot->blocks.push_back(std::move(block));
+
+        // Lets a later build with a different field list convert the records
+        std::vector<SaveFieldEntry> layout = compArray->RecordLayout();
+        if (!layout.empty()) {
+            SaveSnapshot::Block layoutBlock{};
+            strncpy(layoutBlock.entry.name, it->first, SAVE_NAME_SIZE - 1);
+            layoutBlock.entry.kind = SaveBlockKind::Layout;
+            layoutBlock.entry.encoding = SaveBlockEncoding::Raw;
+            layoutBlock.entry.count = static_cast<uint32_t>(layout.size());
+            layoutBlock.entry.recordSize = sizeof(SaveFieldEntry);
+            layoutBlock.data = std::make_shared<std::vector<char>>(reinterpret_cast<const char*>(layout.data()), reinterpret_cast<const char*>(layout.data() + layout.size()));
+            snapshot->blocks.push_back(std::move(layoutBlock));
+        }
+    }
+
+    // Pools only read themselves while saving, so each one is copied out on its own worker
+    ThreadPool::global().parallelFor(static_cast<uint32_t>(pools.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t i = begin; i < end; i++) {
+            SaveSnapshot::Block& block = snapshot->blocks[poolBlocks[i]];
+            uint64_t recordsOffset = SaveRecordsOffset(block.entry.count);
+            auto data = std::make_shared<std::vector<char>>(recordsOffset + uint64_t(block.entry.count) * block.entry.recordSize);
+            pools[i]->SaveRecords(reinterpret_cast<Entity*>(data->data()), data->data() + recordsOffset);
+            block.data = std::move(data);
+        }
+    });
+    return snapshot;
 }
 
-void ECS::Coordinator::Deserialize()
+void ECS::Coordinator::WaitForPendingSave(const char* path)
 {
-    std::ifstream fs("gameState.dat", std::ios::binary);
-    bool read = true;
-    while (read) {
-        uint32_t compNameSize;
-        fs.read(reinterpret_cast<char*>(&compNameSize),sizeof(uint32_t));
-        char compNameBuff[64]; //Assuming that No component will have name longer than (64-7) = 57 characters (because all comp name starts with 'struct '
-        fs.read(reinterpret_cast<char*>(&compNameBuff), sizeof(char) * (compNameSize + 1));
-        uint32_t count;
-        fs.read(reinterpret_cast<char*>(&count), sizeof(uint32_t));
-        std::cout << "read struct name: " << compNameBuff << " with count of " << count << "\n";
-
-        auto compArray = componentManager->GetComponentArraySerializableByComp(reinterpret_cast<const char*>(&compNameBuff));
-        uint32_t stride = compArray->compSize / sizeof(SerializableComponent);
-        uint32_t structNameLen = strlen(compNameBuff);
-        std::cout << "length of comp name: " << structNameLen << "\n";
-        for (uint32_t i = 0; i < count; i++) {
-            compArray->componentArray[i*stride].Deserialize(fs);
-        }
-        read = false;
-    }
-    fs.close();
+    auto it = pendingSaves.find(path);
+    if (it == pendingSaves.end()) return;
+    it->second.wait();
+    pendingSaves.erase(it);
+}
+
+bool ECS::Coordinator::Serialize(const char* path)
+{
+    // An older asynchronous save must not land on top of this one
+    WaitForPendingSave(path);
+    return WriteSaveFile(*CaptureSnapshot(), path);
+}
+
+std::future<bool> ECS::Coordinator::SerializeAsync(const char* path, std::function<void(bool success)> onComplete)
+{
+    // Saves that are done are dropped so the map only holds the paths still being written
+    for (auto it = pendingSaves.begin(); it != pendingSaves.end();) {
+        if (it->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready) it = pendingSaves.erase(it);
+        else ++it;
+    }
+
+    auto snapshot = CaptureSnapshot();
+    auto result = std::make_shared<std::promise<bool>>();
+    std::future<bool> future = result->get_future();
+    // The path may point at a temporary of the caller
+    pendingSaves[path] = ThreadPool::io().submit([snapshot, target = std::string(path), onComplete, result]() {
+        // A throw while encoding (e.g. out of memory) counts as a failed save, the future never breaks
+        bool success = false;
+        try {
+            success = WriteSaveFile(*snapshot, target.c_str());
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Failed to save " << target << ": " << e.what() << "\n";
+        }
+        catch (...) {
+            std::cerr << "Failed to save " << target << "\n";
+        }
+        result->set_value(success);
+        if (onComplete) {
+            try {
+                onComplete(success);
+            }
+            catch (...) {
+                std::cerr << "Save callback for " << target << " threw\n";
+            }
+        }
+    }).share();
+    return future;
+}
+
+void ECS::Coordinator::RestoreEntities(const Entity* entities, uint32_t count)
+{
+    std::vector<Entity> revived;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!registry->IsAlive(entities[i])) revived.push_back(entities[i]);
+    }
+    registry->CreateEntitiesWithIds(revived.data(), static_cast<uint32_t>(revived.size()));
+}
+
+bool ECS::Coordinator::LoadComponentRecords(const char* typeName, uint32_t recordSize, const Entity* entities, const char* records, uint32_t count)
+{
+    const char* key = componentManager->FindTypeName(typeName);
+    if (key == nullptr) return false;
+    auto pool = componentManager->GetComponentArray(key);
+    if (pool->RecordSize() != recordSize) return false;
+
+    pool->LoadRecords(entities, records, count);
+    ComponentType type = componentManager->GetComponentType(key);
+    for (uint32_t i = 0; i < count; i++) {
+        Signature signature = registry->GetSignature(entities[i]);
+        if (signature.test(type)) continue;
+        signature.set(type, true);
+        registry->SetSignature(entities[i], signature);
+        systemManager->EntitySignatureChanged(entities[i], signature);
+        queryManager->EntitySignatureChanged(entities[i], signature);
+    }
+    return true;
+}
+
+bool ECS::Coordinator::RemoveComponents(const char* typeName, const Entity* entities, uint32_t count)
+{
+    const char* key = componentManager->FindTypeName(typeName);
+    if (key == nullptr) return false;
+    auto pool = componentManager->GetComponentArray(key);
+    ComponentType type = componentManager->GetComponentType(key);
+    for (uint32_t i = 0; i < count; i++) {
+        Signature signature = registry->GetSignature(entities[i]);
+        if (!signature.test(type)) continue;
+        pool->EntityDestroyed(entities[i]);
+        signature.set(type, false);
+        registry->SetSignature(entities[i], signature);
+        systemManager->EntitySignatureChanged(entities[i], signature);
+        queryManager->EntitySignatureChanged(entities[i], signature);
+    }
+    return true;
+}
+
+bool ECS::Coordinator::Deserialize(const char* path, LoadMode mode)
+{
+    // A save that is still being written would be read half replaced or not at all
+    WaitForPendingSave(path);
+
+    // Everything is checked before the world is touched. A lazy load keeps the opened file until its last pool is filled
+    auto opened = std::make_shared<OpenedSave>();
+    OpenedSave& save = *opened;
+    if (!OpenSave(path, save)) return false;
+
+    // Pending records of an earlier lazy load belong to the world that is about to be replaced
+    componentManager->ResolveDeferredLoads();
+
+    std::vector<SavedPool> pools;
+    if (!FindSavedPools(*componentManager, save, path, pools)) return false;
+
+    const std::vector<SaveBlockEntry>& toc = save.toc;
+    const std::vector<const char*>& data = save.data;
+    const Entity* savedEntities = save.Entities();
+    uint32_t savedCount = save.EntityCount();
+
+    // Entities that are not in the save go away, the missing ones are brought back with their saved ID
+    std::vector<Entity> living;
+    registry->GetLivingEntities(living);
+    for (Entity entity : living) {
+        if (!save.saved[entity]) DestroyEntity(entity);
+    }
+    RestoreEntities(savedEntities, savedCount);
+
+    // Components of types that were skipped stay as they are, the loaded types are replaced
+    std::vector<Signature> signatures(MAX_ENTITIES);
+    for (uint32_t i = 0; i < savedCount; i++) {
+        Entity entity = savedEntities[i];
+        Signature current = registry->GetSignature(entity);
+        for (auto const& loaded : pools) current.set(loaded.type, false);
+        signatures[entity] = current;
+    }
+    for (auto const& loaded : pools) {
+        const Entity* ids = reinterpret_cast<const Entity*>(data[loaded.block]);
+        for (uint32_t j = 0; j < toc[loaded.block].count; j++) signatures[ids[j]].set(loaded.type, true);
+    }
+
+    // Pools are independent, each one drops its stale components and takes its records on its own worker.
+    // The registry, systems and queries are updated afterwards on this thread
+    ThreadPool::global().parallelFor(static_cast<uint32_t>(pools.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t p = begin; p < end; p++) {
+            const SavedPool& loaded = pools[p];
+            for (uint32_t i = 0; i < savedCount; i++) {
+                Entity entity = savedEntities[i];
+                if (registry->GetSignature(entity).test(loaded.type) && !signatures[entity].test(loaded.type)) loaded.pool->EntityDestroyed(entity);
+            }
+            if (mode == LoadMode::Eager) {
+                std::vector<char> converted;
+                const char* records = SavedRecords(save, loaded, converted);
+                loaded.pool->LoadRecords(reinterpret_cast<const Entity*>(data[loaded.block]), records, toc[loaded.block].count);
+            }
+        }
+    });
+    if (mode == LoadMode::Lazy) {
+        for (auto const& loaded : pools) {
+            componentManager->DeferLoad(loaded.typeName, [opened, loaded]() {
+                std::vector<char> converted;
+                const char* records = SavedRecords(*opened, loaded, converted);
+                loaded.pool->LoadRecords(reinterpret_cast<const Entity*>(opened->data[loaded.block]), records, opened->toc[loaded.block].count);
+            });
+        }
+    }
+
+    for (uint32_t i = 0; i < savedCount; i++) {
+        Entity entity = savedEntities[i];
+        registry->SetSignature(entity, signatures[entity]);
+        systemManager->EntitySignatureChanged(entity, signatures[entity]);
+        queryManager->EntitySignatureChanged(entity, signatures[entity]);
+    }
+    return true;
+}
+
+bool ECS::Coordinator::Merge(const char* path, std::vector<Entity>* created)
+{
+    WaitForPendingSave(path);
+
+    OpenedSave save;
+    if (!OpenSave(path, save)) return false;
+    const Entity* savedEntities = save.Entities();
+    uint32_t savedCount = save.EntityCount();
+    if (registry->GetEntityCount() + savedCount > MAX_ENTITIES) return LoadFailed(path, "not enough free entities to merge");
+
+    // Pools are about to be written to from the workers, where a pending lazy load can't be resolved
+    componentManager->ResolveDeferredLoads();
+
+    std::vector<SavedPool> pools;
+    if (!FindSavedPools(*componentManager, save, path, pools)) return false;
+
+    // Fresh IDs in one go, remap[saved ID] is the new ID. References to entities outside of the save become UINT32_MAX
+    std::vector<Entity> entities(savedCount);
+    registry->CreateEntities(entities.data(), savedCount);
+    std::vector<Entity> remap(MAX_ENTITIES, UINT32_MAX);
+    for (uint32_t i = 0; i < savedCount; i++) remap[savedEntities[i]] = entities[i];
+
+    // Every pool translates its IDs and entity fields and inserts its records on its own worker.
+    // The new entities have no components yet, so nothing is overwritten
+    std::vector<Signature> signatures(MAX_ENTITIES);
+    std::vector<std::vector<Entity>> ids(pools.size());
+    ThreadPool::global().parallelFor(static_cast<uint32_t>(pools.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+        std::vector<char> records;
+        for (uint32_t p = begin; p < end; p++) {
+            const SavedPool& loaded = pools[p];
+            const SaveBlockEntry& entry = save.toc[loaded.block];
+            const char* block = save.data[loaded.block];
+            ids[p].resize(entry.count);
+            RemapEntityIds(reinterpret_cast<const Entity*>(block), ids[p].data(), entry.count, remap.data(), MAX_ENTITIES);
+
+            const char* source = SavedRecords(save, loaded, records);
+            const std::vector<uint32_t>& fields = loaded.pool->EntityFields();
+            if (!fields.empty()) {
+                // The mapping is read only, records with entity fields are translated in a copy
+                uint32_t recordSize = loaded.pool->RecordSize();
+                if (source != records.data()) records.assign(source, source + uint64_t(entry.count) * recordSize);
+                for (uint32_t field : fields) {
+                    assert(field + sizeof(Entity) <= recordSize && "Entity field outside of the save record");
+                    RemapEntityField(records.data(), entry.count, recordSize, field, remap.data(), MAX_ENTITIES);
+                }
+                source = records.data();
+            }
+            loaded.pool->LoadRecords(ids[p].data(), source, entry.count);
+        }
+    });
+    for (size_t p = 0; p < pools.size(); p++) {
+        for (Entity entity : ids[p]) signatures[entity].set(pools[p].type, true);
+    }
+
+    // Entities of a chunk mostly share a handful of signatures, each distinct one reaches the systems and queries as
+    // one sorted batch
+    std::vector<Signature> distinct;
+    std::vector<std::vector<Entity>> batches;
+    for (Entity entity : entities) {
+        size_t group = 0;
+        while (group < distinct.size() && distinct[group] != signatures[entity]) group++;
+        if (group == distinct.size()) {
+            distinct.push_back(signatures[entity]);
+            batches.emplace_back();
+        }
+        batches[group].push_back(entity);
+    }
+    for (size_t group = 0; group < distinct.size(); group++) {
+        std::vector<Entity>& batch = batches[group];
+        std::sort(batch.begin(), batch.end());
+        uint32_t count = static_cast<uint32_t>(batch.size());
+        registry->SetSignatures(batch.data(), count, distinct[group]);
+        systemManager->EntitiesSignatureChanged(batch.data(), count, distinct[group]);
+        queryManager->EntitiesSignatureChanged(batch.data(), count, distinct[group]);
+    }
+
+    if (created != nullptr) *created = std::move(entities);
+    return true;
+}
+
+uint32_t ECS::Coordinator::StateHash()
+{
+    componentManager->ResolveDeferredLoads();
+
+    std::vector<Entity> living;
+    registry->GetLivingEntities(living);
+
+    // The map order of the pools differs between runs, the type names don't
+    std::vector<const char*> names;
+    for (auto it = componentManager->getComponentTypeIteratorBegin(); it != componentManager->getComponentTypeIteratorEnd(); it++) {
+        if (componentManager->GetComponentArray(it->first)->RecordSize() != 0) names.push_back(it->first);
+    }
+    std::sort(names.begin(), names.end(), [](const char* a, const char* b) { return strcmp(a, b) < 0; });
+
+    // Each pool is hashed on its own worker. GetComponentArray looks up and may fill the pool, so the pools are
+    // resolved here first
+    std::vector<std::shared_ptr<IComponentArray>> pools;
+    pools.reserve(names.size());
+    for (const char* name : names) pools.push_back(componentManager->GetComponentArray(name));
+    std::vector<uint32_t> hashes(names.size());
+    ThreadPool::global().parallelFor(static_cast<uint32_t>(names.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t i = begin; i < end; i++) {
+            const auto& pool = pools[i];
+            uint32_t count = pool->Size();
+            uint32_t crc = compression::crc32c(names[i], strlen(names[i]));
+            hashes[i] = pool->HashRecords(compression::crc32c(&count, sizeof(count), crc));
+        }
+    });
+
+    uint32_t hash = compression::crc32c(living.data(), sizeof(Entity) * living.size());
+    return compression::crc32c(hashes.data(), sizeof(uint32_t) * hashes.size(), hash);
 }
@@ -3,39 +3,259 @@
 #include <set>
 #include <queue>
 #include <array>
-#include <bitset>
+#include <atomic>
 #include <memory>
+#include <vector>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <type_traits>
+#include <algorithm>
+#include <future>
+#include <functional>
+#include <string>
 #include <unordered_map>
 #include <initializer_list>
 
 #include "entity_components.h"
+#include "signature_scan.h"
+#include "save_format.h"
+#include "component_reflection.h"
+#include "../compression/crc32c.h"
 
 //https://austinmorlan.com/posts/entity_component_system/#demo
 
 typedef uint32_t Entity;
 typedef uint32_t ComponentType;
 
-#define MAX_ENTITIES 5000
+// Every pool, the registry and a few systems keep MAX_ENTITIES sized arrays, all on the heap.
+// Large enough for the 10k body physics benchmark scene
+#define MAX_ENTITIES 16384
 #define MAX_COMPONENTS 100
 
 namespace ECS {
-//using Signature = std::bitset<ECS::MAX_COMPONENTS>;
-	typedef std::bitset<MAX_COMPONENTS> Signature;
+	// 128 bits for MAX_COMPONENTS of 100. Lowering MAX_COMPONENTS to 64 or less halves every stored signature
+	typedef BasicSignature<SignatureBitsFor(MAX_COMPONENTS)> Signature;
+	static_assert(MAX_COMPONENTS <= 256, "Signature holds at most 256 components");
 	//constexpr int MAX_ENTITIES = 5000;
 	//constexpr int MAX_COMPONENTS = 100;
 
 	//base class of all systems that needs to iterate over the entities
 	class EntitySystem {
 	public:
+		virtual ~EntitySystem() = default;
+
+		// Called by Coordinator::UpdateSystems at the rate set by the system's SystemSchedule.
+		// dt is the time since the previous call
+		virtual void Update(float dt) {}
+
+		// Called instead of Update when the system is time sliced (SystemSchedule::budgetMicroseconds).
+		// dt is the time the previous full sweep over mEntities took. May destroy entities or change signatures
+		virtual void UpdateEntity(Entity entity, float dt) {}
+
 		std::set<Entity> mEntities;
 	};
 
+	// How often a system is updated. The default runs Update every frame
+	struct SystemSchedule {
+		// Updates per second. 0 updates every frame
+		float tickRate = 0.0f;
+		// When non zero the system is time sliced: every update calls UpdateEntity from where the previous
+		// update stopped until the budget is used up, going round robin over mEntities across frames
+		uint32_t budgetMicroseconds = 0;
+	};
+
+	struct SystemStats {
+		uint64_t updateCount = 0;
+		float lastUpdateMicroseconds = 0.0f;
+		// Entities processed by the last time sliced update
+		uint32_t lastEntityCount = 0;
+		// Number of updates that went over budgetMicroseconds and by how much the worst one did
+		uint64_t overrunCount = 0;
+		float worstOverrunMicroseconds = 0.0f;
+	};
+
 	class IComponentArray {
 	public:
 		virtual ~IComponentArray() = default;
 		virtual void EntityDestroyed(Entity entity) = 0;
+		virtual uint32_t Size() const = 0;
+
+		// Bytes per component in the save file, 0 when the type cannot be saved
+		virtual uint32_t RecordSize() const = 0;
+		// Writes the entity ID and the record of every component in iteration order,
+		// entities must hold Size() IDs and records Size() * RecordSize() bytes
+		virtual void SaveRecords(Entity* entities, char* records) = 0;
+		// Sets the component of every entity from its record, adding the components that don't exist yet
+		virtual void LoadRecords(const Entity* entities, const char* records, uint32_t count) = 0;
+		// Record offsets of the entity IDs held by the component, see HasEntityFields
+		virtual const std::vector<uint32_t>& EntityFields() const = 0;
+		// Fields of the record of a reflected component, empty for every other type
+		virtual std::vector<SaveFieldEntry> RecordLayout() const = 0;
+		// Record of a default constructed component, RecordSize() bytes
+		virtual void DefaultRecord(char* record) const = 0;
+		// Continues crc over what SaveRecords writes, all entity IDs followed by all records
+		virtual uint32_t HashRecords(uint32_t crc) = 0;
+		// Bumped by every change to the pool and every access that hands out a mutable component.
+		// UNTRACKED_VERSION when components can be written through pointers kept by the caller
+		virtual uint64_t Version() const = 0;
+
+		static constexpr uint64_t UNTRACKED_VERSION = UINT64_MAX;
+
+		// Unique per pool, a version is only meaningful together with the pool it came from
+		const uint64_t poolId = NextPoolId();
+
+	private:
+		static uint64_t NextPoolId()
+		{
+			static std::atomic<uint64_t> next{ 1 };
+			return next++;
+		}
+	};
+
+	// Size of the save record of T, see SerializableComponent and component_reflection.h
+	template<typename T>
+	constexpr uint32_t RecordSizeOf()
+	{
+		if constexpr (std::is_base_of<SerializableComponent, T>::value) return T::SERIALIZED_SIZE;
+		else if constexpr (IsReflected<T>::value) return ReflectedRecordSize<T>();
+		else if constexpr (std::is_trivially_copyable<T>::value) return sizeof(T);
+		else return 0;
+	}
+
+	// True when the records of T are its bytes, so a whole dense array can be saved or loaded with one copy
+	template<typename T>
+	constexpr bool RecordIsComponent()
+	{
+		if constexpr (std::is_base_of<SerializableComponent, T>::value || !std::is_trivially_copyable<T>::value) return false;
+		else if constexpr (IsReflected<T>::value) return ReflectionCoversLayout<T>() && !HasOnLoaded<T>::value;
+		else return true;
+	}
+
+	// A component that refers to other entities lists where their IDs sit in its save record by declaring
+	//     static std::vector<uint32_t> EntityFields() { return { offsetof(T, target), ... }; }
+	// Coordinator::Merge translates these fields into the IDs the referenced entities get in the live world
+	template<typename T, typename = void>
+	struct HasEntityFields : std::false_type {};
+
+	template<typename T>
+	struct HasEntityFields<T, std::void_t<decltype(T::EntityFields())>> : std::true_type {};
+
+	// Offsets of reflected components are moved to where the field sits in the record
+	template<typename T>
+	const std::vector<uint32_t>& EntityFieldsOf()
+	{
+		static const std::vector<uint32_t> fields = []() {
+			std::vector<uint32_t> offsets;
+			if constexpr (HasEntityFields<T>::value) offsets = T::EntityFields();
+			if constexpr (IsReflected<T>::value) {
+				constexpr auto reflected = T::ReflectedFields();
+				for (uint32_t& offset : offsets) {
+					uint32_t index = 0;
+					while (index < reflected.size() && reflected[index].offset != offset) index++;
+					assert(index < reflected.size() && "Entity field is not reflected");
+					offset = ReflectedRecordOffset<T>(index);
+				}
+			}
+			return offsets;
+		}();
+		return fields;
+	}
+
+	template<typename T>
+	void WriteRecord(const T& component, char* record)
+	{
+		if constexpr (std::is_base_of<SerializableComponent, T>::value) component.Serialize(record);
+		else if constexpr (IsReflected<T>::value) WriteReflectedRecord(component, record);
+		else std::memcpy(record, &component, sizeof(T));
+	}
+
+	template<typename T>
+	void ReadRecord(T& component, const char* record)
+	{
+		if constexpr (std::is_base_of<SerializableComponent, T>::value) component.Deserialize(record);
+		else if constexpr (IsReflected<T>::value) {
+			ReadReflectedRecord(component, record);
+			if constexpr (HasOnLoaded<T>::value) component.OnLoaded();
+		}
+		else std::memcpy(&component, record, sizeof(T));
+	}
+
+	// Computes the CRC-32C of the IDs and records of a pool without copying the whole pool out first.
+	// Both go through small buffers that stay in L1 and are hashed as two streams that Finish joins
+	class RecordHasher {
+	public:
+		explicit RecordHasher(uint32_t recordSize) : recordSize{ recordSize }, records(uint64_t(CHUNK) * recordSize) {}
+
+		// Returns where the record of entity goes
+		char* Add(Entity entity)
+		{
+			if (idCount == CHUNK) Flush();
+			ids[idCount++] = entity;
+			return records.data() + uint64_t(recordCount++) * recordSize;
+		}
+
+		// For records that are hashed in place with AddRecords
+		void AddId(Entity entity)
+		{
+			if (idCount == CHUNK) Flush();
+			ids[idCount++] = entity;
+		}
+
+		void AddRecords(const void* data, uint64_t size)
+		{
+			recordCrc = compression::crc32c(data, size, recordCrc);
+			recordBytes += size;
+		}
+
+		uint32_t Finish(uint32_t crc)
+		{
+			Flush();
+			crc = compression::crc32cCombine(crc, idCrc, idBytes);
+			return compression::crc32cCombine(crc, recordCrc, recordBytes);
+		}
+
+	private:
+		static constexpr uint32_t CHUNK = 256;
+
+		void Flush()
+		{
+			idCrc = compression::crc32c(ids, sizeof(Entity) * idCount, idCrc);
+			idBytes += sizeof(Entity) * idCount;
+			AddRecords(records.data(), uint64_t(recordCount) * recordSize);
+			idCount = 0;
+			recordCount = 0;
+		}
+
+		uint32_t recordSize;
+		Entity ids[CHUNK];
+		std::vector<char> records;
+		uint32_t idCount = 0;
+		uint32_t recordCount = 0;
+		uint32_t idCrc = 0;
+		uint32_t recordCrc = 0;
+		uint64_t idBytes = 0;
+		uint64_t recordBytes = 0;
 	};
 
+	template<typename T>
+	std::vector<SaveFieldEntry> RecordLayoutOf()
+	{
+		if constexpr (IsReflected<T>::value) return ReflectedRecordLayout<T>();
+		else return {};
+	}
+
+	// A component type opts into stable storage by declaring
+	//     static constexpr bool STABLE_ADDRESS = true;
+	// Its pool becomes a StableComponentArray, so pointers returned by AddComponent stay valid until the component is removed.
+	template<typename T, typename = void>
+	struct IsStableComponent : std::false_type {};
+
+	template<typename T>
+	struct IsStableComponent<T, std::void_t<decltype(T::STABLE_ADDRESS)>> : std::bool_constant<T::STABLE_ADDRESS> {};
+
+	// Dense storage. Removing a component moves the last component into the hole,
+	// which keeps iteration tight but invalidates pointers into the array.
 	template<typename T>
 	class ComponentArray : public IComponentArray {
 	public:
@@ -48,12 +268,43 @@ namespace ECS {
 			indexToEntityMap[newIndex] = entity;
 			componentArray[newIndex] = component;
 			size++;
+			version++;
 			//std::cout << "TC ADDED pointer:" << &componentArray[newIndex] << "\n";
 			return &componentArray[newIndex];
 		}
 
+		// Appends the same component to a run of entities.
+		// The new components are contiguous at the end of the array
+		void InsertRange(const Entity* entities, uint32_t count, const T& component) {
+			assert(size + count <= MAX_ENTITIES && "Too many components in the array");
+
+			uint32_t firstIndex = size;
+			std::fill_n(&componentArray[firstIndex], count, component);
+			version++;
+
+			entityToIndexMap.reserve(size + count);
+			indexToEntityMap.reserve(size + count);
+			for (uint32_t i = 0; i < count; i++) {
+				assert(entityToIndexMap.find(entities[i]) == entityToIndexMap.end() && "Entity already has component type");
+				entityToIndexMap[entities[i]] = firstIndex + i;
+				indexToEntityMap[firstIndex + i] = entities[i];
+			}
+			size += count;
+		}
+
+		// Calls func(component, i) for the components of the run passed to the last InsertRange
+		template<typename F>
+		void ApplyToRange(const Entity* entities, uint32_t count, F&& func) {
+			T* first = &componentArray[size - count];
+			for (uint32_t i = 0; i < count; i++) {
+				func(first[i], i);
+			}
+			version++;
+		}
+
 		void Remove(Entity entity) {
 			assert(entityToIndexMap.find(entity) != entityToIndexMap.end() && "Entity does not own the component");
+			version++;
 
 			uint32_t indexToRemove = entityToIndexMap[entity];
 			uint32_t lastIndex = size - 1;
@@ -73,6 +324,7 @@ namespace ECS {
 		T& Get(Entity entity)
 		{
 			assert(entityToIndexMap.find(entity) != entityToIndexMap.end() && "Retrieving non-existent component.");
+			version++;
 
 			// Return a reference to the entity's component
 			return componentArray[entityToIndexMap[entity]];
@@ -87,10 +339,89 @@ namespace ECS {
 			}
 		}
 
+		// Calls func(entity, component) for every component
+		template<typename F>
+		void ForEach(F&& func)
+		{
+			version++;
+			for (uint32_t i = 0; i < size; i++) {
+				func(indexToEntityMap[i], componentArray[i]);
+			}
+		}
+
+		uint32_t Size() const override { return size; }
+		uint64_t Version() const override { return version; }
+
+		uint32_t RecordSize() const override { return RecordSizeOf<T>(); }
+		const std::vector<uint32_t>& EntityFields() const override { return EntityFieldsOf<T>(); }
+		std::vector<SaveFieldEntry> RecordLayout() const override { return RecordLayoutOf<T>(); }
+		void DefaultRecord(char* record) const override
+		{
+			if constexpr (RecordSizeOf<T>() != 0) WriteRecord(T{}, record);
+		}
+
+		void SaveRecords(Entity* entities, char* records) override
+		{
+			if constexpr (RecordSizeOf<T>() != 0) {
+				for (uint32_t i = 0; i < size; i++) entities[i] = indexToEntityMap[i];
+				if constexpr (RecordIsComponent<T>()) {
+					// The array is dense, so raw components go out in one copy
+					std::memcpy(records, componentArray.data(), sizeof(T) * size);
+				}
+				else {
+					for (uint32_t i = 0; i < size; i++) WriteRecord(componentArray[i], records + i * RecordSizeOf<T>());
+				}
+			}
+		}
+
+		uint32_t HashRecords(uint32_t crc) override
+		{
+			if constexpr (RecordSizeOf<T>() != 0) {
+				RecordHasher hasher(RecordSizeOf<T>());
+				if constexpr (RecordIsComponent<T>()) {
+					for (uint32_t i = 0; i < size; i++) hasher.AddId(indexToEntityMap[i]);
+					hasher.AddRecords(componentArray.data(), sizeof(T) * size);
+				}
+				else {
+					for (uint32_t i = 0; i < size; i++) WriteRecord(componentArray[i], hasher.Add(indexToEntityMap[i]));
+				}
+				crc = hasher.Finish(crc);
+			}
+			return crc;
+		}
+
+		void LoadRecords(const Entity* entities, const char* records, uint32_t count) override
+		{
+			version++;
+			if constexpr (RecordSizeOf<T>() != 0) {
+				if constexpr (RecordIsComponent<T>()) {
+					// Loading into an empty pool, the records are copied straight to the end of the array
+					if (size == 0) {
+						assert(count <= MAX_ENTITIES && "Too many components in the array");
+						std::memcpy(componentArray.data(), records, sizeof(T) * count);
+						entityToIndexMap.reserve(count);
+						indexToEntityMap.reserve(count);
+						for (uint32_t i = 0; i < count; i++) {
+							entityToIndexMap[entities[i]] = i;
+							indexToEntityMap[i] = entities[i];
+						}
+						size = count;
+						return;
+					}
+				}
+				for (uint32_t i = 0; i < count; i++) {
+					auto it = entityToIndexMap.find(entities[i]);
+					T* component = it != entityToIndexMap.end() ? &componentArray[it->second] : Insert(entities[i], T{});
+					ReadRecord(*component, records + i * RecordSizeOf<T>());
+				}
+			}
+		}
+
 		uint32_t compSize = 0; //Byte size of the component
 		uint32_t size = 0;
 		std::array<T, MAX_ENTITIES> componentArray;
 	private:
+		uint64_t version = 0;
 
 		// Map from an entity ID to an array index.
 		std::unordered_map<Entity, size_t> entityToIndexMap;
@@ -100,6 +431,173 @@ namespace ECS {
 
 	};
 
+	// Stable storage for components that other code holds pointers to.
+	// Components live in fixed pages of PAGE_SIZE slots that are never moved or freed,
+	// removed slots go on a free list and a per page occupancy bitmap is used to iterate over the live slots.
+	template<typename T>
+	class StableComponentArray : public IComponentArray {
+	public:
+		// One 64 bit occupancy word per page
+		static constexpr uint32_t PAGE_SIZE = 64;
+
+		StableComponentArray(uint16_t entSize) { compSize = entSize; slotOf.fill(INVALID_SLOT); }
+
+		T* Insert(Entity entity, T component) {
+			assert(slotOf[entity] == INVALID_SLOT && "Entity already has component type");
+
+			uint32_t slot = AllocateSlot();
+			slotOf[entity] = slot;
+			entityOf[slot] = entity;
+			T* stored = &Slot(slot);
+			*stored = component;
+			size++;
+			return stored;
+		}
+
+		// Inserts the same component for a run of entities. The slots are only contiguous when the free list was empty
+		void InsertRange(const Entity* entities, uint32_t count, const T& component) {
+			for (uint32_t i = 0; i < count; i++) {
+				Insert(entities[i], component);
+			}
+		}
+
+		// Calls func(component, i) for the components of the run passed to the last InsertRange
+		template<typename F>
+		void ApplyToRange(const Entity* entities, uint32_t count, F&& func) {
+			for (uint32_t i = 0; i < count; i++) {
+				func(Get(entities[i]), i);
+			}
+		}
+
+		void Remove(Entity entity) {
+			assert(slotOf[entity] != INVALID_SLOT && "Entity does not own the component");
+
+			uint32_t slot = slotOf[entity];
+			// Reset the slot so a later Insert starts from a clean component, the address itself stays valid
+			Slot(slot) = T{};
+			occupancy[slot / PAGE_SIZE] &= ~(uint64_t(1) << (slot % PAGE_SIZE));
+			freeSlots.push_back(slot);
+			slotOf[entity] = INVALID_SLOT;
+			size--;
+		}
+
+		T& Get(Entity entity)
+		{
+			assert(slotOf[entity] != INVALID_SLOT && "Retrieving non-existent component.");
+			return Slot(slotOf[entity]);
+		}
+
+		void EntityDestroyed(Entity entity) override
+		{
+			if (slotOf[entity] != INVALID_SLOT)
+			{
+				Remove(entity);
+			}
+		}
+
+		// Calls func(entity, component) for every live slot, skipping empty pages a word at a time
+		template<typename F>
+		void ForEach(F&& func)
+		{
+			for (uint32_t page = 0; page < occupancy.size(); page++) {
+				uint64_t live = occupancy[page];
+				while (live) {
+					uint32_t slot = page * PAGE_SIZE + CountTrailingZeros(live);
+					func(entityOf[slot], Slot(slot));
+					live &= live - 1;
+				}
+			}
+		}
+
+		uint32_t Size() const override { return size; }
+		// Get and Insert hand out pointers that stay valid, so writes can't be seen
+		uint64_t Version() const override { return UNTRACKED_VERSION; }
+
+		uint32_t RecordSize() const override { return RecordSizeOf<T>(); }
+		const std::vector<uint32_t>& EntityFields() const override { return EntityFieldsOf<T>(); }
+		std::vector<SaveFieldEntry> RecordLayout() const override { return RecordLayoutOf<T>(); }
+		void DefaultRecord(char* record) const override
+		{
+			if constexpr (RecordSizeOf<T>() != 0) WriteRecord(T{}, record);
+		}
+
+		void SaveRecords(Entity* entities, char* records) override
+		{
+			if constexpr (RecordSizeOf<T>() != 0) {
+				uint32_t i = 0;
+				ForEach([&](Entity entity, T& component) {
+					entities[i] = entity;
+					WriteRecord(component, records + i * RecordSizeOf<T>());
+					i++;
+				});
+			}
+		}
+
+		uint32_t HashRecords(uint32_t crc) override
+		{
+			if constexpr (RecordSizeOf<T>() != 0) {
+				RecordHasher hasher(RecordSizeOf<T>());
+				ForEach([&](Entity entity, T& component) { WriteRecord(component, hasher.Add(entity)); });
+				crc = hasher.Finish(crc);
+			}
+			return crc;
+		}
+
+		// Existing components are overwritten in place, so pointers to them stay valid across a load
+		void LoadRecords(const Entity* entities, const char* records, uint32_t count) override
+		{
+			if constexpr (RecordSizeOf<T>() != 0) {
+				for (uint32_t i = 0; i < count; i++) {
+					T* component = slotOf[entities[i]] != INVALID_SLOT ? &Get(entities[i]) : Insert(entities[i], T{});
+					ReadRecord(*component, records + i * RecordSizeOf<T>());
+				}
+			}
+		}
+
+		uint32_t compSize = 0; //Byte size of the component
+		uint32_t size = 0;
+
+	private:
+		static constexpr uint32_t INVALID_SLOT = UINT32_MAX;
+
+		T& Slot(uint32_t slot) { return (*pages[slot / PAGE_SIZE])[slot % PAGE_SIZE]; }
+
+		uint32_t AllocateSlot()
+		{
+			uint32_t slot;
+			if (!freeSlots.empty()) {
+				slot = freeSlots.back();
+				freeSlots.pop_back();
+			}
+			else {
+				if (nextSlot == pages.size() * PAGE_SIZE) {
+					pages.push_back(std::make_unique<std::array<T, PAGE_SIZE>>());
+					occupancy.push_back(0);
+					entityOf.resize(pages.size() * PAGE_SIZE);
+				}
+				slot = nextSlot++;
+			}
+			occupancy[slot / PAGE_SIZE] |= uint64_t(1) << (slot % PAGE_SIZE);
+			return slot;
+		}
+
+		std::vector<std::unique_ptr<std::array<T, PAGE_SIZE>>> pages;
+		// Bit i of word p is set when slot p * PAGE_SIZE + i holds a component
+		std::vector<uint64_t> occupancy;
+		std::vector<uint32_t> freeSlots;
+		// Slots below nextSlot have been handed out at least once
+		uint32_t nextSlot = 0;
+
+		// Map from an entity ID to a slot
+		std::array<uint32_t, MAX_ENTITIES> slotOf;
+		// Map from a slot to an entity ID
+		std::vector<Entity> entityOf;
+	};
+
+	// Pool type used for components of type T
+	template<typename T>
+	using ComponentStorage = std::conditional_t<IsStableComponent<T>::value, StableComponentArray<T>, ComponentArray<T>>;
+
 	class ComponentManager {
 	public:
 		template<typename T>
@@ -108,12 +606,13 @@ namespace ECS {
 			const char* typeName = typeid(T).name();
 
 			assert(componentTypes.find(typeName) == componentTypes.end() && "Registering component type more than once.");
+			assert(nextComponentType < MAX_COMPONENTS && "Too many component types registered.");
 
 			// Add this component type to the component type map
 			componentTypes.insert({ typeName, nextComponentType });
 
 			// Create a ComponentArray pointer and add it to the component arrays map
-			componentArrays.insert({ typeName, std::make_shared<ComponentArray<T>>(sizeof(T)) });
+			componentArrays.insert({ typeName, std::make_shared<ComponentStorage<T>>(sizeof(T)) });
 
 			// Increment the value so that the next component registered will be different
 			++nextComponentType;
@@ -162,6 +661,9 @@ namespace ECS {
 
 		void EntityDestroyed(Entity entity)
 		{
+			// A pending load would bring the component back after it is removed
+			ResolveDeferredLoads();
+
 			// Notify each component array that an entity has been destroyed
 			// If it has a component for that entity, it will remove it
 			for (auto const& pair : componentArrays)
@@ -180,21 +682,66 @@ namespace ECS {
 			return componentTypes.end();
 		}
 
-		std::shared_ptr<ComponentArray<SerializableComponent>> GetComponentArraySerializable(const char* typeName) {
-			return std::static_pointer_cast<ComponentArray<SerializableComponent>>(componentArrays[typeName]);
+		template<typename T, typename F>
+		void ForEachComponent(F&& func)
+		{
+			GetComponentArray<T>()->ForEach(func);
+		}
+
+		std::shared_ptr<IComponentArray> GetComponentArray(const char* typeName) {
+			ResolveDeferredLoad(typeName);
+			return componentArrays[typeName];
+		}
+
+		// Postpones filling the pool of typeName until the pool is first used, see Coordinator::Deserialize
+		void DeferLoad(const char* typeName, std::function<void()> load) {
+			ResolveDeferredLoad(typeName);
+			deferredLoads[typeName] = std::move(load);
+		}
+
+		void ResolveDeferredLoad(const char* typeName) {
+			if (deferredLoads.empty()) return;
+			auto it = deferredLoads.find(typeName);
+			if (it == deferredLoads.end()) return;
+			// Erased first, the load goes through the pool like any other access
+			auto load = std::move(it->second);
+			deferredLoads.erase(it);
+			load();
+		}
+
+		void ResolveDeferredLoads() {
+			while (!deferredLoads.empty()) ResolveDeferredLoad(deferredLoads.begin()->first);
+		}
+
+		// Returns the registered key equal to typeName, e.g. a name read from a save file, or nullptr
+		const char* FindTypeName(const char* typeName) const {
+			for (auto const& pair : componentTypes) {
+				if (strcmp(pair.first, typeName) == 0) return pair.first;
+			}
+			return nullptr;
+		}
+
+		// typeName must be a registered key, see FindTypeName
+		ComponentType GetComponentType(const char* typeName) {
+			assert(componentTypes.find(typeName) != componentTypes.end() && "Component not registered before use.");
+			return componentTypes[typeName];
 		}
 
 		//changing key from const char* to std::string will make this function O(1) 
 		//In fact you wouldn't even need this function
-		std::shared_ptr<ComponentArray<SerializableComponent>> GetComponentArraySerializableByComp(const char* typeName) {
+		std::shared_ptr<IComponentArray> GetComponentArrayByName(const char* typeName) {
 			for (auto it = componentArrays.begin(); it != componentArrays.end(); it++) {
 				if (strcmp(it->first, typeName) == 0) {
-					return std::static_pointer_cast<ComponentArray<SerializableComponent>>(componentArrays[it->first]);
+					ResolveDeferredLoad(it->first);
+					return it->second;
 				}
 			}
+			return nullptr;
 		}
 
 	private:
+		friend class Prefab;
+
 		// Map from type string pointer to a component type
 		std::unordered_map<const char*, ComponentType> componentTypes{};
 
@@ -204,15 +751,94 @@ namespace ECS {
 		// The component type to be assigned to the next registered component - starting at 0
 		ComponentType nextComponentType{};
 
-		// Convenience function to get the statically casted pointer to the ComponentArray of type T.
+		// Map from type string pointer to the records of a lazy load that have not been copied into the pool yet
+		std::unordered_map<const char*, std::function<void()>> deferredLoads{};
+
+		// Convenience function to get the statically casted pointer to the pool of type T.
 		template<typename T>
-		std::shared_ptr<ComponentArray<T>> GetComponentArray()
+		std::shared_ptr<ComponentStorage<T>> GetComponentArray()
 		{
 			const char* typeName = typeid(T).name();
 			assert(componentTypes.find(typeName) != componentTypes.end() && "Component not registered before use.");
-			return std::static_pointer_cast<ComponentArray<T>>(componentArrays[typeName]);
+			ResolveDeferredLoad(typeName);
+			return std::static_pointer_cast<ComponentStorage<T>>(componentArrays[typeName]);
+		}
+
+	};
+
+	// Type erased default value of one component of a prefab
+	class IPrefabComponent {
+	public:
+		virtual ~IPrefabComponent() = default;
+		// Block copies the default value into the pool for every entity
+		virtual void Instantiate(const Entity* entities, uint32_t count) = 0;
+	};
+
+	template<typename T>
+	class PrefabComponent : public IPrefabComponent {
+	public:
+		PrefabComponent(std::shared_ptr<ComponentStorage<T>> p, T component) : pool{ p }, value{ component } {}
+		void Instantiate(const Entity* entities, uint32_t count) override { pool->InsertRange(entities, count, value); }
+	private:
+		std::shared_ptr<ComponentStorage<T>> pool;
+		T value;
+	};
+
+	// Per instance override applied right after a prefab is instantiated.
+	// Created with Prefab::Patch. The value for instance i is read from data + i * stride
+	struct PrefabPatch {
+		ComponentType type;
+		std::function<void(const Entity* entities, uint32_t count)> apply;
+	};
+
+	// A combination of components that is spawned repeatedly.
+	// The signature, the target pools and the default values are resolved once when the prefab is built
+	// so that Coordinator::Instantiate only has to copy blocks of components.
+	class Prefab {
+	public:
+		Prefab(ComponentManager* cm) : componentManager{ cm } {}
+
+		template<typename T>
+		Prefab& Add(T component)
+		{
+			ComponentType type = componentManager->GetComponentType<T>();
+			assert(!signature.test(type) && "Prefab already has component type");
+
+			signature.set(type, true);
+			components.push_back({ type, std::make_shared<PrefabComponent<T>>(componentManager->GetComponentArray<T>(), component) });
+			return *this;
+		}
+
+		// Overrides one value of every instance through a setter of the component, e.g. Patch(&TransformComponent::setTranslation, positions)
+		// values must hold at least as many elements as the number of instances
+		template<typename T, typename V>
+		PrefabPatch Patch(void (T::* setter)(const V&), const V* values, size_t stride = sizeof(V)) const
+		{
+			ComponentType type = componentManager->GetComponentType<T>();
+			assert(signature.test(type) && "Patching a component the prefab does not have");
+
+			const char* data = reinterpret_cast<const char*>(values);
+			auto pool = componentManager->GetComponentArray<T>();
+			return { type, [pool, setter, data, stride](const Entity* entities, uint32_t count) {
+				pool->ApplyToRange(entities, count, [setter, data, stride](T& component, uint32_t i) {
+					(component.*setter)(*reinterpret_cast<const V*>(data + i * stride));
+				});
+			} };
 		}
 
+		Signature GetSignature() const { return signature; }
+
+	private:
+		friend class Coordinator;
+
+		struct Entry {
+			ComponentType type;
+			std::shared_ptr<IPrefabComponent> component;
+		};
+
+		ComponentManager* componentManager;
+		Signature signature{};
+		std::vector<Entry> components{};
 	};
 
 	class Registry {
@@ -231,15 +857,54 @@ namespace ECS {
 			// Take an ID from the front of the queue
 			Entity id = entityIDQueue.front();
 			entityIDQueue.pop();
+			living[id] = true;
 			++entityCount;
 
 			return id;
 		}
 
+		// Takes count IDs from the queue at once
+		void CreateEntities(Entity* entities, uint32_t count)
+		{
+			assert(entityCount + count <= MAX_ENTITIES && "Too many entities in existence.");
+			for (uint32_t i = 0; i < count; i++)
+			{
+				entities[i] = entityIDQueue.front();
+				entityIDQueue.pop();
+				living[entities[i]] = true;
+			}
+			entityCount += count;
+		}
+
+		// Brings back exactly these IDs, none of which may be alive. Used when a save is loaded
+		void CreateEntitiesWithIds(const Entity* entities, uint32_t count)
+		{
+			if (count == 0) return;
+			assert(entityCount + count <= MAX_ENTITIES && "Too many entities in existence.");
+			for (uint32_t i = 0; i < count; i++)
+			{
+				assert(entities[i] < MAX_ENTITIES && !living[entities[i]] && "Entity already alive.");
+				living[entities[i]] = true;
+			}
+			entityCount += count;
+
+			// Drop the revived IDs from the queue, keeping the order of the others
+			size_t queued = entityIDQueue.size();
+			for (size_t i = 0; i < queued; i++)
+			{
+				Entity id = entityIDQueue.front();
+				entityIDQueue.pop();
+				if (!living[id]) entityIDQueue.push(id);
+			}
+		}
+
 		void DestroyEntity(Entity entity)
 		{
 			assert(entity < MAX_ENTITIES && "Entity out of range.");
+			// A second destroy would queue the ID twice and hand it out to two entities
+			if (!living[entity]) return;
 			signatures[entity].reset();
+			living[entity] = false;
 			// Put the destroyed ID at the back of the queue
 			entityIDQueue.push(entity);
 			--entityCount;
@@ -252,19 +917,54 @@ namespace ECS {
 			signatures[entity] = signature;
 		}
 
-		Signature GetSignature(Entity entity)
+		void SetSignatures(const Entity* entities, uint32_t count, Signature signature)
+		{
+			for (uint32_t i = 0; i < count; i++)
+			{
+				assert(entities[i] < MAX_ENTITIES && "Entity out of range.");
+				signatures[entities[i]] = signature;
+			}
+		}
+
+		Signature GetSignature(Entity entity) const
 		{
 			assert(entity < MAX_ENTITIES && "Entity out of range.");
 			// Get this entity's signature from the array
 			return signatures[entity];
 		}
 
+		bool IsAlive(Entity entity) const
+		{
+			assert(entity < MAX_ENTITIES && "Entity out of range.");
+			return living[entity];
+		}
+
+		uint32_t GetEntityCount() const { return entityCount; }
+
+		// Appends every living entity in increasing ID order
+		void GetLivingEntities(std::vector<Entity>& entities) const
+		{
+			for (Entity entity = 0; entity < MAX_ENTITIES; ++entity)
+			{
+				if (living[entity]) entities.push_back(entity);
+			}
+		}
+
+		// Appends every entity that has all components of include and none of exclude.
+		// Scans the signature array with SSE/AVX2, see signature_scan.h
+		void Scan(Signature include, Signature exclude, std::vector<Entity>& matches) const
+		{
+			ScanSignatures(signatures.data(), MAX_ENTITIES, include, exclude, matches);
+		}
+
 	private:
 		uint32_t entityCount = 0;
 		
 		// Array of signatures where the index corresponds to the entity ID
-		// Signature, bitset indicates which component an entity has
+		// Signature, bit mask indicating which component an entity has
 		std::array<Signature, MAX_ENTITIES> signatures{};
+		// Entities with no components are alive too, so the signatures can't tell
+		std::array<bool, MAX_ENTITIES> living{};
 		std::queue<Entity> entityIDQueue;
 	};
 
@@ -282,9 +982,71 @@ namespace ECS {
 			// Create a pointer to the system and return it so it can be used externally
 			auto system = std::make_shared<T>(_Args...);
 			mSystems.insert({ typeName, system });
+			// Systems are updated in registration order
+			mSchedules.push_back({ typeName, system });
 			return system;
 		}
 
+		template<typename T>
+		void SetSchedule(SystemSchedule schedule)
+		{
+			ScheduleState& state = GetScheduleState(typeid(T).name());
+			state.schedule = schedule;
+			state.accumulator = 0.0f;
+		}
+
+		template<typename T>
+		SystemStats GetStats()
+		{
+			return GetScheduleState(typeid(T).name()).stats;
+		}
+
+		void SetBudgetOverrunCallback(std::function<void(const char* systemName, const SystemStats& stats)> callback)
+		{
+			overrunCallback = callback;
+		}
+
+		void Update(float dt)
+		{
+			for (auto& state : mSchedules)
+			{
+				// Systems with a tick rate wait until a full tick period has accumulated and then get the whole periods
+				// that passed in one update, the part of a period left over carries into the next one. After a hitch
+				// at most MAX_CATCH_UP_TICKS periods are made up, the rest of the stall is dropped
+				float elapsed = dt;
+				if (state.schedule.tickRate > 0.0f)
+				{
+					float period = 1.0f / state.schedule.tickRate;
+					state.accumulator += dt;
+					if (state.accumulator < period) continue;
+					float ticks = std::floor(state.accumulator / period);
+					state.accumulator -= period * ticks;
+					elapsed = period * (std::min)(ticks, float(MAX_CATCH_UP_TICKS));
+				}
+
+				auto start = std::chrono::steady_clock::now();
+				if (state.schedule.budgetMicroseconds > 0)
+				{
+					UpdateSlice(state, elapsed, start);
+				}
+				else
+				{
+					state.system->Update(elapsed);
+				}
+				float micro = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+				state.stats.updateCount++;
+				state.stats.lastUpdateMicroseconds = micro;
+				if (state.schedule.budgetMicroseconds > 0 && micro > state.schedule.budgetMicroseconds)
+				{
+					float overrun = micro - state.schedule.budgetMicroseconds;
+					state.stats.overrunCount++;
+					state.stats.worstOverrunMicroseconds = (std::max)(state.stats.worstOverrunMicroseconds, overrun);
+					if (overrunCallback) overrunCallback(state.name, state.stats);
+				}
+			}
+		}
+
 		template<typename T>
 		void SetSignature(Signature signature)
 		{
@@ -330,7 +1092,100 @@ namespace ECS {
 			}
 		}
 
+		// Same as EntitySignatureChanged but every entity shares one signature, so each system signature is tested once for the batch
+		void EntitiesSignatureChanged(const Entity* entities, uint32_t count, Signature const& entitySignature)
+		{
+			for (auto const& pair : mSystems)
+			{
+				auto const& type = pair.first;
+				auto const& system = pair.second;
+				Signature const& systemSignature = mSignatures[type];
+
+				if ((entitySignature & systemSignature) == systemSignature)
+				{
+					for (uint32_t i = 0; i < count; i++)
+						system->mEntities.insert(system->mEntities.end(), entities[i]);
+				}
+				else
+				{
+					for (uint32_t i = 0; i < count; i++)
+						system->mEntities.erase(entities[i]);
+				}
+			}
+		}
+
 	private:
+		struct ScheduleState {
+			const char* name;
+			std::shared_ptr<EntitySystem> system;
+			SystemSchedule schedule{};
+			SystemStats stats{};
+			float accumulator = 0.0f;
+
+			// Time sliced systems resume from the first entity not below cursor
+			Entity cursor = 0;
+			float sweepTime = 0.0f;
+			float lastSweepTime = 0.0f;
+		};
+
+		// The clock is only read every SLICE_CHECK_INTERVAL entities to keep the overhead per entity low
+		static constexpr uint32_t SLICE_CHECK_INTERVAL = 16;
+		// Most tick periods a system with a tick rate gets in one update after a long frame
+		static constexpr uint32_t MAX_CATCH_UP_TICKS = 4;
+
+		ScheduleState& GetScheduleState(const char* typeName)
+		{
+			for (auto& state : mSchedules)
+			{
+				if (state.name == typeName) return state;
+			}
+			assert(false && "System used before registered.");
+			return mSchedules.front();
+		}
+
+		void UpdateSlice(ScheduleState& state, float dt, std::chrono::steady_clock::time_point start)
+		{
+			auto& entities = state.system->mEntities;
+			auto budget = std::chrono::microseconds(state.schedule.budgetMicroseconds);
+			// The very first sweep has no previous sweep to take its dt from
+			float entityDt = state.lastSweepTime > 0.0f ? state.lastSweepTime : dt;
+			state.sweepTime += dt;
+
+			// UpdateEntity may destroy entities or change signatures, which erases from mEntities and invalidates its
+			// iterators, so the next entity is looked up again from the cursor after every call
+			uint32_t processed = 0;
+			uint32_t total = static_cast<uint32_t>(entities.size());
+			Entity cursor = state.cursor;
+			while (processed < total)
+			{
+				auto it = entities.lower_bound(cursor);
+				if (it == entities.end()) it = entities.begin();
+				if (it == entities.end()) break;
+				Entity entity = *it;
+				state.system->UpdateEntity(entity, entityDt);
+				cursor = entity + 1;
+				++processed;
+				if (entities.lower_bound(cursor) == entities.end())
+				{
+					// Sweep finished, the next entity starts over from the beginning
+					state.lastSweepTime = state.sweepTime;
+					state.sweepTime = 0.0f;
+					cursor = 0;
+				}
+				if (processed % SLICE_CHECK_INTERVAL == 0)
+				{
+					// Stop when the next group of entities is expected to go over the budget
+					auto elapsed = std::chrono::steady_clock::now() - start;
+					if (elapsed + elapsed / processed * SLICE_CHECK_INTERVAL > budget) break;
+				}
+			}
+			state.cursor = cursor;
+			state.stats.lastEntityCount = processed;
+		}
+
+		std::vector<ScheduleState> mSchedules{};
+		std::function<void(const char* systemName, const SystemStats& stats)> overrunCallback{};
+
 		// Map from system type string pointer to a signature
 		std::unordered_map<const char*, Signature> mSignatures{};
 
@@ -338,6 +1193,129 @@ namespace ECS {
 		std::unordered_map<const char*, std::shared_ptr<EntitySystem>> mSystems{};
 	};
 
+	// Persistent ad hoc query such as "all entities with TransformComponent but not CameraComponent".
+	// The matching entities are kept in a contiguous list that is patched on every structural change,
+	// so reading the query costs nothing when the structure has not changed.
+	class Query
+	{
+	public:
+		Query(Signature include, Signature exclude) : includeMask{ include }, excludeMask{ exclude }
+		{
+			indexOf.fill(INVALID_INDEX);
+		}
+
+		bool Matches(Signature const& entitySignature) const
+		{
+			return entitySignature.any()
+				&& entitySignature.contains(includeMask)
+				&& (entitySignature & excludeMask).none();
+		}
+
+		const std::vector<Entity>& Entities() const { return entities; }
+		std::vector<Entity>::const_iterator begin() const { return entities.begin(); }
+		std::vector<Entity>::const_iterator end() const { return entities.end(); }
+		size_t Size() const { return entities.size(); }
+
+		// Incremented every time the entity list changes. Compare against a stored value to skip work derived from the list
+		uint64_t Version() const { return version; }
+
+		Signature Include() const { return includeMask; }
+		Signature Exclude() const { return excludeMask; }
+
+		void EntitySignatureChanged(Entity entity, Signature const& entitySignature)
+		{
+			bool contained = indexOf[entity] != INVALID_INDEX;
+			bool matches = Matches(entitySignature);
+			if (matches && !contained) Add(entity);
+			else if (!matches && contained) Remove(entity);
+		}
+
+		void EntityDestroyed(Entity entity)
+		{
+			if (indexOf[entity] != INVALID_INDEX) Remove(entity);
+		}
+
+	private:
+		static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+		void Add(Entity entity)
+		{
+			indexOf[entity] = static_cast<uint32_t>(entities.size());
+			entities.push_back(entity);
+			++version;
+		}
+
+		// Swap with the last entity to keep the list dense
+		void Remove(Entity entity)
+		{
+			uint32_t index = indexOf[entity];
+			Entity last = entities.back();
+			entities[index] = last;
+			indexOf[last] = index;
+			entities.pop_back();
+			indexOf[entity] = INVALID_INDEX;
+			++version;
+		}
+
+		Signature includeMask;
+		Signature excludeMask;
+		uint64_t version = 0;
+		std::vector<Entity> entities{};
+		// Map from entity ID to its position in entities
+		std::array<uint32_t, MAX_ENTITIES> indexOf;
+	};
+
+	// Owns every query and forwards structural change events to them
+	class QueryManager
+	{
+	public:
+		// Returns the existing query for the masks if there is one, otherwise creates it and fills it from the registry
+		std::shared_ptr<Query> GetQuery(Signature include, Signature exclude, Registry const& registry)
+		{
+			for (auto const& query : queries)
+			{
+				if (query->Include() == include && query->Exclude() == exclude) return query;
+			}
+
+			auto query = std::make_shared<Query>(include, exclude);
+			std::vector<Entity> matches;
+			registry.Scan(include, exclude, matches);
+			for (Entity entity : matches)
+			{
+				query->EntitySignatureChanged(entity, registry.GetSignature(entity));
+			}
+			queries.push_back(query);
+			return query;
+		}
+
+		void EntitySignatureChanged(Entity entity, Signature const& entitySignature)
+		{
+			for (auto const& query : queries) query->EntitySignatureChanged(entity, entitySignature);
+		}
+
+		void EntitiesSignatureChanged(const Entity* entities, uint32_t count, Signature const& entitySignature)
+		{
+			for (auto const& query : queries)
+			{
+				if (!query->Matches(entitySignature)) continue;
+				for (uint32_t i = 0; i < count; i++) query->EntitySignatureChanged(entities[i], entitySignature);
+			}
+		}
+
+		void EntityDestroyed(Entity entity)
+		{
+			for (auto const& query : queries) query->EntityDestroyed(entity);
+		}
+
+	private:
+		std::vector<std::shared_ptr<Query>> queries{};
+	};
+
+	enum class LoadMode {
+		Eager,
+		Lazy
+	};
+
 	class Coordinator
 	{
 	public:
@@ -351,16 +1329,22 @@ namespace ECS {
 			componentManager = std::make_unique<ComponentManager>();
 			registry = std::make_unique<Registry>();
 			systemManager = std::make_unique<SystemManager>();
+			queryManager = std::make_unique<QueryManager>();
 		}
 
 		// Entity methods
 		Entity CreateEntity() { return registry->CreateEntity(); }
 
+		bool IsAlive(Entity entity) const { return registry->IsAlive(entity); }
+
+		// Does nothing when the entity is not alive
 		void DestroyEntity(Entity entity)
 		{
+			if (!registry->IsAlive(entity)) return;
 			registry->DestroyEntity(entity);
 			componentManager->EntityDestroyed(entity);
 			systemManager->EntityDestroyed(entity);
+			queryManager->EntityDestroyed(entity);
 		}
 
 		// Component methods
@@ -377,6 +1361,7 @@ namespace ECS {
 			registry->SetSignature(entity, signature);
 
 			systemManager->EntitySignatureChanged(entity, signature);
+			queryManager->EntitySignatureChanged(entity, signature);
 			return comp;
 		}
 
@@ -390,11 +1375,42 @@ namespace ECS {
 			registry->SetSignature(entity, signature);
 
 			systemManager->EntitySignatureChanged(entity, signature);
+			queryManager->EntitySignatureChanged(entity, signature);
 		}
 
 		template<typename T>
 		T& GetComponent(Entity entity) { return componentManager->GetComponent<T>(entity); }
 
+		// Calls func(entity, component) for every component of type T in storage order
+		template<typename T, typename F>
+		void ForEachComponent(F&& func) { componentManager->ForEachComponent<T>(func); }
+
+		// Prefab methods
+		Prefab CreatePrefab() { return Prefab{ componentManager.get() }; }
+
+		// Creates count entities from a prefab.
+		// Every pool receives one block of components and system membership is updated once for the whole batch
+		std::vector<Entity> Instantiate(const Prefab& prefab, uint32_t count, std::initializer_list<PrefabPatch> patches = {})
+		{
+			std::vector<Entity> entities(count);
+			if (count == 0) return entities;
+			registry->CreateEntities(entities.data(), count);
+
+			for (auto const& entry : prefab.components)
+			{
+				entry.component->Instantiate(entities.data(), count);
+			}
+			for (auto const& patch : patches)
+			{
+				patch.apply(entities.data(), count);
+			}
+
+			registry->SetSignatures(entities.data(), count, prefab.signature);
+			systemManager->EntitiesSignatureChanged(entities.data(), count, prefab.signature);
+			queryManager->EntitiesSignatureChanged(entities.data(), count, prefab.signature);
+			return entities;
+		}
+
 		template<typename T>
 		ComponentType GetComponentType() { return componentManager->GetComponentType<T>(); }
 		
@@ -405,18 +1421,84 @@ namespace ECS {
 		template<typename T>
 		void SetSystemSignature(Signature signature) { systemManager->SetSignature<T>(signature); }
 
-		void Serialize();
-		void Deserialize();
+		// Run T at a fixed tick rate and/or spread its entities over several frames, see SystemSchedule
+		template<typename T>
+		void SetSystemSchedule(SystemSchedule schedule) { systemManager->SetSchedule<T>(schedule); }
+
+		template<typename T>
+		SystemStats GetSystemStats() { return systemManager->GetStats<T>(); }
+
+		void SetBudgetOverrunCallback(std::function<void(const char* systemName, const SystemStats& stats)> callback) { systemManager->SetBudgetOverrunCallback(callback); }
+
+		// Updates every registered system according to its schedule
+		void UpdateSystems(float dt) { systemManager->Update(dt); }
+
+		// Query methods
+		// One off scan over every signature. Use GetQuery instead for queries that are repeated every frame
+		std::vector<Entity> ScanEntities(Signature include, Signature exclude = {})
+		{
+			std::vector<Entity> matches;
+			registry->Scan(include, exclude, matches);
+			return matches;
+		}
+
+		std::shared_ptr<Query> GetQuery(Signature include, Signature exclude = {}) { return queryManager->GetQuery(include, exclude, *registry); }
+
+		// Copies every living entity and every component whose type can be saved into memory, see save_format.h.
+		// Call between frames so the snapshot is consistent. Pools whose version didn't change since previous share
+		// its records instead of being copied again
+		std::shared_ptr<SaveSnapshot> CaptureSnapshot(const SaveSnapshot* previous = nullptr);
+		// Captures and writes on the calling thread, after any pending SerializeAsync to the same path
+		bool Serialize(const char* path = "gameState.dat");
+		// Brings back the entities that are not alive with exactly these IDs, used to replay saves and journals
+		void RestoreEntities(const Entity* entities, uint32_t count);
+		// Sets the component typeName (a typeid name) of every entity from its save record, adding the missing components.
+		// Returns false when the type is not registered or its record size differs
+		bool LoadComponentRecords(const char* typeName, uint32_t recordSize, const Entity* entities, const char* records, uint32_t count);
+		// Removes the component typeName from every entity that has it
+		bool RemoveComponents(const char* typeName, const Entity* entities, uint32_t count);
+
+		// Compressed saves store every block with SaveBlockEncoding::Lz and SaveBlockFilter::DeltaShuffle. On by default
+		void SetSaveCompression(bool compress) { saveCompression = compress; }
+		// Captures on the calling thread and writes on ThreadPool::io(). The future becomes ready when the file is
+		// written, false when writing failed or threw, and onComplete runs on the I/O thread right after. Serialize, Deserialize and Merge of the same path wait
+		// for the write, paths are compared as given
+		std::future<bool> SerializeAsync(const char* path = "gameState.dat", std::function<void(bool success)> onComplete = {});
+		// Replaces the world with the saved one. Entities keep their saved IDs and the components of entities that exist
+		// in both are overwritten in place. Returns false without touching the world when the file is missing, invalid or fails
+		// its checksums.
+		// The file is memory mapped and the records are copied straight from the mapping into the pools.
+		// LoadMode::Lazy sets up entities, signatures and systems right away but copies the records of a pool only
+		// when the pool is first used, the mapping stays open until then. Saving fills the remaining pools first, so the
+		// mapping is released before the same file is replaced
+		bool Deserialize(const char* path = "gameState.dat", LoadMode mode = LoadMode::Eager);
+		// Adds the saved world to the live one, for streaming in level chunks. Every saved entity gets a fresh ID and
+		// the entity fields of its components (see HasEntityFields) are translated to the new IDs. Returns false without
+		// touching the world when the file is invalid or there are not enough free entities.
+		// created receives the new IDs in the order of the saved entity list
+		bool Merge(const char* path, std::vector<Entity>* created = nullptr);
+		// CRC-32C of the living entities and the save records of every pool, for telling whether two worlds diverged,
+		// e.g. a deterministic replay and its recording. Pools are hashed in parallel and combined in type name order.
+		// Components are hashed in pool order, so equal worlds whose pools were filled in a different order hash differently
+		uint32_t StateHash();
 
 		Coordinator() = default;
 		Coordinator(const Coordinator&) = delete;
 		Coordinator operator=(const Coordinator&) = delete;
 
 	private:
+		// Blocks until the SerializeAsync calls to path have finished writing
+		void WaitForPendingSave(const char* path);
+
 		static Coordinator* _globalCoordinator;
 
 		std::unique_ptr<ComponentManager> componentManager;
 		std::unique_ptr<Registry> registry;
 		std::unique_ptr<SystemManager> systemManager;
+		std::unique_ptr<QueryManager> queryManager;
+
+		bool saveCompression = true;
+		// Latest SerializeAsync per path. ThreadPool::io() writes in submission order, so it finishes after the earlier ones
+		std::unordered_map<std::string, std::shared_future<void>> pendingSaves;
 	};
 }
\ No newline at end of file
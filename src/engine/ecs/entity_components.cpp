@@ -1,5 +1,6 @@
 #include "entity_components.h"
 #include <iostream>
+#include <cstring>
 glm::mat3 TransformComponent::mat3()
 {
     float cos = glm::cos(rotation);
@@ -18,3 +19,17 @@ glm::mat3 TransformComponent::mat3()
         glm::vec3(translation.x + localTranslation.x, translation.y + localTranslation.y, zOrder)
     };
 }
+
+glm::mat3 TransformComponent::interpolatedMat3(float alpha)
+{
+    glm::vec2 current = translation + localTranslation;
+    // Components created during the current step have nothing to blend from
+    glm::vec2 previous = hasPreviousState ? previousTranslation : current;
+    glm::vec2 blended = previous + (current - previous) * alpha;
+    return {
+        glm::vec3(1.0f,0.0f,0.0f),
+        glm::vec3(0.0f,1.0f,0.0f),
+        glm::vec3(blended.x, blended.y, zOrder)
+    };
+}
+
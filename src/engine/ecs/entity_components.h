@@ -1,19 +1,35 @@
 #pragma once
 
+#include "component_reflection.h"
+
 #include <glm/glm.hpp>
-#include <fstream>
+#include <cassert>
+#include <cstdint>
 #include <iostream>
 
+// Components are saved through their REFLECT_COMPONENT field list (see component_reflection.h). Components whose
+// record can't be described by fields derive from this and declare
+//     static constexpr uint32_t SERIALIZED_SIZE = ...;
+// Serialize packs the component into a record of exactly SERIALIZED_SIZE bytes and Deserialize unpacks it.
+// Every other trivially copyable component is saved as its raw bytes
 struct SerializableComponent {
-	virtual void Serialize(std::ofstream& fs) { throw("Serialize NOT IMPLEMENTED"); }
-	virtual void Deserialize(std::ifstream& fs) { throw("Deserialize NOT IMPLEMENTED"); }
+	virtual void Serialize(char* record) const { throw("Serialize NOT IMPLEMENTED"); }
+	virtual void Deserialize(const char* record) { throw("Deserialize NOT IMPLEMENTED"); }
 };
 
-struct TransformComponent : public SerializableComponent{
+struct TransformComponent {
+	// Pointers to transforms are kept around (App::run keeps the one returned by AddComponent) so they must never move
+	static constexpr bool STABLE_ADDRESS = true;
+
 	TransformComponent() = default;
 	TransformComponent(float x, float y, uint32_t z) { translation = { x,y }; zOrder = z; }
 
 	glm::mat3	mat3();
+	// Same as mat3 but blends the translation from the previous simulation step, alpha of 1 is the current state
+	glm::mat3	interpolatedMat3(float alpha);
+
+	// Called at the start of every fixed simulation step so rendering can interpolate between steps
+	void		storePreviousState() { previousTranslation = translation + localTranslation; hasPreviousState = true; }
 
 	glm::vec2	getTranslation() const { return translation; }
 	void		setTranslation(const glm::vec2& _translation) { translation = _translation; }
@@ -37,55 +53,141 @@ struct TransformComponent : public SerializableComponent{
 
 	//Internally, y cooridnate is flipped.
 
-	void Serialize(std::ofstream& fs) override {
-		fs.write( reinterpret_cast<const char*>(&translation.x), sizeof(float));
-		fs.write( reinterpret_cast<const char*>(&translation.y), sizeof(float));
-		fs.write( reinterpret_cast<const char*>(&scale.x), sizeof(float));
-		fs.write( reinterpret_cast<const char*>(&scale.y), sizeof(float));
-		fs.write( reinterpret_cast<const char*>(&rotation), sizeof(float));
+	// The previous state is not saved
+	REFLECT_COMPONENT(TransformComponent, translation, scale, rotation, localTranslation, localScale, localRotation, zOrder)
+	// A loaded transform has no previous state to interpolate from
+	void OnLoaded() { hasPreviousState = false; }
 
-		fs.write( reinterpret_cast<const char*>(&localTranslation.x), sizeof(float));
-		fs.write( reinterpret_cast<const char*>(&localTranslation.y), sizeof(float));
-		fs.write( reinterpret_cast<const char*>(&localScale.x), sizeof(float));
-		fs.write( reinterpret_cast<const char*>(&localScale.y), sizeof(float));
+private:
+	glm::vec2 translation = { 0.0f, 0.0f };
+	glm::vec2 scale = { 1.0f, 1.0f };
+	float rotation = 0.0f;
 
-		fs.write( reinterpret_cast<const char*>(&localRotation), sizeof(float));
+	glm::vec2 localTranslation = { 0.0f, 0.0f };
+	glm::vec2 localScale = { 1.0f, 1.0f };
+	float localRotation = 0.0f;
 
-		fs.write( reinterpret_cast<const char*>(&zOrder), sizeof(uint32_t));
+	uint32_t zOrder = 0;
 
-		std::cout << "Serialized TransformComponent\n";
-	}
+	// World state at the start of the current simulation step. Not serialized
+	glm::vec2 previousTranslation = { 0.0f, 0.0f };
+	bool hasPreviousState = false;
+};
 
-	void Deserialize(std::ifstream& fs) override {
-		fs.read(reinterpret_cast<char*>(&translation.x), sizeof(float));
-		fs.read(reinterpret_cast<char*>(&translation.y), sizeof(float));
-		fs.read(reinterpret_cast<char*>(&scale.x), sizeof(float));
-		fs.read(reinterpret_cast<char*>(&scale.y), sizeof(float));
-		fs.read(reinterpret_cast<char*>(&rotation), sizeof(float));
+// Local box around the transform's world translation, used by the broadphase.
+// The default matches the sprite quad, which spans -1..1 on both axes
+struct BoundsComponent {
+	glm::vec2 halfExtents = { 1.0f, 1.0f };
+	glm::vec2 offset = { 0.0f, 0.0f };
 
-		fs.read(reinterpret_cast<char*>(&localTranslation.x), sizeof(float));
-		fs.read(reinterpret_cast<char*>(&localTranslation.y), sizeof(float));
-		fs.read(reinterpret_cast<char*>(&localScale.x), sizeof(float));
-		fs.read(reinterpret_cast<char*>(&localScale.y), sizeof(float));
+	REFLECT_COMPONENT(BoundsComponent, halfExtents, offset)
+};
 
-		fs.read(reinterpret_cast<char*>(&localRotation), sizeof(float));
+enum class ColliderShape : uint8_t {
+	Circle,
+	AABB,
+	OrientedBox,
+	Polygon
+};
 
-		fs.read(reinterpret_cast<char*>(&zOrder), sizeof(uint32_t));
-		std::cout << "Deserialized TransformComponent\n";
+// Shape used by the CollisionSystem, relative to the transform's world translation.
+// Oriented boxes and polygons also turn with the transform's world rotation, AABBs never rotate.
+// The entity's BoundsComponent has to enclose the shape or the broadphase will miss its pairs
+struct ColliderComponent {
+	static constexpr uint32_t MAX_POLYGON_VERTICES = 8;
+
+	ColliderShape shape = ColliderShape::AABB;
+	glm::vec2 offset = { 0.0f, 0.0f };
+	// Circle
+	float radius = 1.0f;
+	// AABB and OrientedBox
+	glm::vec2 halfExtents = { 1.0f, 1.0f };
+	// OrientedBox and Polygon, added to the transform's rotation
+	float angle = 0.0f;
+	// Polygon, convex
+	uint32_t vertexCount = 0;
+	glm::vec2 vertices[MAX_POLYGON_VERTICES] = {};
+
+	REFLECT_COMPONENT(ColliderComponent, shape, offset, radius, halfExtents, angle, vertexCount, vertices)
+	// Loaded records are not trusted: the collision system indexes vertices by vertexCount. A polygon with too few
+	// vertices and an unknown shape fall back to the box
+	void OnLoaded()
+	{
+		if (vertexCount > MAX_POLYGON_VERTICES) vertexCount = MAX_POLYGON_VERTICES;
+		if (shape > ColliderShape::Polygon || (shape == ColliderShape::Polygon && vertexCount < 3)) {
+			shape = ColliderShape::AABB;
+			vertexCount = 0;
+		}
 	}
 
-private:
-	glm::vec2 translation = { 0.0f, 0.0f };
-	glm::vec2 scale = { 1.0f, 1.0f };
-	float rotation = 0.0f;
+	static ColliderComponent MakeCircle(float radius) { ColliderComponent c; c.shape = ColliderShape::Circle; c.radius = radius; return c; }
+	static ColliderComponent MakeAABB(const glm::vec2& halfExtents) { ColliderComponent c; c.shape = ColliderShape::AABB; c.halfExtents = halfExtents; return c; }
+	static ColliderComponent MakeOrientedBox(const glm::vec2& halfExtents, float angle) { ColliderComponent c; c.shape = ColliderShape::OrientedBox; c.halfExtents = halfExtents; c.angle = angle; return c; }
+	static ColliderComponent MakePolygon(const glm::vec2* points, uint32_t count)
+	{
+		assert(count >= 3 && count <= MAX_POLYGON_VERTICES && "Polygon collider needs 3 to MAX_POLYGON_VERTICES vertices.");
+		ColliderComponent c;
+		c.shape = ColliderShape::Polygon;
+		c.vertexCount = count;
+		for (uint32_t i = 0; i < count; i++) c.vertices[i] = points[i];
+		return c;
+	}
+};
 
-	glm::vec2 localTranslation = { 0.0f, 0.0f };
-	glm::vec2 localScale = { 1.0f, 1.0f };
-	float localRotation = 0.0f;
+struct VelocityComponent {
+	glm::vec2 linear = { 0.0f, 0.0f };
+	// Radians per second
+	float angular = 0.0f;
 
-	uint32_t zOrder;
+	REFLECT_COMPONENT(VelocityComponent, linear, angular)
 };
 
+// A mass of 0 makes the body kinematic: it moves with its velocity but gravity and contacts never change it
+struct MassComponent {
+	float mass = 1.0f;
+	float restitution = 0.0f;
+	float friction = 0.5f;
+	float gravityScale = 1.0f;
+	float linearDamping = 0.0f;
+
+	REFLECT_COMPONENT(MassComponent, mass, restitution, friction, gravityScale, linearDamping)
+};
+
+// Spawns particles around the transform's world translation. The particles themselves live in SoA pools owned by the
+// ParticleRenderSystem, one per emitter, so they never become entities
+struct ParticleEmitterComponent {
+	// Particles alive at once, further spawns are dropped while the pool is full
+	uint32_t capacity = 10000;
+	// Particles per second
+	float rate = 1000.0f;
+	// Seconds, each particle gets lifetime +- lifetimeVariance
+	float lifetime = 1.0f;
+	float lifetimeVariance = 0.0f;
+	// Spawn offset from the transform, uniform in +- spawnExtents
+	glm::vec2 spawnExtents = { 0.0f, 0.0f };
+	// Each particle gets velocity +- velocityVariance per axis
+	glm::vec2 velocity = { 0.0f, 1.0f };
+	glm::vec2 velocityVariance = { 0.5f, 0.5f };
+	glm::vec2 acceleration = { 0.0f, -9.81f };
+	// Blended over a particle's life and multiplied with its own spawn color
+	glm::vec4 startColor = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glm::vec4 endColor = { 1.0f, 1.0f, 1.0f, 0.0f };
+	// Each channel of the spawn color is 1 - rand * colorVariance
+	float colorVariance = 0.0f;
+	// Half size of the particle quad in world units
+	float size = 0.05f;
+	bool emitting = true;
+
+	REFLECT_COMPONENT(ParticleEmitterComponent, capacity, rate, lifetime, lifetimeVariance, spawnExtents, velocity, velocityVariance,
+		acceleration, startColor, endColor, colorVariance, size, emitting)
+};
+
+// Same settings as ParticleEmitterComponent, but the particles live only in GPU storage buffers and are spawned and
+// moved by compute shaders (GpuParticleRenderSystem). Nothing about them can be read back on the CPU
+struct GpuParticleEmitterComponent : ParticleEmitterComponent {};
+
 struct CameraComponent {
 	bool active = false;
+
+	REFLECT_COMPONENT(CameraComponent, active)
 };
\ No newline at end of file
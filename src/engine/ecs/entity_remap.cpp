@@ -0,0 +1,86 @@
+#include "entity_remap.h"
+#include "../cpu_features.h"
+
+#include <cstring>
+
+// The gather is picked at runtime, the build itself only assumes SSE2
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#define ENTITY_REMAP_AVX2
+#if defined(_MSC_VER)
+#define AVX2_TARGET
+#else
+// Compiled for AVX2 on its own, only called after cpuHasAvx2
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+	inline uint32_t remapOne(uint32_t id, const uint32_t* remap, uint32_t tableSize)
+	{
+		return id < tableSize ? remap[id] : id;
+	}
+
+#ifdef ENTITY_REMAP_AVX2
+	// Lanes whose ID is inside the table gather their new ID, the others keep the old one
+	AVX2_TARGET inline __m256i remapLanes(__m256i ids, const uint32_t* remap, __m256i lastIndex)
+	{
+		__m256i inside = _mm256_cmpeq_epi32(_mm256_min_epu32(ids, lastIndex), ids);
+		return _mm256_mask_i32gather_epi32(ids, reinterpret_cast<const int*>(remap), ids, inside, 4);
+	}
+
+	// Both translate whole groups of eight from 0 and return the first index that was not translated
+	AVX2_TARGET uint32_t remapIdsAvx2(const uint32_t* input, uint32_t* output, uint32_t count, const uint32_t* remap, uint32_t tableSize)
+	{
+		const __m256i lastIndex = _mm256_set1_epi32(static_cast<int>(tableSize - 1));
+		uint32_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256i ids = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), remapLanes(ids, remap, lastIndex));
+		}
+		return i;
+	}
+
+	AVX2_TARGET uint32_t remapFieldAvx2(char* field, uint32_t count, uint32_t recordSize, const uint32_t* remap, uint32_t tableSize)
+	{
+		// The fields are gathered out of the records too, AVX2 has no scatter so they are stored one by one
+		const __m256i lastIndex = _mm256_set1_epi32(static_cast<int>(tableSize - 1));
+		const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m256i stride = _mm256_set1_epi32(static_cast<int>(recordSize));
+		alignas(32) uint32_t translated[8];
+		uint32_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			char* base = field + uint64_t(i) * recordSize;
+			__m256i ids = _mm256_i32gather_epi32(reinterpret_cast<const int*>(base), _mm256_mullo_epi32(lane, stride), 1);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(translated), remapLanes(ids, remap, lastIndex));
+			for (uint32_t j = 0; j < 8; j++) std::memcpy(base + uint64_t(j) * recordSize, &translated[j], sizeof(uint32_t));
+		}
+		return i;
+	}
+#endif
+}
+
+void ECS::RemapEntityIds(const uint32_t* input, uint32_t* output, uint32_t count, const uint32_t* remap, uint32_t tableSize)
+{
+	uint32_t i = 0;
+#ifdef ENTITY_REMAP_AVX2
+	if (tableSize > 0 && cpuHasAvx2()) i = remapIdsAvx2(input, output, count, remap, tableSize);
+#endif
+	for (; i < count; i++) output[i] = remapOne(input[i], remap, tableSize);
+}
+
+void ECS::RemapEntityField(char* records, uint32_t count, uint32_t recordSize, uint32_t fieldOffset, const uint32_t* remap, uint32_t tableSize)
+{
+	char* field = records + fieldOffset;
+	uint32_t i = 0;
+#ifdef ENTITY_REMAP_AVX2
+	if (tableSize > 0 && cpuHasAvx2()) i = remapFieldAvx2(field, count, recordSize, remap, tableSize);
+#endif
+	for (; i < count; i++) {
+		char* at = field + uint64_t(i) * recordSize;
+		uint32_t id;
+		std::memcpy(&id, at, sizeof(uint32_t));
+		id = remapOne(id, remap, tableSize);
+		std::memcpy(at, &id, sizeof(uint32_t));
+	}
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+
+// Translation of saved entity IDs into the IDs they got in the live world, used when a save is merged.
+// remap is a dense table indexed by the saved ID. On CPUs with AVX2 eight IDs are translated per gather.
+namespace ECS {
+	// output[i] = remap[input[i]]. IDs of tableSize or more are copied unchanged, so sentinel IDs survive
+	void RemapEntityIds(const uint32_t* input, uint32_t* output, uint32_t count, const uint32_t* remap, uint32_t tableSize);
+
+	// Same for the uint32_t ID at fieldOffset of each of count records of recordSize bytes, translated in place
+	void RemapEntityField(char* records, uint32_t count, uint32_t recordSize, uint32_t fieldOffset, const uint32_t* remap, uint32_t tableSize);
+}
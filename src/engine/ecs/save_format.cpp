@@ -0,0 +1,171 @@
+#include "save_format.h"
+#include "../thread_pool.h"
+#include "../file_writer.h"
+#include "../compression/lz.h"
+#include "../compression/filters.h"
+#include "../compression/crc32c.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    // Stride of the delta filter over the records of a block, 0 when the records are not made of whole words
+    uint32_t RecordStride(const ECS::SaveBlockEntry& entry)
+    {
+        return entry.recordSize % 4 == 0 ? entry.recordSize / 4 : 0;
+    }
+
+    // Entity IDs are always 4 byte aligned, the records start at SaveRecordsOffset
+    void DeltaEncodeBlock(const ECS::SaveBlockEntry& entry, char* data)
+    {
+        compression::deltaEncode32(data, uint64_t(entry.count) * 4, 1);
+        if (entry.kind == ECS::SaveBlockKind::Components) {
+            compression::deltaEncode32(data + ECS::SaveRecordsOffset(entry.count), uint64_t(entry.count) * entry.recordSize, RecordStride(entry));
+        }
+    }
+
+    void DeltaDecodeBlock(const ECS::SaveBlockEntry& entry, char* data)
+    {
+        compression::deltaDecode32(data, uint64_t(entry.count) * 4, 1);
+        if (entry.kind == ECS::SaveBlockKind::Components) {
+            compression::deltaDecode32(data + ECS::SaveRecordsOffset(entry.count), uint64_t(entry.count) * entry.recordSize, RecordStride(entry));
+        }
+    }
+}
+
+void ECS::EncodeSaveBlock(const std::vector<char>& raw, SaveBlockEntry& entry, std::vector<char>& stored)
+{
+    entry.rawSize = raw.size();
+    if (entry.encoding == SaveBlockEncoding::Raw || raw.empty()) {
+        entry.encoding = SaveBlockEncoding::Raw;
+        entry.filter = SaveBlockFilter::None;
+        entry.size = raw.size();
+        stored.clear();
+        return;
+    }
+
+    const char* input = raw.data();
+    std::vector<char> filtered;
+    if (entry.filter != SaveBlockFilter::None) {
+        std::vector<char> delta;
+        if (entry.filter == SaveBlockFilter::DeltaShuffle) {
+            delta = raw;
+            DeltaEncodeBlock(entry, delta.data());
+            input = delta.data();
+        }
+        filtered.resize(raw.size());
+        compression::shuffle32(input, filtered.data(), raw.size());
+        input = filtered.data();
+    }
+
+    stored.resize(compression::lzCompressBound(raw.size()));
+    size_t size = compression::lzCompress(input, raw.size(), stored.data());
+    if (size >= raw.size()) {
+        // Not worth decoding on load
+        entry.encoding = SaveBlockEncoding::Raw;
+        entry.filter = SaveBlockFilter::None;
+        entry.size = raw.size();
+        stored.clear();
+        return;
+    }
+    stored.resize(size);
+    entry.size = size;
+}
+
+bool ECS::DecodeSaveBlock(const SaveBlockEntry& entry, const char* stored, std::vector<char>& raw)
+{
+    raw.resize(entry.rawSize);
+    if (entry.encoding != SaveBlockEncoding::Lz) return false;
+
+    std::vector<char> filtered;
+    char* output = raw.data();
+    if (entry.filter != SaveBlockFilter::None) {
+        filtered.resize(entry.rawSize);
+        output = filtered.data();
+    }
+    if (!compression::lzDecompress(stored, entry.size, output, entry.rawSize)) return false;
+
+    if (entry.filter != SaveBlockFilter::None) {
+        compression::unshuffle32(filtered.data(), raw.data(), entry.rawSize);
+        if (entry.filter == SaveBlockFilter::DeltaShuffle) DeltaDecodeBlock(entry, raw.data());
+    }
+    return true;
+}
+
+uint32_t ECS::SaveHeaderChecksum(const SaveHeader& header, const SaveBlockEntry* toc)
+{
+    SaveHeader zeroed = header;
+    zeroed.checksum = 0;
+    uint32_t crc = compression::crc32c(&zeroed, sizeof(SaveHeader));
+    return compression::crc32c(toc, sizeof(SaveBlockEntry) * header.blockCount, crc);
+}
+
+bool ECS::ReadSaveHeader(const char* path, SaveHeader& header)
+{
+    std::ifstream fs(path, std::ios::binary);
+    if (!fs.read(reinterpret_cast<char*>(&header), sizeof(SaveHeader))) return false;
+    return std::memcmp(header.magic, SAVE_MAGIC, sizeof(SAVE_MAGIC)) == 0 && header.version == SAVE_VERSION;
+}
+
+bool ECS::WriteSaveFile(const SaveSnapshot& snapshot, const char* path)
+{
+    // Blocks are independent, each is filtered and compressed on its own worker
+    std::vector<SaveBlockEntry> toc(snapshot.blocks.size());
+    std::vector<std::vector<char>> encoded(snapshot.blocks.size());
+    ThreadPool::global().parallelFor(static_cast<uint32_t>(snapshot.blocks.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t i = begin; i < end; i++) {
+            toc[i] = snapshot.blocks[i].entry;
+            EncodeSaveBlock(*snapshot.blocks[i].data, toc[i], encoded[i]);
+            const std::vector<char>& stored = toc[i].encoding == SaveBlockEncoding::Raw ? *snapshot.blocks[i].data : encoded[i];
+            toc[i].checksum = compression::crc32c(stored.data(), toc[i].size);
+        }
+    });
+
+    SaveHeader header{};
+    std::memcpy(header.magic, SAVE_MAGIC, sizeof(SAVE_MAGIC));
+    header.version = SAVE_VERSION;
+    header.blockCount = static_cast<uint32_t>(snapshot.blocks.size());
+    header.entityCount = snapshot.blocks.empty() ? 0 : snapshot.blocks[0].entry.count;
+    header.generation = snapshot.generation;
+
+    uint64_t offset = AlignSaveOffset(sizeof(SaveHeader) + sizeof(SaveBlockEntry) * toc.size());
+    for (auto& entry : toc) {
+        entry.offset = offset;
+        offset = AlignSaveOffset(offset + entry.size);
+    }
+    header.fileSize = offset;
+    header.checksum = SaveHeaderChecksum(header, toc.data());
+
+    // Header, table of contents, blocks and their padding go out in one gather write straight from the block buffers
+    static const char padding[SAVE_BLOCK_ALIGNMENT] = {};
+    std::vector<WriteSlice> slices;
+    slices.reserve(toc.size() * 2 + 3);
+    slices.push_back({ &header, sizeof(SaveHeader) });
+    slices.push_back({ toc.data(), sizeof(SaveBlockEntry) * toc.size() });
+    uint64_t written = sizeof(SaveHeader) + sizeof(SaveBlockEntry) * toc.size();
+    for (size_t i = 0; i < toc.size(); i++) {
+        slices.push_back({ padding, toc[i].offset - written });
+        const std::vector<char>& stored = toc[i].encoding == SaveBlockEncoding::Raw ? *snapshot.blocks[i].data : encoded[i];
+        slices.push_back({ stored.data(), toc[i].size });
+        written = toc[i].offset + toc[i].size;
+    }
+    slices.push_back({ padding, header.fileSize - written });
+
+    std::string temporary = std::string(path) + ".tmp";
+    if (!writeFileGather(temporary.c_str(), slices.data(), slices.size())) {
+        std::cerr << "Failed to write " << temporary << "\n";
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    // The previous save stays intact until the new one is completely on disk
+    if (!replaceFile(temporary.c_str(), path)) {
+        std::cerr << "Failed to replace " << path << "\n";
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+// Layout of the save file written by Coordinator::Serialize. Integers are little endian.
+//
+//   SaveHeader
+//   SaveBlockEntry[blockCount]     table of contents
+//   blocks                         each block starts at a multiple of SAVE_BLOCK_ALIGNMENT
+//
+// The first block lists every living entity as a uint32_t array. Every other block holds one component pool:
+// the entity IDs of the pool, padded to SAVE_BLOCK_ALIGNMENT, followed by one recordSize byte record per entity
+// in the same order. Loading reads the header and table of contents, then every block with a single read.
+// A reflected component (see component_reflection.h) also gets a layout block of the same name holding one
+// SaveFieldEntry per field of its records.
+//
+// A block may be stored encoded: its 32 bit words are first filtered (see SaveBlockFilter) and the result is
+// compressed with compression::lzCompress. size is then the stored size and rawSize the size after decoding.
+//
+// Every block carries the CRC-32C of its stored bytes and the header the CRC-32C of itself and the table of contents,
+// see compression/crc32c.h. A load rejects the file when any of them does not match.
+namespace ECS {
+	constexpr char SAVE_MAGIC[4] = { 'F', 'B', 'S', 'V' };
+	// Bumped on every change to the layout, older files are rejected
+	constexpr uint32_t SAVE_VERSION = 5;
+	constexpr uint64_t SAVE_BLOCK_ALIGNMENT = 64;
+	// Room for the typeid name of a component, including the terminating zero
+	constexpr uint32_t SAVE_NAME_SIZE = 84;
+	constexpr uint32_t SAVE_FIELD_NAME_SIZE = 48;
+
+	enum class SaveBlockKind : uint32_t {
+		Entities = 0,
+		Components = 1,
+		Layout = 2
+	};
+
+	enum class SaveBlockEncoding : uint16_t {
+		Raw = 0,
+		Lz = 1
+	};
+
+	// Applied before compression, undone after decompression
+	enum class SaveBlockFilter : uint16_t {
+		None = 0,
+		// compression::shuffle32 over the whole block
+		Shuffle = 1,
+		// compression::deltaEncode32 of the entity IDs against the previous ID and of each record against the
+		// previous record (when recordSize is a multiple of 4), then Shuffle
+		DeltaShuffle = 2
+	};
+
+	struct SaveHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t blockCount;
+		uint32_t entityCount;
+		uint64_t fileSize;
+		// Identifies the save, an autosave journal only applies to the checkpoint with its generation
+		uint64_t generation;
+		// CRC-32C of the header with this field set to 0, followed by the table of contents
+		uint32_t checksum;
+		uint32_t reserved;
+	};
+
+	struct SaveBlockEntry {
+		// typeid name of the component, empty for the entity block
+		char name[SAVE_NAME_SIZE];
+		SaveBlockKind kind;
+		uint32_t count;
+		// Bytes per component, 0 for the entity block
+		uint32_t recordSize;
+		SaveBlockEncoding encoding;
+		SaveBlockFilter filter;
+		// CRC-32C of the stored bytes, filled in by WriteSaveFile
+		uint32_t checksum;
+		// Absolute file offset and stored size of the block, without the padding that follows it
+		uint64_t offset;
+		uint64_t size;
+		// Size of the block after decoding, equal to size for raw blocks
+		uint64_t rawSize;
+	};
+
+	// Scalars a reflected field is made of
+	enum class SaveFieldType : uint32_t {
+		// Copied only into a field of the same size
+		Opaque = 0,
+		Float32 = 1,
+		Int32 = 2,
+		UInt32 = 3,
+		Int8 = 4,
+		UInt8 = 5,
+		Bool = 6
+	};
+
+	struct SaveFieldEntry {
+		char name[SAVE_FIELD_NAME_SIZE];
+		SaveFieldType type;
+		// Offset in the record
+		uint32_t offset;
+		uint32_t size;
+		uint32_t reserved;
+	};
+
+	static_assert(sizeof(SaveHeader) == 40, "SaveHeader layout changed, bump SAVE_VERSION");
+	static_assert(sizeof(SaveBlockEntry) == 128, "SaveBlockEntry layout changed, bump SAVE_VERSION");
+	static_assert(sizeof(SaveFieldEntry) == 64, "SaveFieldEntry layout changed, bump SAVE_VERSION");
+
+	inline uint64_t AlignSaveOffset(uint64_t offset)
+	{
+		return (offset + SAVE_BLOCK_ALIGNMENT - 1) & ~(SAVE_BLOCK_ALIGNMENT - 1);
+	}
+
+	// Offset of the first record inside a component block of count entities
+	inline uint64_t SaveRecordsOffset(uint32_t count)
+	{
+		return AlignSaveOffset(uint64_t(count) * sizeof(uint32_t));
+	}
+
+	// Blocks of a world captured by Coordinator::CaptureSnapshot. The first block is the entity block.
+	// Owns copies of the records, so it can be written on any thread while the world keeps changing
+	struct SaveSnapshot {
+		struct Block {
+			// The requested encoding and filter, offset and sizes are filled in by WriteSaveFile
+			SaveBlockEntry entry;
+			// Raw block, never changed once captured. Shared with the previous snapshot when the pool didn't change
+			std::shared_ptr<const std::vector<char>> data;
+			// IComponentArray::poolId and Version() of a component block at capture, 0 for every other block
+			uint64_t poolId = 0;
+			uint64_t version = 0;
+		};
+		std::vector<Block> blocks;
+		uint64_t generation = 0;
+	};
+
+	// Lays out the snapshot and writes it next to path first, then replaces path so that a failed or interrupted
+	// write never destroys the previous save. Encoded blocks are compressed in parallel on ThreadPool::global(),
+	// blocks that don't get smaller are stored raw. Safe to call from any thread that is not a worker of the global pool
+	bool WriteSaveFile(const SaveSnapshot& snapshot, const char* path);
+
+	// CRC-32C that SaveHeader::checksum must hold for header and toc
+	uint32_t SaveHeaderChecksum(const SaveHeader& header, const SaveBlockEntry* toc);
+
+	// Reads and checks the magic and version of the header of a save file without loading it
+	bool ReadSaveHeader(const char* path, SaveHeader& header);
+
+	// Fills in encoding, filter, size and rawSize of entry and the stored bytes of a raw block
+	void EncodeSaveBlock(const std::vector<char>& raw, SaveBlockEntry& entry, std::vector<char>& stored);
+	// Decodes the stored bytes of an encoded block into raw, which is resized to entry.rawSize.
+	// Returns false when the block is corrupt
+	bool DecodeSaveBlock(const SaveBlockEntry& entry, const char* stored, std::vector<char>& raw);
+}
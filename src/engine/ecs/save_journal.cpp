@@ -0,0 +1,275 @@
+#include "save_journal.h"
+#include "../mapped_file.h"
+#include "../thread_pool.h"
+#include "../compression/crc32c.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    constexpr uint32_t NOT_IN_BLOCK = UINT32_MAX;
+
+    void AppendBytes(std::vector<char>& out, const void* data, size_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    const ECS::SaveSnapshot::Block* FindBlock(const ECS::SaveSnapshot& snapshot, const ECS::SaveBlockEntry& entry)
+    {
+        for (auto const& block : snapshot.blocks) {
+            if (block.entry.kind == entry.kind && std::strcmp(block.entry.name, entry.name) == 0) return &block;
+        }
+        return nullptr;
+    }
+
+    // Appends what changed between before and after, nothing when they are equal.
+    // Records are compared byte for byte, so only the components that were written to since before end up in the frame
+    uint32_t DiffBlock(const ECS::SaveSnapshot::Block* before, const ECS::SaveSnapshot::Block& after, std::vector<char>& out)
+    {
+        // Pools that didn't change since before share its records
+        if (before != nullptr && before->data == after.data) return 0;
+
+        const ECS::SaveBlockEntry& entry = after.entry;
+        uint32_t recordSize = entry.recordSize;
+        if (before != nullptr && before->entry.recordSize != recordSize) before = nullptr;
+
+        const Entity* afterIds = reinterpret_cast<const Entity*>(after.data->data());
+        const char* afterRecords = after.data->data() + ECS::SaveRecordsOffset(entry.count);
+
+        std::vector<uint32_t> beforeIndex(MAX_ENTITIES, NOT_IN_BLOCK);
+        std::vector<Entity> removed;
+        std::vector<uint32_t> changed;
+        if (before != nullptr) {
+            const Entity* beforeIds = reinterpret_cast<const Entity*>(before->data->data());
+            for (uint32_t i = 0; i < before->entry.count; i++) beforeIndex[beforeIds[i]] = i;
+
+            std::vector<bool> present(MAX_ENTITIES, false);
+            for (uint32_t i = 0; i < entry.count; i++) present[afterIds[i]] = true;
+            for (uint32_t i = 0; i < before->entry.count; i++) {
+                if (!present[beforeIds[i]]) removed.push_back(beforeIds[i]);
+            }
+        }
+
+        const char* beforeRecords = before != nullptr ? before->data->data() + ECS::SaveRecordsOffset(before->entry.count) : nullptr;
+        for (uint32_t i = 0; i < entry.count; i++) {
+            uint32_t index = beforeIndex[afterIds[i]];
+            if (index == NOT_IN_BLOCK || std::memcmp(beforeRecords + uint64_t(index) * recordSize, afterRecords + uint64_t(i) * recordSize, recordSize) != 0) {
+                changed.push_back(i);
+            }
+        }
+        if (removed.empty() && changed.empty()) return 0;
+
+        ECS::JournalBlockHeader header{};
+        std::memcpy(header.name, entry.name, ECS::SAVE_NAME_SIZE);
+        header.kind = entry.kind;
+        header.recordSize = recordSize;
+        header.removedCount = static_cast<uint32_t>(removed.size());
+        header.changedCount = static_cast<uint32_t>(changed.size());
+        AppendBytes(out, &header, sizeof(header));
+        AppendBytes(out, removed.data(), sizeof(Entity) * removed.size());
+        for (uint32_t i : changed) AppendBytes(out, &afterIds[i], sizeof(Entity));
+        for (uint32_t i : changed) AppendBytes(out, afterRecords + uint64_t(i) * recordSize, recordSize);
+        // Keeps the next block header and its IDs 4 byte aligned
+        out.resize((out.size() + 3) & ~size_t(3), 0);
+        return 1;
+    }
+
+    struct ReplayBlock {
+        const ECS::JournalBlockHeader* header;
+        const Entity* removed;
+        const Entity* changed;
+        const char* records;
+    };
+
+    // Splits a frame payload into its blocks, false when the payload is malformed
+    bool ParseFrame(const char* payload, uint64_t size, uint32_t blockCount, std::vector<ReplayBlock>& blocks)
+    {
+        uint64_t offset = 0;
+        for (uint32_t b = 0; b < blockCount; b++) {
+            if (size - offset < sizeof(ECS::JournalBlockHeader)) return false;
+            ReplayBlock block;
+            block.header = reinterpret_cast<const ECS::JournalBlockHeader*>(payload + offset);
+            offset += sizeof(ECS::JournalBlockHeader);
+
+            const ECS::JournalBlockHeader& header = *block.header;
+            if (header.name[ECS::SAVE_NAME_SIZE - 1] != '\0') return false;
+            if (header.removedCount > MAX_ENTITIES || header.changedCount > MAX_ENTITIES) return false;
+            uint64_t bytes = (uint64_t(header.removedCount) + header.changedCount) * sizeof(Entity) + uint64_t(header.changedCount) * header.recordSize;
+            if (size - offset < bytes) return false;
+
+            block.removed = reinterpret_cast<const Entity*>(payload + offset);
+            block.changed = block.removed + header.removedCount;
+            block.records = reinterpret_cast<const char*>(block.changed + header.changedCount);
+            for (uint32_t i = 0; i < header.removedCount + header.changedCount; i++) {
+                if (block.removed[i] >= MAX_ENTITIES) return false;
+            }
+            offset = (offset + bytes + 3) & ~uint64_t(3);
+            if (offset > size) return false;
+            blocks.push_back(block);
+        }
+        return offset == size;
+    }
+
+    // Unique across runs so a journal left over from an older checkpoint is never replayed onto a newer one
+    uint64_t NewGeneration(uint64_t previous)
+    {
+        uint64_t now = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+        return now > previous ? now : previous + 1;
+    }
+}
+
+ECS::SaveJournal::SaveJournal(Coordinator& coordinator, std::string checkpointPath, std::string journalPath) :
+    coordinator{ coordinator },
+    checkpointPath{ std::move(checkpointPath) },
+    journalPath{ std::move(journalPath) },
+    state{ std::make_shared<State>() }
+{
+}
+
+std::future<bool> ECS::SaveJournal::Autosave()
+{
+    // Only the pools that changed since the last autosave are copied
+    auto snapshot = coordinator.CaptureSnapshot(lastCapture.get());
+    lastCapture = snapshot;
+    auto result = std::make_shared<std::promise<bool>>();
+    std::future<bool> future = result->get_future();
+    ThreadPool::io().submit([state = state, snapshot, checkpoint = checkpointPath, journal = journalPath, ratio = compactRatio, result]() {
+        bool compact = state->baseline == nullptr || state->journalBytes > ratio * state->checkpointBytes;
+        bool success = false;
+        try {
+            success = compact ? WriteCheckpoint(*state, snapshot, checkpoint, journal) : AppendFrame(*state, snapshot, journal);
+        }
+        catch (...) {
+            // E.g. out of memory while diffing or encoding. What made it to disk is unknown, so start over with a checkpoint
+            std::cerr << "Autosave to " << checkpoint << " failed\n";
+            state->baseline = nullptr;
+        }
+        result->set_value(success);
+    });
+    return future;
+}
+
+bool ECS::SaveJournal::WriteCheckpoint(State& state, const std::shared_ptr<SaveSnapshot>& snapshot, const std::string& checkpointPath, const std::string& journalPath)
+{
+    snapshot->generation = NewGeneration(state.generation);
+    if (!WriteSaveFile(*snapshot, checkpointPath.c_str())) return false;
+
+    SaveHeader saved{};
+    ReadSaveHeader(checkpointPath.c_str(), saved);
+
+    // A crash before the new journal is in place leaves the old one, whose generation no longer matches
+    JournalHeader header{};
+    std::memcpy(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    header.version = JOURNAL_VERSION;
+    header.generation = snapshot->generation;
+    std::ofstream fs(journalPath, std::ios::binary | std::ios::trunc);
+    fs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!fs.good()) {
+        std::cerr << "Failed to write " << journalPath << "\n";
+        // Frames appended to the old journal would be ignored by Recover, so the next autosave tries another checkpoint
+        state.baseline = nullptr;
+        return false;
+    }
+
+    state.baseline = snapshot;
+    state.generation = snapshot->generation;
+    state.checkpointBytes = saved.fileSize;
+    state.journalBytes = 0;
+    state.sequence = 0;
+    return true;
+}
+
+bool ECS::SaveJournal::AppendFrame(State& state, const std::shared_ptr<SaveSnapshot>& snapshot, const std::string& journalPath)
+{
+    std::vector<char> payload;
+    uint32_t blockCount = 0;
+    for (auto const& block : snapshot->blocks) {
+        // Field lists don't change while the game runs, the checkpoint has them
+        if (block.entry.kind == SaveBlockKind::Layout) continue;
+        blockCount += DiffBlock(FindBlock(*state.baseline, block.entry), block, payload);
+    }
+    if (blockCount == 0) {
+        state.baseline = snapshot;
+        return true;
+    }
+
+    JournalFrameHeader header{};
+    std::memcpy(header.magic, JOURNAL_FRAME_MAGIC, sizeof(JOURNAL_FRAME_MAGIC));
+    header.sequence = state.sequence;
+    header.blockCount = blockCount;
+    header.payloadSize = payload.size();
+    header.checksum = compression::crc32c(payload.data(), payload.size());
+
+    std::ofstream fs(journalPath, std::ios::binary | std::ios::app);
+    fs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    fs.write(payload.data(), payload.size());
+    fs.flush();
+    if (!fs.good()) {
+        std::cerr << "Failed to append to " << journalPath << "\n";
+        // The journal may end in a torn frame and no longer leads to this snapshot, the next autosave starts over
+        // with a checkpoint
+        state.baseline = nullptr;
+        return false;
+    }
+    state.baseline = snapshot;
+    state.sequence++;
+    state.journalBytes += sizeof(header) + payload.size();
+    return true;
+}
+
+bool ECS::SaveJournal::Recover(Coordinator& coordinator, const char* checkpointPath, const char* journalPath)
+{
+    SaveHeader checkpoint{};
+    if (!ReadSaveHeader(checkpointPath, checkpoint) || !coordinator.Deserialize(checkpointPath)) return false;
+
+    MappedFile journal;
+    if (!journal.open(journalPath)) return true;
+    const char* base = journal.data();
+    uint64_t size = journal.size();
+
+    JournalHeader header{};
+    if (size < sizeof(header)) return true;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 || header.version != JOURNAL_VERSION || header.generation != checkpoint.generation) {
+        std::cerr << "Ignoring " << journalPath << ", it does not belong to " << checkpointPath << "\n";
+        return true;
+    }
+
+    uint64_t offset = sizeof(header);
+    uint32_t expectedSequence = 0;
+    std::vector<ReplayBlock> blocks;
+    while (size - offset >= sizeof(JournalFrameHeader)) {
+        JournalFrameHeader frame{};
+        std::memcpy(&frame, base + offset, sizeof(frame));
+        offset += sizeof(frame);
+        // A torn or damaged frame ends the journal, the world stays at the last complete frame
+        if (std::memcmp(frame.magic, JOURNAL_FRAME_MAGIC, sizeof(JOURNAL_FRAME_MAGIC)) != 0 || frame.sequence != expectedSequence) break;
+        if (frame.payloadSize > size - offset) break;
+        if (compression::crc32c(base + offset, frame.payloadSize) != frame.checksum) break;
+        blocks.clear();
+        if (!ParseFrame(base + offset, frame.payloadSize, frame.blockCount, blocks)) break;
+        offset += frame.payloadSize;
+        expectedSequence++;
+
+        for (auto const& block : blocks) {
+            const JournalBlockHeader& blockHeader = *block.header;
+            if (blockHeader.kind == SaveBlockKind::Entities) {
+                for (uint32_t i = 0; i < blockHeader.removedCount; i++) {
+                    if (coordinator.IsAlive(block.removed[i])) coordinator.DestroyEntity(block.removed[i]);
+                }
+                coordinator.RestoreEntities(block.changed, blockHeader.changedCount);
+            }
+            else {
+                coordinator.RemoveComponents(blockHeader.name, block.removed, blockHeader.removedCount);
+                if (!coordinator.LoadComponentRecords(blockHeader.name, blockHeader.recordSize, block.changed, block.records, blockHeader.changedCount)) {
+                    std::cerr << "Skipping " << blockHeader.name << " in " << journalPath << "\n";
+                }
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "entity_component_system.h"
+#include "save_format.h"
+
+#include <string>
+#include <future>
+#include <memory>
+
+// Layout of an autosave journal. Integers are little endian.
+//
+//   JournalHeader
+//   frames, each a JournalFrameHeader followed by payloadSize bytes of blocks
+//
+// A block is a JournalBlockHeader, removedCount entity IDs, changedCount entity IDs and changedCount records.
+// In the entity block the removed entities were destroyed and the changed ones created. In a component block the
+// removed entities lost the component and the changed ones got it or hold a different value.
+// A frame cut short by a crash or failing its checksum is ignored on recovery together with everything after it.
+namespace ECS {
+	constexpr char JOURNAL_MAGIC[4] = { 'F', 'B', 'S', 'J' };
+	constexpr char JOURNAL_FRAME_MAGIC[4] = { 'F', 'B', 'J', 'F' };
+	constexpr uint32_t JOURNAL_VERSION = 2;
+
+	struct JournalHeader {
+		char magic[4];
+		uint32_t version;
+		// Generation of the checkpoint the frames apply to, see SaveHeader
+		uint64_t generation;
+	};
+
+	struct JournalFrameHeader {
+		char magic[4];
+		// Counts up from 0 after every checkpoint
+		uint32_t sequence;
+		uint32_t blockCount;
+		// CRC-32C of the payload
+		uint32_t checksum;
+		uint64_t payloadSize;
+	};
+
+	struct JournalBlockHeader {
+		// typeid name of the component, empty for the entity block
+		char name[SAVE_NAME_SIZE];
+		SaveBlockKind kind;
+		uint32_t recordSize;
+		uint32_t removedCount;
+		uint32_t changedCount;
+	};
+
+	static_assert(sizeof(JournalHeader) == 16, "JournalHeader layout changed, bump JOURNAL_VERSION");
+	static_assert(sizeof(JournalFrameHeader) == 24, "JournalFrameHeader layout changed, bump JOURNAL_VERSION");
+	static_assert(sizeof(JournalBlockHeader) == SAVE_NAME_SIZE + 16, "JournalBlockHeader layout changed, bump JOURNAL_VERSION");
+
+	// Incremental autosave: a full checkpoint written with WriteSaveFile plus an append-only journal of what changed since.
+	// Changes are found by comparing the records of each snapshot with the previous one, so components don't have to
+	// report their writes. Comparing, encoding and writing happen on ThreadPool::io(), only the capture runs on the
+	// calling thread.
+	class SaveJournal {
+	public:
+		SaveJournal(Coordinator& coordinator, std::string checkpointPath = "autosave.dat", std::string journalPath = "autosave.journal");
+
+		// Captures the world, call between frames. The first autosave and every autosave after the journal outgrew
+		// compactRatio times the checkpoint write a new checkpoint and start an empty journal, the others append one frame
+		std::future<bool> Autosave();
+
+		void SetCompactRatio(float ratio) { compactRatio = ratio; }
+
+		// Loads the checkpoint and replays every complete frame of its journal on top.
+		// A journal that belongs to another checkpoint is ignored
+		static bool Recover(Coordinator& coordinator, const char* checkpointPath = "autosave.dat", const char* journalPath = "autosave.journal");
+
+	private:
+		// Only touched on the I/O thread
+		struct State {
+			// World the journal on disk ends with, null when the next autosave has to write a checkpoint
+			std::shared_ptr<SaveSnapshot> baseline;
+			uint64_t generation = 0;
+			uint64_t checkpointBytes = 0;
+			uint64_t journalBytes = 0;
+			uint32_t sequence = 0;
+		};
+
+		static bool WriteCheckpoint(State& state, const std::shared_ptr<SaveSnapshot>& snapshot, const std::string& checkpointPath, const std::string& journalPath);
+		static bool AppendFrame(State& state, const std::shared_ptr<SaveSnapshot>& snapshot, const std::string& journalPath);
+
+		Coordinator& coordinator;
+		std::string checkpointPath;
+		std::string journalPath;
+		float compactRatio = 1.0f;
+		std::shared_ptr<State> state;
+		// Snapshot of the previous autosave, only touched on the calling thread. Its blocks are never written again,
+		// so the I/O thread can be reading them at the same time
+		std::shared_ptr<SaveSnapshot> lastCapture;
+	};
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace ECS {
+	// Index of the lowest set bit. mask must not be 0
+	inline uint32_t CountTrailingZeros(uint64_t mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, mask);
+		return index;
+#else
+		return __builtin_ctzll(mask);
+#endif
+	}
+
+	// Smallest supported signature width that can hold componentCount components
+	constexpr uint32_t SignatureBitsFor(uint32_t componentCount)
+	{
+		return componentCount <= 64 ? 64 : componentCount <= 128 ? 128 : 256;
+	}
+
+	// Fixed width replacement for std::bitset used as the component signature.
+	// The width is chosen at compile time from 64/128/256 bits so every operation is a loop over
+	// one to four 64 bit words with a constant trip count, which the compiler turns into plain word
+	// or SIMD register operations. The words are aligned so the scan in signature_scan.h can load them directly.
+	template<uint32_t Bits>
+	struct alignas(Bits >= 128 ? Bits / 8 : 8) BasicSignature {
+		static_assert(Bits == 64 || Bits == 128 || Bits == 256, "Signature width must be 64, 128 or 256 bits");
+		static constexpr uint32_t WORDS = Bits / 64;
+
+		uint64_t words[WORDS]{};
+
+		static constexpr size_t size() { return Bits; }
+
+		BasicSignature& set(size_t pos, bool value = true)
+		{
+			assert(pos < Bits && "Signature bit out of range");
+			uint64_t bit = uint64_t(1) << (pos & 63);
+			if (value) words[pos >> 6] |= bit;
+			else words[pos >> 6] &= ~bit;
+			return *this;
+		}
+
+		BasicSignature& reset(size_t pos) { return set(pos, false); }
+
+		BasicSignature& reset()
+		{
+			for (uint32_t i = 0; i < WORDS; i++) words[i] = 0;
+			return *this;
+		}
+
+		bool test(size_t pos) const
+		{
+			assert(pos < Bits && "Signature bit out of range");
+			return (words[pos >> 6] >> (pos & 63)) & 1;
+		}
+
+		bool any() const
+		{
+			uint64_t combined = 0;
+			for (uint32_t i = 0; i < WORDS; i++) combined |= words[i];
+			return combined != 0;
+		}
+
+		bool none() const { return !any(); }
+
+		// True when every bit of other is also set in this signature
+		bool contains(const BasicSignature& other) const
+		{
+			uint64_t missing = 0;
+			for (uint32_t i = 0; i < WORDS; i++) missing |= other.words[i] & ~words[i];
+			return missing == 0;
+		}
+
+		BasicSignature& operator&=(const BasicSignature& other)
+		{
+			for (uint32_t i = 0; i < WORDS; i++) words[i] &= other.words[i];
+			return *this;
+		}
+
+		BasicSignature& operator|=(const BasicSignature& other)
+		{
+			for (uint32_t i = 0; i < WORDS; i++) words[i] |= other.words[i];
+			return *this;
+		}
+
+		friend BasicSignature operator&(BasicSignature a, const BasicSignature& b) { return a &= b; }
+		friend BasicSignature operator|(BasicSignature a, const BasicSignature& b) { return a |= b; }
+
+		friend bool operator==(const BasicSignature& a, const BasicSignature& b)
+		{
+			uint64_t diff = 0;
+			for (uint32_t i = 0; i < WORDS; i++) diff |= a.words[i] ^ b.words[i];
+			return diff == 0;
+		}
+
+		friend bool operator!=(const BasicSignature& a, const BasicSignature& b) { return !(a == b); }
+	};
+}
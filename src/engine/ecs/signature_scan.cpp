@@ -0,0 +1,180 @@
+#include "signature_scan.h"
+#include "../cpu_features.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SIGNATURE_SCAN_SSE2
+#endif
+// AVX2 is picked at runtime, the build itself only assumes SSE2
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#define SIGNATURE_SCAN_AVX2
+#if defined(_MSC_VER)
+#define AVX2_TARGET
+#else
+// Compiled for AVX2 on its own, only called after cpuHasAvx2
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+	// Number of 64 bit words tested per block
+	constexpr uint32_t BLOCK_WORDS = 32;
+
+	// pass and empty hold one bit per word of the block.
+	// An entity matches when all of its words pass and not all of them are empty.
+	// The result bit of an entity sits on its first word, so the other bits are masked out before emitting.
+	template<uint32_t WORDS>
+	inline void emitMatches(uint32_t pass, uint32_t empty, uint32_t firstEntity, std::vector<uint32_t>& matches)
+	{
+		constexpr uint32_t firstWordMask = WORDS == 1 ? 0xFFFFFFFFu : WORDS == 2 ? 0x55555555u : 0x11111111u;
+		uint32_t allPass = pass;
+		uint32_t allEmpty = empty;
+		for (uint32_t s = 1; s < WORDS; s++) {
+			allPass &= pass >> s;
+			allEmpty &= empty >> s;
+		}
+		uint32_t mask = allPass & ~allEmpty & firstWordMask;
+		while (mask) {
+			matches.push_back(firstEntity + ECS::CountTrailingZeros(mask) / WORDS);
+			mask &= mask - 1;
+		}
+	}
+
+#ifdef SIGNATURE_SCAN_SSE2
+	// SSE2 has no 64 bit compare, so compare the 32 bit halves and require both halves of a lane to be equal
+	inline int movemaskEqual64(__m128i a, __m128i b)
+	{
+		__m128i eq = _mm_cmpeq_epi32(a, b);
+		eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_movemask_pd(_mm_castsi128_pd(eq));
+	}
+
+	inline int movemaskBoth64(__m128i a, __m128i b)
+	{
+		return _mm_movemask_pd(_mm_castsi128_pd(_mm_and_si128(a, b)));
+	}
+#endif
+
+#ifdef SIGNATURE_SCAN_AVX2
+	// Scans whole blocks from 0, returns the first entity that was not scanned
+	template<uint32_t Bits>
+	AVX2_TARGET uint32_t scanBlocksAvx2(
+		const ECS::BasicSignature<Bits>* signatures,
+		uint32_t count,
+		const ECS::BasicSignature<Bits>& include,
+		const ECS::BasicSignature<Bits>& exclude,
+		std::vector<uint32_t>& matches)
+	{
+		constexpr uint32_t WORDS = ECS::BasicSignature<Bits>::WORDS;
+		constexpr uint32_t ENTITIES_PER_BLOCK = BLOCK_WORDS / WORDS;
+		const uint64_t* words = signatures[0].words;
+
+		// The include/exclude words repeat every WORDS lanes, 4 lanes per register
+		alignas(32) uint64_t includeLanes[4];
+		alignas(32) uint64_t excludeLanes[4];
+		for (uint32_t lane = 0; lane < 4; lane++) {
+			includeLanes[lane] = include.words[lane % WORDS];
+			excludeLanes[lane] = exclude.words[lane % WORDS];
+		}
+		const __m256i inc = _mm256_load_si256(reinterpret_cast<const __m256i*>(includeLanes));
+		const __m256i exc = _mm256_load_si256(reinterpret_cast<const __m256i*>(excludeLanes));
+		const __m256i zero = _mm256_setzero_si256();
+
+		uint32_t i = 0;
+		for (; i + ENTITIES_PER_BLOCK <= count; i += ENTITIES_PER_BLOCK) {
+			const uint64_t* block = words + size_t(i) * WORDS;
+			uint32_t pass = 0;
+			uint32_t empty = 0;
+			for (uint32_t r = 0; r < BLOCK_WORDS / 4; r++) {
+				__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + r * 4));
+				__m256i hasInclude = _mm256_cmpeq_epi64(_mm256_and_si256(v, inc), inc);
+				__m256i noExclude = _mm256_cmpeq_epi64(_mm256_and_si256(v, exc), zero);
+				pass |= uint32_t(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_and_si256(hasInclude, noExclude)))) << (r * 4);
+				empty |= uint32_t(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, zero)))) << (r * 4);
+			}
+			emitMatches<WORDS>(pass, empty, i, matches);
+		}
+		return i;
+	}
+#endif
+
+#ifdef SIGNATURE_SCAN_SSE2
+	// Scans whole blocks from 0, returns the first entity that was not scanned
+	template<uint32_t Bits>
+	uint32_t scanBlocksSse2(
+		const ECS::BasicSignature<Bits>* signatures,
+		uint32_t count,
+		const ECS::BasicSignature<Bits>& include,
+		const ECS::BasicSignature<Bits>& exclude,
+		std::vector<uint32_t>& matches)
+	{
+		constexpr uint32_t WORDS = ECS::BasicSignature<Bits>::WORDS;
+		constexpr uint32_t ENTITIES_PER_BLOCK = BLOCK_WORDS / WORDS;
+		const uint64_t* words = signatures[0].words;
+
+		// 2 lanes per register. A 256 bit signature spans two registers, so the words of
+		// include/exclude are laid out over 4 lanes and even/odd registers use the low/high half
+		alignas(16) uint64_t includeLanes[4];
+		alignas(16) uint64_t excludeLanes[4];
+		for (uint32_t lane = 0; lane < 4; lane++) {
+			includeLanes[lane] = include.words[lane % WORDS];
+			excludeLanes[lane] = exclude.words[lane % WORDS];
+		}
+		const __m128i inc[2] = {
+			_mm_load_si128(reinterpret_cast<const __m128i*>(includeLanes)),
+			_mm_load_si128(reinterpret_cast<const __m128i*>(includeLanes + 2)) };
+		const __m128i exc[2] = {
+			_mm_load_si128(reinterpret_cast<const __m128i*>(excludeLanes)),
+			_mm_load_si128(reinterpret_cast<const __m128i*>(excludeLanes + 2)) };
+		const __m128i zero = _mm_setzero_si128();
+
+		uint32_t i = 0;
+		for (; i + ENTITIES_PER_BLOCK <= count; i += ENTITIES_PER_BLOCK) {
+			const uint64_t* block = words + size_t(i) * WORDS;
+			uint32_t pass = 0;
+			uint32_t empty = 0;
+			for (uint32_t r = 0; r < BLOCK_WORDS / 2; r++) {
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + r * 2));
+				__m128i hasInclude = _mm_cmpeq_epi32(_mm_and_si128(v, inc[r & 1]), inc[r & 1]);
+				__m128i noExclude = _mm_cmpeq_epi32(_mm_and_si128(v, exc[r & 1]), zero);
+				hasInclude = _mm_and_si128(hasInclude, _mm_shuffle_epi32(hasInclude, _MM_SHUFFLE(2, 3, 0, 1)));
+				noExclude = _mm_and_si128(noExclude, _mm_shuffle_epi32(noExclude, _MM_SHUFFLE(2, 3, 0, 1)));
+				pass |= uint32_t(movemaskBoth64(hasInclude, noExclude)) << (r * 2);
+				empty |= uint32_t(movemaskEqual64(v, zero)) << (r * 2);
+			}
+			emitMatches<WORDS>(pass, empty, i, matches);
+		}
+		return i;
+	}
+#endif
+}
+
+template<uint32_t Bits>
+uint32_t ECS::ScanSignatures(
+	const BasicSignature<Bits>* signatures,
+	uint32_t count,
+	const BasicSignature<Bits>& include,
+	const BasicSignature<Bits>& exclude,
+	std::vector<uint32_t>& matches)
+{
+	size_t before = matches.size();
+	uint32_t i = 0;
+
+#if defined(SIGNATURE_SCAN_AVX2)
+	if (cpuHasAvx2()) i = scanBlocksAvx2(signatures, count, include, exclude, matches);
+	else i = scanBlocksSse2(signatures, count, include, exclude, matches);
+#elif defined(SIGNATURE_SCAN_SSE2)
+	i = scanBlocksSse2(signatures, count, include, exclude, matches);
+#endif
+
+	for (; i < count; i++) {
+		const BasicSignature<Bits>& signature = signatures[i];
+		if (signature.any() && signature.contains(include) && (signature & exclude).none()) matches.push_back(i);
+	}
+	return static_cast<uint32_t>(matches.size() - before);
+}
+
+template uint32_t ECS::ScanSignatures<64>(const BasicSignature<64>*, uint32_t, const BasicSignature<64>&, const BasicSignature<64>&, std::vector<uint32_t>&);
+template uint32_t ECS::ScanSignatures<128>(const BasicSignature<128>*, uint32_t, const BasicSignature<128>&, const BasicSignature<128>&, std::vector<uint32_t>&);
+template uint32_t ECS::ScanSignatures<256>(const BasicSignature<256>*, uint32_t, const BasicSignature<256>&, const BasicSignature<256>&, std::vector<uint32_t>&);
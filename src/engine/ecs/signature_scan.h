@@ -0,0 +1,20 @@
+#pragma once
+#include "signature.h"
+
+#include <cstdint>
+#include <vector>
+
+// Bulk include/exclude tests over the signature array of the registry.
+// The signature words are streamed through SSE2 or, when the CPU has it, AVX2 registers, 32 words per block,
+// so one block covers 32, 16 or 8 entities for 64, 128 or 256 bit signatures.
+namespace ECS {
+	// Appends every entity whose signature is non empty, contains all bits of include and none of exclude.
+	// The index into signatures is the entity ID. Returns the number of matches appended.
+	template<uint32_t Bits>
+	uint32_t ScanSignatures(
+		const BasicSignature<Bits>* signatures,
+		uint32_t count,
+		const BasicSignature<Bits>& include,
+		const BasicSignature<Bits>& exclude,
+		std::vector<uint32_t>& matches);
+}
@@ -0,0 +1,94 @@
+#include "file_writer.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+#endif
+
+#ifdef _WIN32
+bool writeFileGather(const char* path, const WriteSlice* slices, size_t count)
+{
+	HANDLE handle = CreateFileA(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) return false;
+
+	bool success = true;
+	for (size_t i = 0; i < count && success; i++) {
+		const char* data = static_cast<const char*>(slices[i].data);
+		uint64_t left = slices[i].size;
+		// WriteFile takes at most 4GB at a time
+		while (left > 0 && success) {
+			DWORD chunk = static_cast<DWORD>(left < 0x40000000ull ? left : 0x40000000ull);
+			DWORD written = 0;
+			success = WriteFile(handle, data, chunk, &written, nullptr) && written == chunk;
+			data += written;
+			left -= written;
+		}
+	}
+	if (success) success = FlushFileBuffers(handle) != 0;
+	CloseHandle(handle);
+	return success;
+}
+
+bool replaceFile(const char* source, const char* target)
+{
+	return MoveFileExA(source, target, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+#else
+bool writeFileGather(const char* path, const WriteSlice* slices, size_t count)
+{
+	int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return false;
+
+	std::vector<iovec> pending;
+	pending.reserve(count);
+	for (size_t i = 0; i < count; i++) {
+		if (slices[i].size > 0) pending.push_back({ const_cast<void*>(slices[i].data), static_cast<size_t>(slices[i].size) });
+	}
+
+	// writev takes at most IOV_MAX slices and may stop early, pick up where it left off
+	bool success = true;
+	size_t first = 0;
+	while (first < pending.size()) {
+		int batch = static_cast<int>(pending.size() - first < IOV_MAX ? pending.size() - first : IOV_MAX);
+		ssize_t written = writev(fd, pending.data() + first, batch);
+		if (written <= 0) {
+			if (written < 0 && errno == EINTR) continue;
+			success = false;
+			break;
+		}
+		size_t left = static_cast<size_t>(written);
+		while (first < pending.size() && left >= pending[first].iov_len) left -= pending[first++].iov_len;
+		if (left > 0) {
+			pending[first].iov_base = static_cast<char*>(pending[first].iov_base) + left;
+			pending[first].iov_len -= left;
+		}
+	}
+	if (success && fsync(fd) != 0) success = false;
+	if (::close(fd) != 0) success = false;
+	return success;
+}
+
+bool replaceFile(const char* source, const char* target)
+{
+	if (::rename(source, target) != 0) return false;
+
+	// The new directory entry only survives a crash once the directory itself is synced
+	std::string directory = target;
+	size_t slash = directory.find_last_of('/');
+	directory = slash == std::string::npos ? "." : slash == 0 ? "/" : directory.substr(0, slash);
+	int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+	if (fd >= 0) {
+		fsync(fd);
+		::close(fd);
+	}
+	return true;
+}
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// One piece of a file written by writeFileGather
+struct WriteSlice {
+	const void* data;
+	uint64_t size;
+};
+
+// Creates or truncates path and writes the slices back to back without first copying them into one buffer
+// (writev, one WriteFile per slice on Windows where WriteFileGather only takes whole unbuffered pages).
+// The data is flushed to the disk before the file is closed.
+// Returns false when the file can't be opened or not every byte was written
+bool writeFileGather(const char* path, const WriteSlice* slices, size_t count);
+
+// Atomically replaces target with source, readers see either the old or the new file but never a missing one.
+// The rename itself is made durable as well (MOVEFILE_WRITE_THROUGH, fsync of the directory on POSIX)
+bool replaceFile(const char* source, const char* target);
@@ -0,0 +1,102 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const char* path)
+{
+	close();
+	HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) return false;
+	file = handle;
+
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(handle, &length) || length.QuadPart == 0) {
+		close();
+		return false;
+	}
+	fileSize = static_cast<uint64_t>(length.QuadPart);
+
+	mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		close();
+		return false;
+	}
+	view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (view != nullptr) UnmapViewOfFile(view);
+	if (mapping != nullptr) CloseHandle(mapping);
+	if (file != nullptr) CloseHandle(file);
+	view = nullptr;
+	mapping = nullptr;
+	file = nullptr;
+	fileSize = 0;
+}
+
+void MappedFile::prefetch(uint64_t offset, uint64_t bytes) const
+{
+	if (view == nullptr || bytes == 0) return;
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = const_cast<char*>(data()) + offset;
+	range.NumberOfBytes = static_cast<SIZE_T>(bytes);
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+#else
+bool MappedFile::open(const char* path)
+{
+	close();
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps the file referenced on its own
+	::close(fd);
+	if (mapped == MAP_FAILED) return false;
+
+	view = mapped;
+	fileSize = static_cast<uint64_t>(info.st_size);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (view != nullptr) munmap(const_cast<void*>(view), static_cast<size_t>(fileSize));
+	view = nullptr;
+	fileSize = 0;
+}
+
+void MappedFile::prefetch(uint64_t offset, uint64_t bytes) const
+{
+	if (view == nullptr || bytes == 0) return;
+	// madvise wants a page aligned start
+	uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+	uintptr_t start = reinterpret_cast<uintptr_t>(data() + offset);
+	uintptr_t aligned = start & ~(page - 1);
+	madvise(reinterpret_cast<void*>(aligned), static_cast<size_t>(start - aligned + bytes), MADV_WILLNEED);
+}
+#endif
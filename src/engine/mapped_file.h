@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+
+// Read only view of a whole file through the OS page cache (MapViewOfFile, mmap elsewhere).
+// Nothing is read up front, pages are faulted in the first time they are touched.
+// On Windows the file can't be replaced or truncated while it is mapped.
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Returns false when the file is missing, empty or can't be mapped
+	bool open(const char* path);
+	void close();
+
+	bool isOpen() const { return view != nullptr; }
+	const char* data() const { return static_cast<const char*>(view); }
+	uint64_t size() const { return fileSize; }
+
+	// Asks the OS to start reading [offset, offset + bytes) in the background
+	void prefetch(uint64_t offset, uint64_t bytes) const;
+
+private:
+	const void* view = nullptr;
+	uint64_t fileSize = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#endif
+};
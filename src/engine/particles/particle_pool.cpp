@@ -0,0 +1,144 @@
+#include "particle_pool.h"
+#include "../thread_pool.h"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PARTICLE_SSE
+#endif
+
+ParticlePool::ParticlePool(uint32_t capacity, uint32_t seed) : capacity(capacity), rng(seed != 0 ? seed : 1)
+{
+	for (auto* stream : { &px, &py, &vx, &vy, &life, &invLifetime }) {
+		stream->resize(capacity);
+	}
+	color.resize(capacity);
+}
+
+float ParticlePool::Random()
+{
+	// xorshift32, the top 24 bits give a float in [0, 1)
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return (rng >> 8) * (1.0f / 16777216.0f);
+}
+
+uint32_t ParticlePool::Emit(uint32_t requested, const glm::vec2& origin, const ParticleEmitterComponent& emitter)
+{
+	uint32_t spawned = (std::min)(requested, capacity - count);
+	for (uint32_t i = count; i < count + spawned; i++) {
+		px[i] = origin.x + (2.0f * Random() - 1.0f) * emitter.spawnExtents.x;
+		py[i] = origin.y + (2.0f * Random() - 1.0f) * emitter.spawnExtents.y;
+		vx[i] = emitter.velocity.x + (2.0f * Random() - 1.0f) * emitter.velocityVariance.x;
+		vy[i] = emitter.velocity.y + (2.0f * Random() - 1.0f) * emitter.velocityVariance.y;
+
+		float lifetime = (std::max)(emitter.lifetime + (2.0f * Random() - 1.0f) * emitter.lifetimeVariance, 0.001f);
+		life[i] = lifetime;
+		invLifetime[i] = 1.0f / lifetime;
+
+		uint32_t packed = 0xFF000000u;
+		for (uint32_t channel = 0; channel < 3; channel++) {
+			float value = std::clamp(1.0f - Random() * emitter.colorVariance, 0.0f, 1.0f);
+			packed |= static_cast<uint32_t>(value * 255.0f + 0.5f) << (channel * 8);
+		}
+		color[i] = packed;
+	}
+	count += spawned;
+	return spawned;
+}
+
+void ParticlePool::Update(float dt, const glm::vec2& acceleration)
+{
+	auto update = [&](uint32_t begin, uint32_t end, uint32_t) {
+		uint32_t i = begin;
+#ifdef PARTICLE_SSE
+		const __m128 step = _mm_set1_ps(dt);
+		const __m128 ax = _mm_set1_ps(acceleration.x * dt);
+		const __m128 ay = _mm_set1_ps(acceleration.y * dt);
+		for (; i + 4 <= end; i += 4) {
+			__m128 x = _mm_add_ps(_mm_loadu_ps(&vx[i]), ax);
+			__m128 y = _mm_add_ps(_mm_loadu_ps(&vy[i]), ay);
+			_mm_storeu_ps(&vx[i], x);
+			_mm_storeu_ps(&vy[i], y);
+			_mm_storeu_ps(&px[i], _mm_add_ps(_mm_loadu_ps(&px[i]), _mm_mul_ps(x, step)));
+			_mm_storeu_ps(&py[i], _mm_add_ps(_mm_loadu_ps(&py[i]), _mm_mul_ps(y, step)));
+			_mm_storeu_ps(&life[i], _mm_sub_ps(_mm_loadu_ps(&life[i]), step));
+		}
+#endif
+		for (; i < end; i++) {
+			vx[i] += acceleration.x * dt;
+			vy[i] += acceleration.y * dt;
+			px[i] += vx[i] * dt;
+			py[i] += vy[i] * dt;
+			life[i] -= dt;
+		}
+	};
+
+	if (count >= PARALLEL_MIN_PARTICLES) ThreadPool::global().parallelFor(count, PARALLEL_MIN_PARTICLES / 2, update);
+	else update(0, count, 0);
+}
+
+void ParticlePool::Compact()
+{
+	uint32_t i = 0;
+#ifdef PARTICLE_SSE
+	const __m128 zero = _mm_setzero_ps();
+#endif
+	while (i < count) {
+#ifdef PARTICLE_SSE
+		// Skip live particles four at a time
+		while (i + 4 <= count && _mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(&life[i]), zero)) == 0) i += 4;
+		if (i >= count) break;
+#endif
+		if (life[i] > 0.0f) {
+			i++;
+			continue;
+		}
+		// Fill the hole with the last particle, which is checked next
+		count--;
+		px[i] = px[count];
+		py[i] = py[count];
+		vx[i] = vx[count];
+		vy[i] = vy[count];
+		life[i] = life[count];
+		invLifetime[i] = invLifetime[count];
+		color[i] = color[count];
+	}
+}
+
+void ParticlePool::Pack(ParticleInstance* out, float extrapolate) const
+{
+	static_assert(sizeof(ParticleInstance) == 4 * sizeof(float), "Pack writes instances as four floats");
+
+	auto pack = [&](uint32_t begin, uint32_t end, uint32_t) {
+		uint32_t i = begin;
+#ifdef PARTICLE_SSE
+		const __m128 e = _mm_set1_ps(extrapolate);
+		const __m128 one = _mm_set1_ps(1.0f);
+		for (; i + 4 <= end; i += 4) {
+			__m128 x = _mm_add_ps(_mm_loadu_ps(&px[i]), _mm_mul_ps(_mm_loadu_ps(&vx[i]), e));
+			__m128 y = _mm_add_ps(_mm_loadu_ps(&py[i]), _mm_mul_ps(_mm_loadu_ps(&vy[i]), e));
+			__m128 age = _mm_sub_ps(one, _mm_mul_ps(_mm_loadu_ps(&life[i]), _mm_loadu_ps(&invLifetime[i])));
+			__m128 c = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&color[i])));
+			// Rows of x, y, age and color become one instance per row
+			_MM_TRANSPOSE4_PS(x, y, age, c);
+			float* dst = reinterpret_cast<float*>(out + i);
+			_mm_storeu_ps(dst, x);
+			_mm_storeu_ps(dst + 4, y);
+			_mm_storeu_ps(dst + 8, age);
+			_mm_storeu_ps(dst + 12, c);
+		}
+#endif
+		for (; i < end; i++) {
+			out[i].position = { px[i] + vx[i] * extrapolate, py[i] + vy[i] * extrapolate };
+			out[i].age = 1.0f - life[i] * invLifetime[i];
+			out[i].color = color[i];
+		}
+	};
+
+	if (count >= PARALLEL_MIN_PARTICLES) ThreadPool::global().parallelFor(count, PARALLEL_MIN_PARTICLES / 2, pack);
+	else pack(0, count, 0);
+}
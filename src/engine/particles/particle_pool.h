@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "../ecs/entity_components.h"
+#include "../render_system/render_snapshot.h"
+
+// Fixed capacity structure of arrays storage for the particles of one emitter.
+// Live particles are always [0, Size()), Compact fills the holes left by dead ones with the last particles so the
+// update and pack passes stream through plain arrays four particles per SSE instruction.
+class ParticlePool {
+public:
+	explicit ParticlePool(uint32_t capacity, uint32_t seed = 1);
+
+	uint32_t Size() const { return count; }
+	uint32_t Capacity() const { return capacity; }
+
+	// Appends up to count particles around origin, returns how many fit
+	uint32_t Emit(uint32_t count, const glm::vec2& origin, const ParticleEmitterComponent& emitter);
+	// Integrates velocity and position and ages every particle. Large pools are split over ThreadPool::global()
+	void Update(float dt, const glm::vec2& acceleration);
+	// Drops the particles whose life ran out. Only touches the dead particles, survivors don't keep their order
+	void Compact();
+	// Writes Size() instances, positions moved by velocity * extrapolate seconds
+	void Pack(ParticleInstance* out, float extrapolate) const;
+
+	// Rate accumulator of the owning emitter, carries fractions of a particle between updates
+	float spawnDebt = 0.0f;
+
+private:
+	// Pools smaller than this are updated on the calling thread
+	static constexpr uint32_t PARALLEL_MIN_PARTICLES = 32768;
+
+	float Random();
+
+	uint32_t capacity;
+	uint32_t count = 0;
+	uint32_t rng;
+
+	std::vector<float> px, py, vx, vy;
+	// Seconds left and 1 / lifetime, age is 1 - life * invLifetime
+	std::vector<float> life, invLifetime;
+	std::vector<uint32_t> color;
+};
@@ -0,0 +1,335 @@
+#include "collision_system.h"
+#include "../spatial/broadphase_system.h"
+
+#include <cassert>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define COLLISION_SSE
+#endif
+
+namespace {
+	glm::vec2 rotate(const glm::vec2& v, float c, float s) { return { c * v.x - s * v.y, s * v.x + c * v.y }; }
+	float dot2(const glm::vec2& a, const glm::vec2& b) { return a.x * b.x + a.y * b.y; }
+
+	void projectPolygon(const glm::vec2* vertices, uint32_t count, const glm::vec2& axis, float& min, float& max)
+	{
+		min = max = dot2(vertices[0], axis);
+		for (uint32_t i = 1; i < count; i++) {
+			float p = dot2(vertices[i], axis);
+			min = (std::min)(min, p);
+			max = (std::max)(max, p);
+		}
+	}
+
+	glm::vec2 closestOnSegment(const glm::vec2& p, const glm::vec2& a, const glm::vec2& b)
+	{
+		glm::vec2 ab = b - a;
+		float lengthSquared = dot2(ab, ab);
+		float t = lengthSquared > 0.0f ? std::clamp(dot2(p - a, ab) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+		return a + ab * t;
+	}
+}
+
+void CollisionSystem::PairBatch::clear()
+{
+	a.clear(); b.clear();
+	ax.clear(); ay.clear(); bx.clear(); by.clear();
+	ahx.clear(); ahy.clear(); bhx.clear(); bhy.clear();
+}
+
+void CollisionSystem::PairBatch::push(Entity ea, Entity eb, const WorldCollider& ca, const WorldCollider& cb)
+{
+	a.push_back(ea); b.push_back(eb);
+	ax.push_back(ca.center.x); ay.push_back(ca.center.y);
+	bx.push_back(cb.center.x); by.push_back(cb.center.y);
+	bool circle = ca.shape == ColliderShape::Circle;
+	ahx.push_back(circle ? ca.radius : ca.halfExtents.x); ahy.push_back(ca.halfExtents.y);
+	bhx.push_back(circle ? cb.radius : cb.halfExtents.x); bhy.push_back(cb.halfExtents.y);
+}
+
+CollisionSystem::CollisionSystem(ECS::Coordinator* c, std::shared_ptr<BroadphaseSystem> broadphase) :
+	coordinator(*c),
+	broadphase(broadphase),
+	world(MAX_ENTITIES),
+	worldStamp(MAX_ENTITIES, 0)
+{
+}
+
+void CollisionSystem::BuildWorldCollider(Entity entity)
+{
+	auto& transform = coordinator.GetComponent<TransformComponent>(entity);
+	auto& collider = coordinator.GetComponent<ColliderComponent>(entity);
+	WorldCollider& w = world[entity];
+
+	glm::vec2 scale = transform.getWorldScale();
+	scale = { std::abs(scale.x), std::abs(scale.y) };
+	w.shape = collider.shape;
+	w.center = transform.getWorldTranslation() + collider.offset;
+	w.radius = collider.radius * (std::max)(scale.x, scale.y);
+	w.halfExtents = { collider.halfExtents.x * scale.x, collider.halfExtents.y * scale.y };
+	w.vertexCount = 0;
+
+	switch (collider.shape) {
+	case ColliderShape::Circle:
+		return;
+	case ColliderShape::AABB:
+	case ColliderShape::OrientedBox: {
+		glm::vec2 h = w.halfExtents;
+		glm::vec2 corners[4] = { { -h.x, -h.y }, { h.x, -h.y }, { h.x, h.y }, { -h.x, h.y } };
+		float angle = collider.shape == ColliderShape::AABB ? 0.0f : transform.getWorldRotation() + collider.angle;
+		float c = std::cos(angle), s = std::sin(angle);
+		w.vertexCount = 4;
+		for (uint32_t i = 0; i < 4; i++) w.vertices[i] = w.center + rotate(corners[i], c, s);
+		break;
+	}
+	case ColliderShape::Polygon: {
+		float angle = transform.getWorldRotation() + collider.angle;
+		float c = std::cos(angle), s = std::sin(angle);
+		glm::vec2 base = w.center;
+		// ColliderComponent::OnLoaded keeps loaded counts in range, MakePolygon asserts on built ones
+		assert(collider.vertexCount >= 3 && collider.vertexCount <= ColliderComponent::MAX_POLYGON_VERTICES && "Polygon collider needs 3 to MAX_POLYGON_VERTICES vertices.");
+		w.vertexCount = collider.vertexCount;
+		w.center = { 0.0f, 0.0f };
+		for (uint32_t i = 0; i < w.vertexCount; i++) {
+			glm::vec2 local{ collider.vertices[i].x * scale.x, collider.vertices[i].y * scale.y };
+			w.vertices[i] = base + rotate(local, c, s);
+			w.center += w.vertices[i];
+		}
+		// The vertex average lies inside a convex polygon, unlike the transform which may not
+		w.center = w.center * (1.0f / float(w.vertexCount));
+		break;
+	}
+	}
+
+	// Outward normals whichever way the vertices wind
+	for (uint32_t i = 0; i < w.vertexCount; i++) {
+		glm::vec2 edge = w.vertices[(i + 1) % w.vertexCount] - w.vertices[i];
+		glm::vec2 n{ edge.y, -edge.x };
+		float length = std::sqrt(dot2(n, n));
+		n = length > 0.0f ? n * (1.0f / length) : glm::vec2{ 1.0f, 0.0f };
+		if (dot2(n, w.vertices[i] - w.center) < 0.0f) n = -n;
+		w.normals[i] = n;
+	}
+}
+
+void CollisionSystem::Update(float dt)
+{
+	if (++stamp == 0) {
+		std::fill(worldStamp.begin(), worldStamp.end(), 0);
+		stamp = 1;
+	}
+	for (Entity e : mEntities) {
+		BuildWorldCollider(e);
+		worldStamp[e] = stamp;
+	}
+
+	contacts.clear();
+	circles.clear();
+	boxes.clear();
+	for (const auto& pair : broadphase->Pairs()) {
+		if (worldStamp[pair.first] != stamp || worldStamp[pair.second] != stamp) continue;
+		const WorldCollider& a = world[pair.first];
+		const WorldCollider& b = world[pair.second];
+		if (a.shape == ColliderShape::Circle && b.shape == ColliderShape::Circle) circles.push(pair.first, pair.second, a, b);
+		else if (a.shape == ColliderShape::AABB && b.shape == ColliderShape::AABB) boxes.push(pair.first, pair.second, a, b);
+		else Generic(pair.first, pair.second);
+	}
+	CircleBatch();
+	AABBBatch();
+}
+
+void CollisionSystem::CircleBatch()
+{
+	const PairBatch& p = circles;
+	uint32_t count = static_cast<uint32_t>(p.a.size());
+	auto emit = [&](uint32_t i, float nx, float ny, float penetration) {
+		glm::vec2 normal{ nx, ny };
+		glm::vec2 point = glm::vec2{ p.ax[i], p.ay[i] } + normal * (p.ahx[i] - penetration * 0.5f);
+		contacts.push_back({ p.a[i], p.b[i], normal, penetration, point });
+	};
+
+	uint32_t i = 0;
+#ifdef COLLISION_SSE
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= count; i += 4) {
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(&p.bx[i]), _mm_loadu_ps(&p.ax[i]));
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(&p.by[i]), _mm_loadu_ps(&p.ay[i]));
+		__m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+		__m128 radii = _mm_add_ps(_mm_loadu_ps(&p.ahx[i]), _mm_loadu_ps(&p.bhx[i]));
+		int mask = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_mul_ps(radii, radii)));
+		if (mask == 0) continue;
+
+		__m128 distance = _mm_sqrt_ps(d2);
+		// Coincident centres have no direction, separate them along +x
+		__m128 coincident = _mm_cmpeq_ps(distance, zero);
+		__m128 inverse = _mm_div_ps(one, _mm_or_ps(distance, _mm_and_ps(coincident, one)));
+		__m128 nx = _mm_or_ps(_mm_andnot_ps(coincident, _mm_mul_ps(dx, inverse)), _mm_and_ps(coincident, one));
+		__m128 ny = _mm_andnot_ps(coincident, _mm_mul_ps(dy, inverse));
+		__m128 penetration = _mm_sub_ps(radii, distance);
+
+		alignas(16) float nxs[4], nys[4], pens[4];
+		_mm_store_ps(nxs, nx);
+		_mm_store_ps(nys, ny);
+		_mm_store_ps(pens, penetration);
+		while (mask) {
+			uint32_t lane = ECS::CountTrailingZeros(static_cast<uint64_t>(mask));
+			emit(i + lane, nxs[lane], nys[lane], pens[lane]);
+			mask &= mask - 1;
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		float dx = p.bx[i] - p.ax[i];
+		float dy = p.by[i] - p.ay[i];
+		float d2 = dx * dx + dy * dy;
+		float radii = p.ahx[i] + p.bhx[i];
+		if (d2 > radii * radii) continue;
+		float distance = std::sqrt(d2);
+		if (distance == 0.0f) emit(i, 1.0f, 0.0f, radii);
+		else emit(i, dx / distance, dy / distance, radii - distance);
+	}
+}
+
+void CollisionSystem::AABBBatch()
+{
+	const PairBatch& p = boxes;
+	uint32_t count = static_cast<uint32_t>(p.a.size());
+	// Separates along the axis of least overlap, the contact point is the middle of the overlapping region
+	auto emit = [&](uint32_t i, float dx, float dy, float overlapX, float overlapY) {
+		Contact contact{ p.a[i], p.b[i] };
+		if (overlapX < overlapY) {
+			contact.normal = { dx < 0.0f ? -1.0f : 1.0f, 0.0f };
+			contact.penetration = overlapX;
+		}
+		else {
+			contact.normal = { 0.0f, dy < 0.0f ? -1.0f : 1.0f };
+			contact.penetration = overlapY;
+		}
+		float minX = (std::max)(p.ax[i] - p.ahx[i], p.bx[i] - p.bhx[i]);
+		float maxX = (std::min)(p.ax[i] + p.ahx[i], p.bx[i] + p.bhx[i]);
+		float minY = (std::max)(p.ay[i] - p.ahy[i], p.by[i] - p.bhy[i]);
+		float maxY = (std::min)(p.ay[i] + p.ahy[i], p.by[i] + p.bhy[i]);
+		contact.point = { (minX + maxX) * 0.5f, (minY + maxY) * 0.5f };
+		contacts.push_back(contact);
+	};
+
+	uint32_t i = 0;
+#ifdef COLLISION_SSE
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	const __m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= count; i += 4) {
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(&p.bx[i]), _mm_loadu_ps(&p.ax[i]));
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(&p.by[i]), _mm_loadu_ps(&p.ay[i]));
+		__m128 overlapX = _mm_sub_ps(_mm_add_ps(_mm_loadu_ps(&p.ahx[i]), _mm_loadu_ps(&p.bhx[i])), _mm_andnot_ps(signBit, dx));
+		__m128 overlapY = _mm_sub_ps(_mm_add_ps(_mm_loadu_ps(&p.ahy[i]), _mm_loadu_ps(&p.bhy[i])), _mm_andnot_ps(signBit, dy));
+		int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(overlapX, zero), _mm_cmpge_ps(overlapY, zero)));
+		if (mask == 0) continue;
+
+		alignas(16) float dxs[4], dys[4], oxs[4], oys[4];
+		_mm_store_ps(dxs, dx);
+		_mm_store_ps(dys, dy);
+		_mm_store_ps(oxs, overlapX);
+		_mm_store_ps(oys, overlapY);
+		while (mask) {
+			uint32_t lane = ECS::CountTrailingZeros(static_cast<uint64_t>(mask));
+			emit(i + lane, dxs[lane], dys[lane], oxs[lane], oys[lane]);
+			mask &= mask - 1;
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		float dx = p.bx[i] - p.ax[i];
+		float dy = p.by[i] - p.ay[i];
+		float overlapX = p.ahx[i] + p.bhx[i] - std::abs(dx);
+		float overlapY = p.ahy[i] + p.bhy[i] - std::abs(dy);
+		if (overlapX >= 0.0f && overlapY >= 0.0f) emit(i, dx, dy, overlapX, overlapY);
+	}
+}
+
+void CollisionSystem::Generic(Entity ea, Entity eb)
+{
+	const WorldCollider& a = world[ea];
+	const WorldCollider& b = world[eb];
+
+	if (a.shape == ColliderShape::Circle || b.shape == ColliderShape::Circle) {
+		// Circle against polygon, computed with the polygon first and flipped afterwards if needed
+		bool circleFirst = a.shape == ColliderShape::Circle;
+		const WorldCollider& poly = circleFirst ? b : a;
+		const WorldCollider& circle = circleFirst ? a : b;
+
+		float maxSeparation = -FLT_MAX;
+		uint32_t face = 0;
+		for (uint32_t i = 0; i < poly.vertexCount; i++) {
+			float separation = dot2(poly.normals[i], circle.center - poly.vertices[i]);
+			if (separation > circle.radius) return;
+			if (separation > maxSeparation) { maxSeparation = separation; face = i; }
+		}
+
+		glm::vec2 normal;
+		float penetration;
+		glm::vec2 point;
+		if (maxSeparation <= 0.0f) {
+			// Centre inside the polygon, push out through the nearest face
+			normal = poly.normals[face];
+			penetration = circle.radius - maxSeparation;
+			point = circle.center - normal * maxSeparation;
+		}
+		else {
+			glm::vec2 closest{};
+			float best = FLT_MAX;
+			for (uint32_t i = 0; i < poly.vertexCount; i++) {
+				glm::vec2 q = closestOnSegment(circle.center, poly.vertices[i], poly.vertices[(i + 1) % poly.vertexCount]);
+				glm::vec2 d = circle.center - q;
+				float d2 = dot2(d, d);
+				if (d2 < best) { best = d2; closest = q; }
+			}
+			if (best > circle.radius * circle.radius) return;
+			float distance = std::sqrt(best);
+			normal = distance > 0.0f ? (circle.center - closest) * (1.0f / distance) : poly.normals[face];
+			penetration = circle.radius - distance;
+			point = closest;
+		}
+		contacts.push_back({ ea, eb, circleFirst ? -normal : normal, penetration, point });
+		return;
+	}
+
+	// Separating axis test over the edge normals of both polygons
+	float bestPenetration = FLT_MAX;
+	glm::vec2 bestAxis{};
+	bool axisFromA = true;
+	auto testAxes = [&](const WorldCollider& owner, bool fromA) {
+		for (uint32_t i = 0; i < owner.vertexCount; i++) {
+			glm::vec2 axis = owner.normals[i];
+			float minA, maxA, minB, maxB;
+			projectPolygon(a.vertices, a.vertexCount, axis, minA, maxA);
+			projectPolygon(b.vertices, b.vertexCount, axis, minB, maxB);
+			float overlap = (std::min)(maxA, maxB) - (std::max)(minA, minB);
+			if (overlap < 0.0f) return false;
+			if (overlap < bestPenetration) {
+				bestPenetration = overlap;
+				bestAxis = axis;
+				axisFromA = fromA;
+			}
+		}
+		return true;
+	};
+	if (!testAxes(a, true) || !testAxes(b, false)) return;
+
+	if (dot2(bestAxis, b.center - a.center) < 0.0f) bestAxis = -bestAxis;
+
+	// Deepest vertex of the incident polygon, the one whose face was not picked
+	const WorldCollider& incident = axisFromA ? b : a;
+	glm::vec2 direction = axisFromA ? -bestAxis : bestAxis;
+	glm::vec2 point = incident.vertices[0];
+	float deepest = dot2(point, direction);
+	for (uint32_t i = 1; i < incident.vertexCount; i++) {
+		float d = dot2(incident.vertices[i], direction);
+		if (d > deepest) { deepest = d; point = incident.vertices[i]; }
+	}
+	contacts.push_back({ ea, eb, bestAxis, bestPenetration, point });
+}
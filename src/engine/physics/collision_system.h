@@ -0,0 +1,73 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "../ecs/entity_component_system.h"
+#include "../ecs/entity_components.h"
+
+class BroadphaseSystem;
+
+struct Contact {
+	Entity a;
+	Entity b;
+	// Unit vector from a towards b, moving b by normal * penetration separates the pair
+	glm::vec2 normal;
+	float penetration;
+	// World space point on the deepest feature
+	glm::vec2 point;
+};
+
+// Narrowphase for every broadphase pair where both entities have a ColliderComponent.
+// Circle/circle and AABB/AABB pairs are tested in batches of four per SSE instruction, the other combinations go
+// through SAT on world space polygons. Must be registered after the BroadphaseSystem so the pairs are current
+class CollisionSystem : public ECS::EntitySystem {
+public:
+	CollisionSystem(ECS::Coordinator* c, std::shared_ptr<BroadphaseSystem> broadphase);
+
+	void Update(float dt) override;
+
+	// Contacts found by the last Update, stored contiguously and reused between updates
+	const std::vector<Contact>& Contacts() const { return contacts; }
+
+private:
+	// Collider in world space, built once per Update for every entity in mEntities
+	struct WorldCollider {
+		ColliderShape shape;
+		glm::vec2 center;
+		float radius;
+		// Axis aligned half extents for AABB
+		glm::vec2 halfExtents;
+		// Boxes and polygons, with outward edge normals
+		uint32_t vertexCount;
+		glm::vec2 vertices[ColliderComponent::MAX_POLYGON_VERTICES];
+		glm::vec2 normals[ColliderComponent::MAX_POLYGON_VERTICES];
+	};
+
+	// Structure of arrays input for the batched tests
+	struct PairBatch {
+		std::vector<Entity> a, b;
+		std::vector<float> ax, ay, bx, by;
+		// Radius for circles, half extents for AABBs (ahy/bhy unused for circles)
+		std::vector<float> ahx, ahy, bhx, bhy;
+		void clear();
+		void push(Entity ea, Entity eb, const WorldCollider& ca, const WorldCollider& cb);
+	};
+
+	void BuildWorldCollider(Entity entity);
+	void CircleBatch();
+	void AABBBatch();
+	void Generic(Entity a, Entity b);
+
+	ECS::Coordinator& coordinator;
+	std::shared_ptr<BroadphaseSystem> broadphase;
+
+	std::vector<WorldCollider> world;
+	// world[e] is current when worldStamp[e] == stamp, which also tells whether e has a collider
+	std::vector<uint32_t> worldStamp;
+	uint32_t stamp = 0;
+
+	PairBatch circles;
+	PairBatch boxes;
+	std::vector<Contact> contacts;
+};
@@ -0,0 +1,304 @@
+#include "physics_system.h"
+#include "collision_system.h"
+#include "../ecs/entity_components.h"
+#include "../thread_pool.h"
+
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PHYSICS_SSE
+#endif
+
+PhysicsSystem::PhysicsSystem(ECS::Coordinator* c, std::shared_ptr<CollisionSystem> collision) :
+	coordinator(*c),
+	collision(collision),
+	bodyOf(MAX_ENTITIES, -1)
+{
+}
+
+void PhysicsSystem::Update(float dt)
+{
+	if (dt <= 0.0f) return;
+	Gather();
+	IntegrateVelocities(dt);
+	BuildConstraints(dt);
+	BuildIslands();
+	SolveIslands();
+	IntegratePositions(dt);
+	WriteBack();
+}
+
+void PhysicsSystem::Gather()
+{
+	for (Entity e : bodies) bodyOf[e] = -1;
+	bodies.assign(mEntities.begin(), mEntities.end());
+
+	size_t n = bodies.size();
+	for (auto* stream : { &px, &py, &vx, &vy, &gatheredVx, &gatheredVy, &angle, &angularVelocity, &invMass, &gravityScale, &damping, &restitution, &friction }) {
+		stream->resize(n);
+	}
+	pvx.assign(n, 0.0f);
+	pvy.assign(n, 0.0f);
+
+	for (size_t i = 0; i < n; i++) {
+		Entity e = bodies[i];
+		bodyOf[e] = static_cast<int32_t>(i);
+		auto& transform = coordinator.GetComponent<TransformComponent>(e);
+		auto& velocity = coordinator.GetComponent<VelocityComponent>(e);
+		auto& mass = coordinator.GetComponent<MassComponent>(e);
+
+		glm::vec2 translation = transform.getTranslation();
+		px[i] = translation.x;
+		py[i] = translation.y;
+		vx[i] = gatheredVx[i] = velocity.linear.x;
+		vy[i] = gatheredVy[i] = velocity.linear.y;
+		angle[i] = transform.getRotation();
+		angularVelocity[i] = velocity.angular;
+		invMass[i] = mass.mass > 0.0f ? 1.0f / mass.mass : 0.0f;
+		// Kinematic bodies keep their velocity
+		gravityScale[i] = mass.mass > 0.0f ? mass.gravityScale : 0.0f;
+		damping[i] = mass.mass > 0.0f ? mass.linearDamping : 0.0f;
+		restitution[i] = mass.restitution;
+		friction[i] = mass.friction;
+	}
+}
+
+void PhysicsSystem::IntegrateVelocities(float dt)
+{
+	// v = (v + g * gravityScale * dt) / (1 + dt * damping)
+	size_t n = bodies.size();
+	size_t i = 0;
+#ifdef PHYSICS_SSE
+	const __m128 gx = _mm_set1_ps(gravity.x * dt);
+	const __m128 gy = _mm_set1_ps(gravity.y * dt);
+	const __m128 step = _mm_set1_ps(dt);
+	const __m128 one = _mm_set1_ps(1.0f);
+	for (; i + 4 <= n; i += 4) {
+		__m128 scale = _mm_loadu_ps(&gravityScale[i]);
+		__m128 damp = _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(step, _mm_loadu_ps(&damping[i]))));
+		__m128 x = _mm_add_ps(_mm_loadu_ps(&vx[i]), _mm_mul_ps(scale, gx));
+		__m128 y = _mm_add_ps(_mm_loadu_ps(&vy[i]), _mm_mul_ps(scale, gy));
+		_mm_storeu_ps(&vx[i], _mm_mul_ps(x, damp));
+		_mm_storeu_ps(&vy[i], _mm_mul_ps(y, damp));
+	}
+#endif
+	for (; i < n; i++) {
+		float damp = 1.0f / (1.0f + dt * damping[i]);
+		vx[i] = (vx[i] + gravityScale[i] * gravity.x * dt) * damp;
+		vy[i] = (vy[i] + gravityScale[i] * gravity.y * dt) * damp;
+	}
+}
+
+void PhysicsSystem::BuildConstraints(float dt)
+{
+	constraints.clear();
+	// Colliders without a body act like static bodies with default material
+	const MassComponent defaultMaterial{};
+
+	for (const Contact& contact : collision->Contacts()) {
+		int32_t ia = bodyOf[contact.a];
+		int32_t ib = bodyOf[contact.b];
+		bool dynamicA = ia >= 0 && invMass[ia] > 0.0f;
+		bool dynamicB = ib >= 0 && invMass[ib] > 0.0f;
+		if (!dynamicA && !dynamicB) continue;
+
+		ContactConstraint c{};
+		c.a = dynamicA ? ia : -1;
+		c.b = dynamicB ? ib : -1;
+		c.fixedVelocityA = ia >= 0 && !dynamicA ? glm::vec2{ vx[ia], vy[ia] } : glm::vec2{ 0.0f, 0.0f };
+		c.fixedVelocityB = ib >= 0 && !dynamicB ? glm::vec2{ vx[ib], vy[ib] } : glm::vec2{ 0.0f, 0.0f };
+		c.normal = contact.normal;
+		c.invMassA = dynamicA ? invMass[ia] : 0.0f;
+		c.invMassB = dynamicB ? invMass[ib] : 0.0f;
+		c.effectiveMass = 1.0f / (c.invMassA + c.invMassB);
+
+		float restitutionA = ia >= 0 ? restitution[ia] : defaultMaterial.restitution;
+		float restitutionB = ib >= 0 ? restitution[ib] : defaultMaterial.restitution;
+		float frictionA = ia >= 0 ? friction[ia] : defaultMaterial.friction;
+		float frictionB = ib >= 0 ? friction[ib] : defaultMaterial.friction;
+		c.friction = std::sqrt(frictionA * frictionB);
+
+		glm::vec2 velocityA = dynamicA ? glm::vec2{ vx[ia], vy[ia] } : c.fixedVelocityA;
+		glm::vec2 velocityB = dynamicB ? glm::vec2{ vx[ib], vy[ib] } : c.fixedVelocityB;
+		glm::vec2 relative = velocityB - velocityA;
+		float approach = relative.x * c.normal.x + relative.y * c.normal.y;
+		c.bias = approach < -RESTITUTION_THRESHOLD ? -(std::max)(restitutionA, restitutionB) * approach : 0.0f;
+		c.correction = (std::min)(BAUMGARTE / dt * (std::max)(contact.penetration - LINEAR_SLOP, 0.0f), MAX_CORRECTION_VELOCITY);
+
+		c.key = (uint64_t(contact.a) << 32) | contact.b;
+		auto cached = impulseCache.find(c.key);
+		if (cached != impulseCache.end() && cached->second.direction.x * c.normal.x + cached->second.direction.y * c.normal.y > 0.95f) {
+			c.normalImpulse = cached->second.normal;
+			c.tangentImpulse = cached->second.tangent;
+		}
+		constraints.push_back(c);
+	}
+}
+
+int32_t PhysicsSystem::FindRoot(int32_t body)
+{
+	while (parent[body] != body) {
+		parent[body] = parent[parent[body]];
+		body = parent[body];
+	}
+	return body;
+}
+
+void PhysicsSystem::BuildIslands()
+{
+	// Dynamic bodies touching through constraints form an island. Static and kinematic sides are read only
+	// in the solver, so they don't join islands and islands never share a body that is written to
+	parent.resize(bodies.size());
+	std::iota(parent.begin(), parent.end(), 0);
+	for (const ContactConstraint& c : constraints) {
+		if (c.a < 0 || c.b < 0) continue;
+		int32_t ra = FindRoot(c.a);
+		int32_t rb = FindRoot(c.b);
+		if (ra != rb) parent[ra] = rb;
+	}
+
+	// Counting sort of the constraints by island
+	islandOfRoot.assign(bodies.size(), -1);
+	islandStart.clear();
+	for (const ContactConstraint& c : constraints) {
+		int32_t root = FindRoot(c.a >= 0 ? c.a : c.b);
+		if (islandOfRoot[root] < 0) {
+			islandOfRoot[root] = static_cast<int32_t>(islandStart.size());
+			islandStart.push_back(0);
+		}
+		islandStart[islandOfRoot[root]]++;
+	}
+	uint32_t running = 0;
+	for (uint32_t& start : islandStart) {
+		uint32_t count = start;
+		start = running;
+		running += count;
+	}
+	islandStart.push_back(running);
+
+	sorted.resize(constraints.size());
+	std::vector<uint32_t> cursor(islandStart.begin(), islandStart.end() - 1);
+	for (const ContactConstraint& c : constraints) {
+		int32_t island = islandOfRoot[FindRoot(c.a >= 0 ? c.a : c.b)];
+		sorted[cursor[island]++] = c;
+	}
+}
+
+void PhysicsSystem::SolveRange(uint32_t begin, uint32_t end)
+{
+	auto apply = [&](const ContactConstraint& c, const glm::vec2& impulse) {
+		if (c.a >= 0) { vx[c.a] -= impulse.x * c.invMassA; vy[c.a] -= impulse.y * c.invMassA; }
+		if (c.b >= 0) { vx[c.b] += impulse.x * c.invMassB; vy[c.b] += impulse.y * c.invMassB; }
+	};
+	auto applyPseudo = [&](const ContactConstraint& c, float impulse) {
+		if (c.a >= 0) { pvx[c.a] -= c.normal.x * impulse * c.invMassA; pvy[c.a] -= c.normal.y * impulse * c.invMassA; }
+		if (c.b >= 0) { pvx[c.b] += c.normal.x * impulse * c.invMassB; pvy[c.b] += c.normal.y * impulse * c.invMassB; }
+	};
+	auto relativeVelocity = [&](const ContactConstraint& c) {
+		glm::vec2 va = c.a >= 0 ? glm::vec2{ vx[c.a], vy[c.a] } : c.fixedVelocityA;
+		glm::vec2 vb = c.b >= 0 ? glm::vec2{ vx[c.b], vy[c.b] } : c.fixedVelocityB;
+		return vb - va;
+	};
+
+	// Warm start with last step's impulses
+	for (uint32_t i = begin; i < end; i++) {
+		const ContactConstraint& c = sorted[i];
+		glm::vec2 tangent{ -c.normal.y, c.normal.x };
+		apply(c, c.normal * c.normalImpulse + tangent * c.tangentImpulse);
+	}
+
+	for (uint32_t iteration = 0; iteration < velocityIterations; iteration++) {
+		for (uint32_t i = begin; i < end; i++) {
+			ContactConstraint& c = sorted[i];
+			glm::vec2 tangent{ -c.normal.y, c.normal.x };
+
+			// Friction, bounded by the current normal impulse
+			glm::vec2 dv = relativeVelocity(c);
+			float lambda = -c.effectiveMass * (dv.x * tangent.x + dv.y * tangent.y);
+			float maxFriction = c.friction * c.normalImpulse;
+			float tangentImpulse = std::clamp(c.tangentImpulse + lambda, -maxFriction, maxFriction);
+			apply(c, tangent * (tangentImpulse - c.tangentImpulse));
+			c.tangentImpulse = tangentImpulse;
+
+			// Non penetration, the accumulated impulse may only push
+			dv = relativeVelocity(c);
+			lambda = -c.effectiveMass * (dv.x * c.normal.x + dv.y * c.normal.y - c.bias);
+			float normalImpulse = (std::max)(c.normalImpulse + lambda, 0.0f);
+			apply(c, c.normal * (normalImpulse - c.normalImpulse));
+			c.normalImpulse = normalImpulse;
+		}
+	}
+
+	// Position correction on the pseudo velocities, static and kinematic sides don't take part
+	for (uint32_t iteration = 0; iteration < velocityIterations; iteration++) {
+		for (uint32_t i = begin; i < end; i++) {
+			ContactConstraint& c = sorted[i];
+			if (c.correction <= 0.0f) continue;
+			float pva = c.a >= 0 ? pvx[c.a] * c.normal.x + pvy[c.a] * c.normal.y : 0.0f;
+			float pvb = c.b >= 0 ? pvx[c.b] * c.normal.x + pvy[c.b] * c.normal.y : 0.0f;
+			float lambda = c.effectiveMass * (c.correction - (pvb - pva));
+			float pseudoImpulse = (std::max)(c.pseudoImpulse + lambda, 0.0f);
+			applyPseudo(c, pseudoImpulse - c.pseudoImpulse);
+			c.pseudoImpulse = pseudoImpulse;
+		}
+	}
+}
+
+void PhysicsSystem::SolveIslands()
+{
+	uint32_t islands = IslandCount();
+	if (islands > 1 && sorted.size() >= PARALLEL_MIN_CONSTRAINTS) {
+		// Islands share no dynamic body, so ranges of islands can be solved without synchronization
+		ThreadPool::global().parallelFor(islands, 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+			SolveRange(islandStart[begin], islandStart[end]);
+		});
+	}
+	else {
+		SolveRange(0, static_cast<uint32_t>(sorted.size()));
+	}
+
+	impulseCache.clear();
+	for (const ContactConstraint& c : sorted) {
+		impulseCache[c.key] = { c.normalImpulse, c.tangentImpulse, c.normal };
+	}
+}
+
+void PhysicsSystem::IntegratePositions(float dt)
+{
+	size_t n = bodies.size();
+	size_t i = 0;
+#ifdef PHYSICS_SSE
+	const __m128 step = _mm_set1_ps(dt);
+	for (; i + 4 <= n; i += 4) {
+		__m128 x = _mm_add_ps(_mm_loadu_ps(&vx[i]), _mm_loadu_ps(&pvx[i]));
+		__m128 y = _mm_add_ps(_mm_loadu_ps(&vy[i]), _mm_loadu_ps(&pvy[i]));
+		_mm_storeu_ps(&px[i], _mm_add_ps(_mm_loadu_ps(&px[i]), _mm_mul_ps(x, step)));
+		_mm_storeu_ps(&py[i], _mm_add_ps(_mm_loadu_ps(&py[i]), _mm_mul_ps(y, step)));
+		_mm_storeu_ps(&angle[i], _mm_add_ps(_mm_loadu_ps(&angle[i]), _mm_mul_ps(_mm_loadu_ps(&angularVelocity[i]), step)));
+	}
+#endif
+	for (; i < n; i++) {
+		px[i] += (vx[i] + pvx[i]) * dt;
+		py[i] += (vy[i] + pvy[i]) * dt;
+		angle[i] += angularVelocity[i] * dt;
+	}
+}
+
+void PhysicsSystem::WriteBack()
+{
+	for (size_t i = 0; i < bodies.size(); i++) {
+		bool moved = vx[i] != 0.0f || vy[i] != 0.0f || pvx[i] != 0.0f || pvy[i] != 0.0f;
+		bool turned = angularVelocity[i] != 0.0f;
+		if (moved || turned) {
+			auto& transform = coordinator.GetComponent<TransformComponent>(bodies[i]);
+			if (moved) transform.setTranslation({ px[i], py[i] });
+			if (turned) transform.setRotation(angle[i]);
+		}
+		if (vx[i] != gatheredVx[i] || vy[i] != gatheredVy[i]) {
+			coordinator.GetComponent<VelocityComponent>(bodies[i]).linear = { vx[i], vy[i] };
+		}
+	}
+}
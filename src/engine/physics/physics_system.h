@@ -0,0 +1,107 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+#include "../ecs/entity_component_system.h"
+
+class CollisionSystem;
+
+// Moves every entity with a TransformComponent, VelocityComponent and MassComponent.
+// Each Update gathers the bodies into SoA streams, integrates velocities (semi-implicit Euler), resolves the
+// CollisionSystem's contacts with a sequential impulse solver, integrates positions and writes back only the bodies
+// that changed. Contacts are grouped into islands of touching bodies which are solved in parallel.
+// Must be registered after the CollisionSystem
+class PhysicsSystem : public ECS::EntitySystem {
+public:
+	PhysicsSystem(ECS::Coordinator* c, std::shared_ptr<CollisionSystem> collision);
+
+	void Update(float dt) override;
+
+	void SetGravity(const glm::vec2& g) { gravity = g; }
+	void SetVelocityIterations(uint32_t iterations) { velocityIterations = iterations; }
+
+	uint32_t BodyCount() const { return static_cast<uint32_t>(bodies.size()); }
+	uint32_t IslandCount() const { return static_cast<uint32_t>(islandStart.empty() ? 0 : islandStart.size() - 1); }
+	uint32_t ConstraintCount() const { return static_cast<uint32_t>(constraints.size()); }
+
+private:
+	// Penetration allowed before position correction kicks in, keeps resting contacts from jittering
+	static constexpr float LINEAR_SLOP = 0.005f;
+	// Fraction of the remaining penetration removed per step
+	static constexpr float BAUMGARTE = 0.2f;
+	// Cap on the separation speed of position correction per contact
+	static constexpr float MAX_CORRECTION_VELOCITY = 2.0f;
+	// Slower approaches don't bounce
+	static constexpr float RESTITUTION_THRESHOLD = 1.0f;
+	// Fewer constraints than this are solved on the calling thread
+	static constexpr uint32_t PARALLEL_MIN_CONSTRAINTS = 256;
+
+	struct ContactConstraint {
+		// Dynamic body index or -1 for static and kinematic sides, whose velocity is then fixed
+		int32_t a, b;
+		glm::vec2 fixedVelocityA, fixedVelocityB;
+		glm::vec2 normal;
+		float invMassA, invMassB;
+		float effectiveMass;
+		// Target separation speed from restitution
+		float bias;
+		// Target separation speed from position correction, solved on the pseudo velocities
+		float correction;
+		float friction;
+		float normalImpulse;
+		float tangentImpulse;
+		float pseudoImpulse;
+		uint64_t key;
+	};
+
+	struct CachedImpulse {
+		float normal;
+		float tangent;
+		// Impulses are only reused while the contact keeps facing the same way
+		glm::vec2 direction;
+	};
+
+	void Gather();
+	void IntegrateVelocities(float dt);
+	void BuildConstraints(float dt);
+	void BuildIslands();
+	void SolveIslands();
+	void SolveRange(uint32_t begin, uint32_t end);
+	void IntegratePositions(float dt);
+	void WriteBack();
+
+	int32_t FindRoot(int32_t body);
+
+	ECS::Coordinator& coordinator;
+	std::shared_ptr<CollisionSystem> collision;
+
+	glm::vec2 gravity{ 0.0f, -9.81f };
+	uint32_t velocityIterations = 8;
+
+	// SoA body streams, indexed by body
+	std::vector<Entity> bodies;
+	std::vector<float> px, py, vx, vy;
+	// Position correction only moves bodies through these (split impulses). They are dropped after every step, so
+	// pushing a deep stack apart never turns into real velocity that would launch the top of the stack
+	std::vector<float> pvx, pvy;
+	// Velocities as gathered, to tell which bodies need a write back
+	std::vector<float> gatheredVx, gatheredVy;
+	std::vector<float> angle, angularVelocity;
+	std::vector<float> invMass, gravityScale, damping;
+	std::vector<float> restitution, friction;
+	// Body index of an entity, -1 if it isn't a body
+	std::vector<int32_t> bodyOf;
+
+	std::vector<ContactConstraint> constraints;
+	// Constraints sorted by island, island i is [islandStart[i], islandStart[i + 1])
+	std::vector<ContactConstraint> sorted;
+	std::vector<uint32_t> islandStart;
+	std::vector<int32_t> parent;
+	std::vector<int32_t> islandOfRoot;
+
+	// Accumulated impulses of the last step keyed by entity pair, reused as the starting guess (warm starting)
+	std::unordered_map<uint64_t, CachedImpulse> impulseCache;
+};
@@ -0,0 +1,368 @@
+#include "gpuParticleRenderSystem.h"
+#include "../ecs/entity_components.h"
+#include "../swapchain.h"
+#include "../util.h"
+
+#include <iostream>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+#include <vulkan/vulkan.h>
+
+// Layouts shared with shaders/gpu_particle_common.glsl
+struct GpuParticle {
+	glm::vec2 position;
+	glm::vec2 velocity;
+	float life;
+	float invLifetime;
+	uint32_t color;
+	uint32_t padding;
+};
+
+struct GpuParticleState {
+	uint32_t alive[2];
+	uint32_t padding0[2];
+	VkDrawIndirectCommand draw;
+	VkDispatchIndirectCommand dispatch;
+	uint32_t padding1;
+};
+
+struct GpuParticleComputePush {
+	glm::vec2 origin;
+	glm::vec2 spawnExtents;
+	glm::vec2 velocity;
+	glm::vec2 velocityVariance;
+	glm::vec2 acceleration;
+	float lifetime;
+	float lifetimeVariance;
+	float colorVariance;
+	float dt;
+	uint32_t emitCount;
+	uint32_t seed;
+	uint32_t capacity;
+	uint32_t source;
+	uint32_t sourceBuffer;
+	uint32_t targetBuffer;
+	uint32_t stateBuffer;
+};
+
+// Same as the push constant of particle.vert
+struct GpuParticleDrawPush {
+	glm::vec4 startColor{ 1.0f };
+	glm::vec4 endColor{ 1.0f };
+	uint32_t bufferIndex = 0;
+	float size = 0.0f;
+};
+
+GpuParticleRenderSystem::GpuParticleRenderSystem(ECS::Coordinator* c, Device& device, VkRenderPass renderPass, DescriptorManager& descriptorManager) :
+	ECS::EntitySystem(),
+	RenderSystem{ descriptorManager.getDescriptorSetLayout(), sizeof(GpuParticleDrawPush), *c },
+	device(device),
+	descriptorManager(descriptorManager),
+	spawnDebt(MAX_ENTITIES, 0.0f),
+	emitterTime(MAX_ENTITIES, 0.0),
+	emitted(MAX_ENTITIES, 0),
+	generationOf(MAX_ENTITIES, 0)
+{
+	std::cout << "Creating GPU Particle Render System\n";
+	createPipeline(renderPass, "/shaders/gpu_particle.vert.spv", "/shaders/particle.frag.spv", true, [](PipelineConfigInfo& config) {
+		config.depthStencilInfo.depthWriteEnable = VK_FALSE;
+	});
+
+	createComputePipelineLayout(descriptorManager.getDescriptorSetLayout());
+	simulatePipeline = std::make_unique<ComputePipeline>(util::enginePath("/shaders/gpu_particle_simulate.comp.spv"), computePipelineLayout);
+	emitPipeline = std::make_unique<ComputePipeline>(util::enginePath("/shaders/gpu_particle_emit.comp.spv"), computePipelineLayout);
+	finalizePipeline = std::make_unique<ComputePipeline>(util::enginePath("/shaders/gpu_particle_finalize.comp.spv"), computePipelineLayout);
+}
+
+GpuParticleRenderSystem::~GpuParticleRenderSystem()
+{
+	simulatePipeline.reset();
+	emitPipeline.reset();
+	finalizePipeline.reset();
+	vkDestroyPipelineLayout(Device::device(), computePipelineLayout, nullptr);
+}
+
+void GpuParticleRenderSystem::createComputePipelineLayout(VkDescriptorSetLayout setLayout)
+{
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(GpuParticleComputePush);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(Device::device(), &pipelineLayoutInfo, nullptr, &computePipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create compute pipeline layout");
+	}
+}
+
+void GpuParticleRenderSystem::Update(float dt)
+{
+	pendingTime += dt;
+}
+
+void GpuParticleRenderSystem::extract(RenderSnapshot& snapshot)
+{
+	for (Entity e : extracted) {
+		if (mEntities.count(e) == 0) generationOf[e] = 0;
+	}
+	extracted.clear();
+
+	snapshot.gpuEmitters.clear();
+	for (Entity e : mEntities) {
+		auto& emitter = coordinator.GetComponent<GpuParticleEmitterComponent>(e);
+		if (generationOf[e] == 0) {
+			generationOf[e] = ++generations;
+			spawnDebt[e] = 0.0f;
+			emitterTime[e] = 0.0;
+			emitted[e] = 0;
+		}
+		extracted.push_back(e);
+
+		uint32_t emitCount = 0;
+		if (emitter.emitting) {
+			spawnDebt[e] += emitter.rate * pendingTime;
+			emitCount = static_cast<uint32_t>(spawnDebt[e]);
+			spawnDebt[e] -= emitCount;
+		}
+		emitterTime[e] += pendingTime;
+		emitted[e] += emitCount;
+
+		GpuEmitterBatch batch{};
+		batch.emitter = e;
+		batch.generation = generationOf[e];
+		batch.capacity = emitter.capacity;
+		batch.seed = seed++;
+		batch.totalTime = emitterTime[e];
+		batch.totalEmitted = emitted[e];
+		batch.dt = pendingTime;
+		batch.emitCount = emitCount;
+		batch.origin = coordinator.GetComponent<TransformComponent>(e).getWorldTranslation();
+		batch.spawnExtents = emitter.spawnExtents;
+		batch.velocity = emitter.velocity;
+		batch.velocityVariance = emitter.velocityVariance;
+		batch.acceleration = emitter.acceleration;
+		batch.lifetime = emitter.lifetime;
+		batch.lifetimeVariance = emitter.lifetimeVariance;
+		batch.colorVariance = emitter.colorVariance;
+		batch.size = emitter.size;
+		batch.startColor = emitter.startColor;
+		batch.endColor = emitter.endColor;
+		snapshot.gpuEmitters.push_back(batch);
+	}
+	pendingTime = 0.0f;
+}
+
+GpuParticleRenderSystem::EmitterBuffers& GpuParticleRenderSystem::buffersFor(const GpuEmitterBatch& batch)
+{
+	auto found = emitters.find(batch.emitter);
+	if (found != emitters.end()) {
+		if (found->second->capacity == batch.capacity && found->second->generation == batch.generation) return *found->second;
+		retired.push_back({ std::move(found->second), Swapchain::MAX_FRAMES_IN_FLIGHT });
+	}
+
+	// Every emitter takes three descriptor slots, they are not reused when it goes away
+	auto buffers = std::make_unique<EmitterBuffers>();
+	buffers->capacity = batch.capacity;
+	for (uint32_t i = 0; i < 2; i++) {
+		buffers->particles[i] = std::make_unique<Buffer>(
+			device,
+			sizeof(GpuParticle),
+			batch.capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		buffers->particleHandles[i] = descriptorManager.storeBuffer(buffers->particles[i]->descriptorInfo());
+	}
+	buffers->state = std::make_unique<Buffer>(
+		device,
+		sizeof(GpuParticleState),
+		1,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	buffers->stateHandle = descriptorManager.storeBuffer(buffers->state->descriptorInfo());
+	// Starts from what this batch adds, anything earlier belongs to the buffers it replaces
+	buffers->generation = batch.generation;
+	buffers->appliedTime = batch.totalTime - batch.dt;
+	buffers->appliedEmitted = batch.totalEmitted - batch.emitCount;
+
+	EmitterBuffers& result = *buffers;
+	emitters[batch.emitter] = std::move(buffers);
+	return result;
+}
+
+void GpuParticleRenderSystem::simulate(VkCommandBuffer cmd, VkDescriptorSet& globalDescriptorSets, const RenderSnapshot& snapshot)
+{
+	// Buffers of removed emitters are freed once the frames that used them are done
+	for (size_t i = 0; i < retired.size();) {
+		if (--retired[i].framesLeft == 0) {
+			retired[i] = std::move(retired.back());
+			retired.pop_back();
+		}
+		else {
+			i++;
+		}
+	}
+	std::unordered_set<uint32_t> live;
+	for (const GpuEmitterBatch& batch : snapshot.gpuEmitters) live.insert(batch.emitter);
+	for (auto it = emitters.begin(); it != emitters.end();) {
+		if (live.count(it->first) == 0) {
+			retired.push_back({ std::move(it->second), Swapchain::MAX_FRAMES_IN_FLIGHT });
+			it = emitters.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	if (snapshot.gpuEmitters.empty()) return;
+
+	// Time and particles since the last snapshot that made it to the GPU, including the ones that were dropped
+	struct EmitterWork {
+		float dt;
+		uint32_t emitCount;
+	};
+	std::vector<EmitterWork> work(snapshot.gpuEmitters.size());
+	for (size_t i = 0; i < snapshot.gpuEmitters.size(); i++) {
+		const GpuEmitterBatch& batch = snapshot.gpuEmitters[i];
+		EmitterBuffers& buffers = buffersFor(batch);
+		uint64_t pendingEmits = batch.totalEmitted - buffers.appliedEmitted;
+		work[i].dt = static_cast<float>(batch.totalTime - buffers.appliedTime);
+		work[i].emitCount = static_cast<uint32_t>((std::min)(pendingEmits, uint64_t(batch.capacity)));
+		buffers.appliedTime = batch.totalTime;
+		buffers.appliedEmitted = batch.totalEmitted;
+	}
+
+	// Zero the counters and indirect arguments of new emitters
+	bool cleared = false;
+	for (const GpuEmitterBatch& batch : snapshot.gpuEmitters) {
+		EmitterBuffers& buffers = *emitters[batch.emitter];
+		if (buffers.cleared) continue;
+		vkCmdFillBuffer(cmd, buffers.state->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+		buffers.cleared = true;
+		cleared = true;
+	}
+
+	// Earlier frames wrote what this frame reads and still read (vertex shader, indirect arguments) what it overwrites
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | (cleared ? VK_ACCESS_TRANSFER_WRITE_BIT : 0);
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+	if (cleared) srcStages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+	vkCmdPipelineBarrier(cmd, srcStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	// Between the passes the atomic counters and particles written by one pass are read by the next
+	auto computeBarrier = [&](VkAccessFlags dstAccess, VkPipelineStageFlags dstStages) {
+		VkMemoryBarrier passBarrier{};
+		passBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		passBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		passBarrier.dstAccessMask = dstAccess;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStages, 0, 1, &passBarrier, 0, nullptr, 0, nullptr);
+	};
+
+	vkCmdBindDescriptorSets(
+		cmd,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		computePipelineLayout,
+		0, //first set
+		1, //descriptorSet Count
+		&globalDescriptorSets,
+		0, nullptr);
+
+	auto pushFor = [&](size_t index) {
+		const GpuEmitterBatch& batch = snapshot.gpuEmitters[index];
+		EmitterBuffers& buffers = *emitters[batch.emitter];
+		GpuParticleComputePush push{};
+		push.origin = batch.origin;
+		push.spawnExtents = batch.spawnExtents;
+		push.velocity = batch.velocity;
+		push.velocityVariance = batch.velocityVariance;
+		push.acceleration = batch.acceleration;
+		push.lifetime = batch.lifetime;
+		push.lifetimeVariance = batch.lifetimeVariance;
+		push.colorVariance = batch.colorVariance;
+		push.dt = work[index].dt;
+		push.emitCount = work[index].emitCount;
+		push.seed = batch.seed;
+		push.capacity = batch.capacity;
+		push.source = buffers.source;
+		push.sourceBuffer = buffers.particleHandles[buffers.source];
+		push.targetBuffer = buffers.particleHandles[1 - buffers.source];
+		push.stateBuffer = buffers.stateHandle;
+		vkCmdPushConstants(cmd, computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GpuParticleComputePush), &push);
+		return &buffers;
+	};
+
+	// Survivors, sized by the previous frame's alive count
+	simulatePipeline->bind(cmd);
+	for (size_t i = 0; i < snapshot.gpuEmitters.size(); i++) {
+		EmitterBuffers* buffers = pushFor(i);
+		vkCmdDispatchIndirect(cmd, buffers->state->getBuffer(), offsetof(GpuParticleState, dispatch));
+	}
+	computeBarrier(VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	emitPipeline->bind(cmd);
+	for (size_t i = 0; i < snapshot.gpuEmitters.size(); i++) {
+		if (work[i].emitCount == 0) continue;
+		pushFor(i);
+		vkCmdDispatch(cmd, (work[i].emitCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+	}
+	computeBarrier(VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	finalizePipeline->bind(cmd);
+	for (size_t i = 0; i < snapshot.gpuEmitters.size(); i++) {
+		pushFor(i);
+		vkCmdDispatch(cmd, 1, 1, 1);
+	}
+	computeBarrier(VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+
+	// This frame's target holds the live particles from now on
+	for (const GpuEmitterBatch& batch : snapshot.gpuEmitters) {
+		EmitterBuffers& buffers = *emitters[batch.emitter];
+		buffers.source = 1 - buffers.source;
+	}
+}
+
+void GpuParticleRenderSystem::render(VkCommandBuffer cmd, VkDescriptorSet& globalDescriptorSets, const RenderSnapshot& snapshot)
+{
+	if (snapshot.gpuEmitters.empty()) return;
+
+	bglPipeline->bind(cmd);
+
+	vkCmdBindDescriptorSets(
+		cmd,
+		VK_PIPELINE_BIND_POINT_GRAPHICS,
+		pipelineLayout,
+		0, //first set
+		1, //descriptorSet Count
+		&globalDescriptorSets,
+		0, nullptr);
+
+	for (const GpuEmitterBatch& batch : snapshot.gpuEmitters)
+	{
+		EmitterBuffers& buffers = *emitters[batch.emitter];
+		GpuParticleDrawPush push{};
+		push.startColor = batch.startColor;
+		push.endColor = batch.endColor;
+		push.bufferIndex = buffers.particleHandles[buffers.source];
+		push.size = batch.size;
+
+		vkCmdPushConstants(
+			cmd,
+			pipelineLayout,
+			VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			0,
+			sizeof(GpuParticleDrawPush),
+			&push);
+
+		// Instance count written by the finalize pass, firstInstance stays 0 so drawIndirectFirstInstance isn't needed
+		vkCmdDrawIndirect(cmd, buffers.state->getBuffer(), offsetof(GpuParticleState, draw), 1, sizeof(VkDrawIndirectCommand));
+	}
+}
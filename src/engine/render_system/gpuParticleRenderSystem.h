@@ -0,0 +1,88 @@
+#pragma once
+#include "../ecs/entity_component_system.h"
+#include "render_system.h"
+#include "render_snapshot.h"
+#include "../device.h"
+#include "../buffer.h"
+#include "../descriptor_manager.h"
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+// Particles of every entity with a TransformComponent and a GpuParticleEmitterComponent, kept entirely on the GPU.
+// Per frame and emitter, compute shaders move the surviving particles from one storage buffer into the other, append
+// the new ones and write the indirect draw and dispatch arguments from the atomic alive counter. The particles are then
+// drawn with one indirect draw, so no particle data crosses the bus.
+// Only core Vulkan 1.2 and the bindless storage buffers of the DescriptorManager are used (no subgroup operations,
+// float atomics or multi draw indirect), which keeps it working on software drivers like lavapipe.
+class GpuParticleRenderSystem : public ECS::EntitySystem, public RenderSystem {
+public:
+	GpuParticleRenderSystem(ECS::Coordinator* c, Device& device, VkRenderPass renderPass, DescriptorManager& descriptorManager);
+	~GpuParticleRenderSystem();
+
+	GpuParticleRenderSystem(const GpuParticleRenderSystem&) = delete;
+	GpuParticleRenderSystem& operator=(const GpuParticleRenderSystem&) = delete;
+
+	// Simulation thread. Only adds up the simulated time, the particles are moved on the GPU
+	void Update(float dt) override;
+	// Simulation thread. Describes the work of every emitter since the previous snapshot
+	void extract(RenderSnapshot& snapshot);
+	// Render thread, outside of a render pass. Records the compute passes of every emitter
+	void simulate(VkCommandBuffer cmd, VkDescriptorSet& globalDescriptorSets, const RenderSnapshot& snapshot);
+	// Render thread, inside the render pass after simulate
+	void render(VkCommandBuffer cmd, VkDescriptorSet& globalDescriptorSets, const RenderSnapshot& snapshot);
+
+private:
+	// Must match local_size_x of the gpu_particle compute shaders
+	static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+	// GPU buffers of one emitter
+	struct EmitterBuffers {
+		std::unique_ptr<Buffer> particles[2];
+		// Alive counters and the indirect arguments, see GpuParticleState
+		std::unique_ptr<Buffer> state;
+		BufferHandle_u32 particleHandles[2];
+		BufferHandle_u32 stateHandle;
+		uint32_t capacity = 0;
+		// particles[source] holds the live particles of the previous frame
+		uint32_t source = 0;
+		bool cleared = false;
+		uint32_t generation = 0;
+		// Totals of GpuEmitterBatch that were simulated so far
+		double appliedTime = 0.0;
+		uint64_t appliedEmitted = 0;
+	};
+
+	struct RetiredBuffers {
+		std::unique_ptr<EmitterBuffers> buffers;
+		// Frames left before the GPU is guaranteed to be done with them
+		uint32_t framesLeft;
+	};
+
+	EmitterBuffers& buffersFor(const GpuEmitterBatch& batch);
+	void createComputePipelineLayout(VkDescriptorSetLayout setLayout);
+
+	Device& device;
+	DescriptorManager& descriptorManager;
+
+	VkPipelineLayout computePipelineLayout;
+	std::unique_ptr<ComputePipeline> simulatePipeline;
+	std::unique_ptr<ComputePipeline> emitPipeline;
+	std::unique_ptr<ComputePipeline> finalizePipeline;
+
+	// Simulation thread, indexed by emitter entity
+	float pendingTime = 0.0f;
+	std::vector<float> spawnDebt;
+	std::vector<double> emitterTime;
+	std::vector<uint64_t> emitted;
+	std::vector<uint32_t> generationOf;
+	// Emitters of the previous extract, the ones that left start over when they come back
+	std::vector<Entity> extracted;
+	uint32_t generations = 0;
+	uint32_t seed = 1;
+
+	// Render thread
+	std::unordered_map<uint32_t, std::unique_ptr<EmitterBuffers>> emitters;
+	std::vector<RetiredBuffers> retired;
+};
@@ -0,0 +1,145 @@
+#include "particleRenderSystem.h"
+#include "../ecs/entity_components.h"
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <vulkan/vulkan.h>
+
+struct ParticlePushConstant {
+	glm::vec4 startColor{ 1.0f };
+	glm::vec4 endColor{ 1.0f };
+	uint32_t bufferIndex = 0;
+	float size = 0.0f;
+};
+
+ParticleRenderSystem::ParticleRenderSystem(ECS::Coordinator* c, Device& device, VkRenderPass renderPass, DescriptorManager& descriptorManager) :
+	ECS::EntitySystem(),
+	RenderSystem{ descriptorManager.getDescriptorSetLayout(), sizeof(ParticlePushConstant), *c },
+	device(device),
+	descriptorManager(descriptorManager),
+	poolOf(MAX_ENTITIES)
+{
+	std::cout << "Creating Particle Render System\n";
+	// Blended particles overlap at the same depth, writing depth would drop every particle drawn over an earlier one
+	createPipeline(renderPass, "/shaders/particle.vert.spv", "/shaders/particle.frag.spv", true, [](PipelineConfigInfo& config) {
+		config.depthStencilInfo.depthWriteEnable = VK_FALSE;
+	});
+}
+
+void ParticleRenderSystem::Update(float dt)
+{
+	// Emitters that were destroyed or lost one of the components since the last update
+	for (size_t i = 0; i < tracked.size();) {
+		Entity e = tracked[i];
+		if (mEntities.find(e) == mEntities.end()) {
+			poolOf[e].reset();
+			tracked[i] = tracked.back();
+			tracked.pop_back();
+		}
+		else {
+			i++;
+		}
+	}
+
+	particleCount = 0;
+	for (Entity e : mEntities) {
+		auto& emitter = coordinator.GetComponent<ParticleEmitterComponent>(e);
+		auto& pool = poolOf[e];
+		if (pool == nullptr) {
+			tracked.push_back(e);
+		}
+		if (pool == nullptr || pool->Capacity() != emitter.capacity) {
+			pool = std::make_unique<ParticlePool>(emitter.capacity, e + 1);
+		}
+
+		pool->Update(dt, emitter.acceleration);
+		pool->Compact();
+
+		if (emitter.emitting) {
+			pool->spawnDebt += emitter.rate * dt;
+			uint32_t spawn = static_cast<uint32_t>(pool->spawnDebt);
+			pool->spawnDebt -= spawn;
+			pool->Emit(spawn, coordinator.GetComponent<TransformComponent>(e).getWorldTranslation(), emitter);
+		}
+		particleCount += pool->Size();
+	}
+	lastStep = dt;
+}
+
+void ParticleRenderSystem::extract(RenderSnapshot& snapshot, float alpha)
+{
+	// Both vectors keep their capacity between frames
+	snapshot.particleBatches.clear();
+	snapshot.particles.resize(particleCount);
+
+	uint32_t first = 0;
+	for (Entity e : mEntities) {
+		const ParticlePool* pool = poolOf[e].get();
+		if (pool == nullptr || pool->Size() == 0) continue;
+
+		auto& emitter = coordinator.GetComponent<ParticleEmitterComponent>(e);
+		pool->Pack(snapshot.particles.data() + first, (alpha - 1.0f) * lastStep);
+		snapshot.particleBatches.push_back({ emitter.startColor, emitter.endColor, first, pool->Size(), emitter.size });
+		first += pool->Size();
+	}
+}
+
+void ParticleRenderSystem::reserve(uint32_t frameIndex, uint32_t count)
+{
+	FrameBuffer& frame = frameBuffers[frameIndex];
+	if (count <= frame.capacity) return;
+
+	// Grows geometrically, the descriptor slot of the old buffer is not reused so this should stay rare
+	frame.capacity = (std::max)({ count, frame.capacity * 2, MIN_BUFFER_PARTICLES });
+	frame.buffer = std::make_unique<Buffer>(
+		device,
+		sizeof(ParticleInstance),
+		frame.capacity,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	frame.buffer->map();
+	frame.handle = descriptorManager.storeBuffer(frame.buffer->descriptorInfo());
+}
+
+void ParticleRenderSystem::render(VkCommandBuffer cmd, VkDescriptorSet& globalDescriptorSets, uint32_t frameIndex, const RenderSnapshot& snapshot)
+{
+	if (snapshot.particleBatches.empty()) return;
+
+	uint32_t count = static_cast<uint32_t>(snapshot.particles.size());
+	reserve(frameIndex, count);
+	FrameBuffer& frame = frameBuffers[frameIndex];
+	// Coherent memory, no flush needed
+	std::memcpy(frame.buffer->getMappedMemory(), snapshot.particles.data(), sizeof(ParticleInstance) * count);
+
+	bglPipeline->bind(cmd);
+
+	vkCmdBindDescriptorSets(
+		cmd,
+		VK_PIPELINE_BIND_POINT_GRAPHICS,
+		pipelineLayout,
+		0, //first set
+		1, //descriptorSet Count
+		&globalDescriptorSets,
+		0, nullptr);
+
+	for (const ParticleBatch& batch : snapshot.particleBatches)
+	{
+		ParticlePushConstant push{};
+		push.startColor = batch.startColor;
+		push.endColor = batch.endColor;
+		push.bufferIndex = frame.handle;
+		push.size = batch.size;
+
+		vkCmdPushConstants(
+			cmd,
+			pipelineLayout,
+			VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			0,
+			sizeof(ParticlePushConstant),
+			&push);
+
+		// One quad per instance, gl_InstanceIndex starts at firstInstance and indexes the storage buffer
+		vkCmdDraw(cmd, 6, batch.instanceCount, 0, batch.firstInstance);
+	}
+}
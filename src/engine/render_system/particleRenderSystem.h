@@ -0,0 +1,62 @@
+#pragma once
+#include "../ecs/entity_component_system.h"
+#include "render_system.h"
+#include "render_snapshot.h"
+#include "../device.h"
+#include "../buffer.h"
+#include "../swapchain.h"
+#include "../descriptor_manager.h"
+#include "../particles/particle_pool.h"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+// Simulates and draws every entity with a TransformComponent and a ParticleEmitterComponent.
+// Each emitter owns a ParticlePool, particles never become entities. The render thread copies the packed particles of
+// the snapshot into a per frame storage buffer, bound through the bindless BUFFER binding of the DescriptorManager, and
+// issues one instanced draw per emitter.
+class ParticleRenderSystem : public ECS::EntitySystem, public RenderSystem {
+public:
+	ParticleRenderSystem(ECS::Coordinator* c, Device& device, VkRenderPass renderPass, DescriptorManager& descriptorManager);
+	~ParticleRenderSystem() = default;
+
+	ParticleRenderSystem(const ParticleRenderSystem&) = delete;
+	ParticleRenderSystem& operator=(const ParticleRenderSystem&) = delete;
+
+	// Simulation thread. Ages, moves and retires the particles of every emitter, then spawns the new ones
+	void Update(float dt) override;
+	// Simulation thread. Packs the live particles of every emitter into the snapshot
+	void extract(RenderSnapshot& snapshot, float alpha);
+	// Render thread. frameIndex picks the storage buffer, which must not be in use by the GPU anymore
+	void render(VkCommandBuffer cmd, VkDescriptorSet& globalDescriptorSets, uint32_t frameIndex, const RenderSnapshot& snapshot);
+
+	// Live particles over all emitters after the last Update
+	uint32_t getParticleCount() const { return particleCount; }
+
+private:
+	// Smallest storage buffer allocated, in particles
+	static constexpr uint32_t MIN_BUFFER_PARTICLES = 65536;
+
+	struct FrameBuffer {
+		std::unique_ptr<Buffer> buffer;
+		BufferHandle_u32 handle = 0;
+		uint32_t capacity = 0;
+	};
+
+	// Grows the storage buffer of frameIndex to hold count particles
+	void reserve(uint32_t frameIndex, uint32_t count);
+
+	Device& device;
+	DescriptorManager& descriptorManager;
+
+	// Pool of each emitter entity, indexed by entity
+	std::vector<std::unique_ptr<ParticlePool>> poolOf;
+	// Entities with a pool, to free the pools of entities that left the system
+	std::vector<Entity> tracked;
+	// Length of the last step, particles are drawn extrapolated back from the current step by (1 - alpha) of it
+	float lastStep = 0.0f;
+	uint32_t particleCount = 0;
+
+	std::array<FrameBuffer, Swapchain::MAX_FRAMES_IN_FLIGHT> frameBuffers;
+};
@@ -0,0 +1,48 @@
+#include "render_snapshot.h"
+
+RenderSnapshot* RenderSnapshotBuffer::tryBeginWrite(std::chrono::microseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	bool available = cv.wait_for(lock, timeout, [this] {
+		return writeIndex != readingIndex && writeIndex != readyIndex;
+	});
+	return available ? &slots[writeIndex] : nullptr;
+}
+
+void RenderSnapshotBuffer::publish()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		readyIndex = writeIndex;
+		writeIndex ^= 1;
+	}
+	cv.notify_all();
+}
+
+const RenderSnapshot* RenderSnapshotBuffer::acquire()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	cv.wait(lock, [this] { return readyIndex != NONE || closed; });
+	if (closed) return nullptr;
+	readingIndex = readyIndex;
+	readyIndex = NONE;
+	return &slots[readingIndex];
+}
+
+void RenderSnapshotBuffer::release()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		readingIndex = NONE;
+	}
+	cv.notify_all();
+}
+
+void RenderSnapshotBuffer::close()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+	}
+	cv.notify_all();
+}
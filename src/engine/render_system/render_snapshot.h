@@ -0,0 +1,109 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#include <glm/glm.hpp>
+
+// Everything the render thread needs to draw one frame, extracted from the ECS by the simulation thread.
+// The render thread never touches the ECS, so the simulation of the next frame can run while this one is recorded.
+struct SpriteInstance {
+	glm::mat3 transform{ 1.0f };
+	glm::vec4 color{ 1.0f };
+};
+
+// Layout of one particle in the storage buffer read by particle.vert
+struct ParticleInstance {
+	glm::vec2 position;
+	// 0 when spawned, 1 when it dies
+	float age;
+	// RGBA8, red in the lowest byte
+	uint32_t color;
+};
+
+// One instanced draw over particles [firstInstance, firstInstance + instanceCount)
+struct ParticleBatch {
+	glm::vec4 startColor;
+	glm::vec4 endColor;
+	uint32_t firstInstance;
+	uint32_t instanceCount;
+	float size;
+};
+
+// Work for the compute shaders of one GPU emitter. Time and emission are running totals since the emitter appeared:
+// snapshots that are replaced before the render thread acquires them or dropped on a swapchain recreate never
+// reach the GPU, so the render thread runs the difference to the totals it has already applied
+struct GpuEmitterBatch {
+	// Emitter entity, keys the GPU buffers of the emitter
+	uint32_t emitter;
+	// Changes when the entity becomes a different emitter, the totals start over
+	uint32_t generation;
+	uint32_t capacity;
+	// Different for every batch, seeds the random spawn values
+	uint32_t seed;
+	// Seconds simulated and particles spawned since the emitter appeared
+	double totalTime;
+	uint64_t totalEmitted;
+	// Part of the totals added since the previous snapshot, what a new emitter starts from
+	float dt;
+	uint32_t emitCount;
+	glm::vec2 origin;
+	glm::vec2 spawnExtents;
+	glm::vec2 velocity;
+	glm::vec2 velocityVariance;
+	glm::vec2 acceleration;
+	float lifetime;
+	float lifetimeVariance;
+	float colorVariance;
+	float size;
+	glm::vec4 startColor;
+	glm::vec4 endColor;
+};
+
+struct RenderSnapshot {
+	glm::mat4 projectionMatrix{ 1.0f };
+	glm::mat4 viewMatrix{ 1.0f };
+	std::vector<SpriteInstance> sprites;
+	// Particles of every emitter back to back, one batch per emitter
+	std::vector<ParticleInstance> particles;
+	std::vector<ParticleBatch> particleBatches;
+	std::vector<GpuEmitterBatch> gpuEmitters;
+};
+
+// Two snapshots handed back and forth between the simulation thread (writer) and the render thread (reader).
+// The writer fills one slot while the reader draws from the other. A slot is only reused once the reader has released it.
+class RenderSnapshotBuffer {
+public:
+	RenderSnapshotBuffer() = default;
+	RenderSnapshotBuffer(const RenderSnapshotBuffer&) = delete;
+	RenderSnapshotBuffer& operator=(const RenderSnapshotBuffer&) = delete;
+
+	// Returns the slot to fill, or nullptr if the reader still holds it after waiting for timeout.
+	// The writer keeps running (polling events, simulating) instead of blocking on a slow or minimized render thread
+	RenderSnapshot* tryBeginWrite(std::chrono::microseconds timeout);
+	// Hands the slot returned by tryBeginWrite to the reader
+	void publish();
+
+	// Blocks until a snapshot is published. Returns nullptr once close() was called
+	const RenderSnapshot* acquire();
+	// The reader is done with the snapshot returned by acquire
+	void release();
+
+	void close();
+
+private:
+	static constexpr int NONE = -1;
+
+	RenderSnapshot slots[2];
+	int writeIndex = 0;
+	// Published but not yet acquired
+	int readyIndex = NONE;
+	// Acquired but not yet released
+	int readingIndex = NONE;
+	bool closed = false;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+};
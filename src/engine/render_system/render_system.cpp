@@ -236,6 +236,45 @@ void Pipeline::createShaderModule(const std::vector<char>& code, VkShaderModule*
 	}
 }
 
+ComputePipeline::ComputePipeline(const std::string& compFilePath, VkPipelineLayout layout)
+{
+	assert(layout != VK_NULL_HANDLE && "Cannot create compute pipeline:: no pipelineLayout provided");
+	auto compCode = Pipeline::readFile(compFilePath);
+
+	VkShaderModuleCreateInfo moduleInfo{};
+	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleInfo.codeSize = compCode.size();
+	moduleInfo.pCode = reinterpret_cast<const uint32_t*>(compCode.data());
+	if (vkCreateShaderModule(Device::device(), &moduleInfo, nullptr, &compShaderModule) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create shader module");
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = compShaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = layout;
+	pipelineInfo.basePipelineIndex = -1;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+	if (vkCreateComputePipelines(Device::device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create compute pipeline");
+	}
+}
+
+ComputePipeline::~ComputePipeline()
+{
+	vkDestroyShaderModule(Device::device(), compShaderModule, nullptr);
+	vkDestroyPipeline(Device::device(), computePipeline, nullptr);
+}
+
+void ComputePipeline::bind(VkCommandBuffer commandBuffer)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+}
+
 RenderSystem::RenderSystem(VkDescriptorSetLayout setLayout, size_t pushConstantSize, ECS::Coordinator& _coordinator) : coordinator{_coordinator}
 {
 	createPipelineLayout(setLayout, pushConstantSize);
@@ -45,6 +45,7 @@ public:
 	static void enableAlphaBlending(PipelineConfigInfo& configInfo);
 
 private:
+	friend class ComputePipeline;
 	static std::vector<char> readFile(const std::string& filepath);
 
 	void createGraphicsPipeline(const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo);
@@ -61,6 +62,21 @@ private:
 	VkShaderModule fragShaderModule;
 };
 
+// Single compute shader pipeline. The layout is owned by the caller
+class ComputePipeline {
+public:
+	ComputePipeline(const std::string& compFilePath, VkPipelineLayout layout);
+	~ComputePipeline();
+
+	ComputePipeline(const ComputePipeline&) = delete;
+	ComputePipeline operator=(const ComputePipeline&) = delete;
+	void bind(VkCommandBuffer commandBuffer);
+
+private:
+	VkPipeline computePipeline;
+	VkShaderModule compShaderModule;
+};
+
 class RenderSystem {
 protected:
 	RenderSystem(
@@ -1,8 +1,15 @@
 #include "spriteRenderSystem.h"
 #include "../ecs/entity_component_system.h"
 #include "../ecs/entity_components.h"
+#include "../spatial/spatial_hash.h"
 #include <iostream>
 #include <vulkan/vulkan.h>
+#include <cfloat>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SPRITE_CULL_SSE
+#endif
 
 struct SpritePushConstant {
 	alignas(16) glm::mat4 tMat{ 1.0f };
@@ -18,7 +25,94 @@ SpriteRenderSystem::SpriteRenderSystem(ECS::Coordinator* c, Device& device, VkRe
 }
 
 
-void SpriteRenderSystem::render(VkCommandBuffer cmd, VkDescriptorSet& globalDescriptorSets)
+// Appends the index of every box overlapping view. Four boxes per SSE compare
+static void cullPacked(const float* minX, const float* minY, const float* maxX, const float* maxY, uint32_t count, const AABB& view, std::vector<uint32_t>& visible)
+{
+	uint32_t i = 0;
+#ifdef SPRITE_CULL_SSE
+	const __m128 viewMinX = _mm_set1_ps(view.min.x);
+	const __m128 viewMinY = _mm_set1_ps(view.min.y);
+	const __m128 viewMaxX = _mm_set1_ps(view.max.x);
+	const __m128 viewMaxY = _mm_set1_ps(view.max.y);
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minX + i), viewMaxX), _mm_cmpge_ps(_mm_loadu_ps(maxX + i), viewMinX));
+		__m128 y = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minY + i), viewMaxY), _mm_cmpge_ps(_mm_loadu_ps(maxY + i), viewMinY));
+		uint64_t mask = static_cast<uint64_t>(_mm_movemask_ps(_mm_and_ps(x, y)));
+		while (mask) {
+			visible.push_back(i + ECS::CountTrailingZeros(mask));
+			mask &= mask - 1;
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		if (minX[i] <= view.max.x && maxX[i] >= view.min.x && minY[i] <= view.max.y && maxY[i] >= view.min.y) {
+			visible.push_back(i);
+		}
+	}
+}
+
+AABB SpriteRenderSystem::visibleRect(const glm::mat4& projection, const glm::mat4& view)
+{
+	// Unproject the corners of the screen. Orthographic, so the depth used doesn't change x and y
+	glm::mat4 inverse = glm::inverse(projection * view);
+	AABB rect{ glm::vec2{ FLT_MAX }, glm::vec2{ -FLT_MAX } };
+	for (float x : { -1.0f, 1.0f }) {
+		for (float y : { -1.0f, 1.0f }) {
+			glm::vec4 world = inverse * glm::vec4{ x, y, 0.5f, 1.0f };
+			glm::vec2 p{ world.x / world.w, world.y / world.w };
+			rect.min = glm::min(rect.min, p);
+			rect.max = glm::max(rect.max, p);
+		}
+	}
+	return rect;
+}
+
+void SpriteRenderSystem::extract(RenderSnapshot& snapshot, float alpha)
+{
+	// The vector keeps its capacity between frames so this does not allocate in the steady state
+	snapshot.sprites.clear();
+	const glm::vec4 color{ 128,128,128,1 };
+	const glm::vec2 halfExtent{ SPRITE_HALF_EXTENT };
+	AABB view = visibleRect(snapshot.projectionMatrix, snapshot.viewMatrix);
+	uint32_t total = static_cast<uint32_t>(mEntities.size());
+	cullingStats = {};
+
+	if (spatialHash != nullptr && total >= SPATIAL_QUERY_MIN_SPRITES) {
+		// The hash holds the positions of the last simulation step while sprites are drawn interpolated towards them,
+		// one cell of slack covers sprites moving up to a cell per step
+		glm::vec2 slack{ SPRITE_HALF_EXTENT + spatialHash->Hash().CellSize() };
+		spatialHash->Hash().ForEachInAABB(view.min - slack, view.max + slack, [&](Entity e, const glm::vec2&) {
+			if (mEntities.find(e) == mEntities.end()) return;
+			glm::mat3 transform = coordinator.GetComponent<TransformComponent>(e).interpolatedMat3(alpha);
+			if (AABB::FromCenter({ transform[2].x, transform[2].y }, halfExtent).Overlaps(view)) {
+				snapshot.sprites.push_back({ transform, color });
+			}
+		});
+		cullingStats.spatialQuery = true;
+	}
+	else {
+		candidates.clear();
+		minX.clear(); minY.clear(); maxX.clear(); maxY.clear();
+		for (auto& e : mEntities)
+		{
+			auto& transform = coordinator.GetComponent<TransformComponent>(e);
+			candidates.push_back({ transform.interpolatedMat3(alpha), color });
+			const glm::vec3& t = candidates.back().transform[2];
+			minX.push_back(t.x - SPRITE_HALF_EXTENT);
+			minY.push_back(t.y - SPRITE_HALF_EXTENT);
+			maxX.push_back(t.x + SPRITE_HALF_EXTENT);
+			maxY.push_back(t.y + SPRITE_HALF_EXTENT);
+		}
+		visible.clear();
+		cullPacked(minX.data(), minY.data(), maxX.data(), maxY.data(), total, view, visible);
+		for (uint32_t i : visible) snapshot.sprites.push_back(candidates[i]);
+	}
+
+	cullingStats.visible = static_cast<uint32_t>(snapshot.sprites.size());
+	cullingStats.culled = total - cullingStats.visible;
+}
+
+void SpriteRenderSystem::render(VkCommandBuffer cmd, VkDescriptorSet& globalDescriptorSets, const RenderSnapshot& snapshot)
 {
 	//std::cout << mEntities.size() << " Entities with TransformComponent\n";
 
@@ -35,13 +129,11 @@ void SpriteRenderSystem::render(VkCommandBuffer cmd, VkDescriptorSet& globalDesc
 
 	//vkCmdBindVertexBuffers(cmd, 0, 0, VK_NULL_HANDLE, VK_NULL_HANDLE);
 
-	for (auto& e : mEntities)
+	for (auto& sprite : snapshot.sprites)
 	{
-		auto& transform = coordinator.GetComponent<TransformComponent>(e);
-		//std::cout << transform.getWorldTranslation().x << " " << transform.getWorldTranslation().y << "\n";
 		SpritePushConstant push{};
-		push.tMat = transform.mat3();
-		push.color = glm::vec4{ 128,128,128,1 };
+		push.tMat = sprite.transform;
+		push.color = sprite.color;
 
 		vkCmdPushConstants(
 			cmd,
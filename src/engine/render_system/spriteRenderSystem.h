@@ -1,7 +1,20 @@
 #pragma once
 #include "../ecs/entity_component_system.h"
 #include "render_system.h"
+#include "render_snapshot.h"
 #include "../device.h"
+#include "../spatial/aabb.h"
+
+#include <vector>
+
+class SpatialHashSystem;
+
+struct CullingStats {
+	uint32_t visible = 0;
+	uint32_t culled = 0;
+	// The candidates came from the spatial hash instead of testing every sprite
+	bool spatialQuery = false;
+};
 
 class SpriteRenderSystem : public ECS::EntitySystem, public RenderSystem {
 public:
@@ -11,8 +24,29 @@ public:
 	SpriteRenderSystem(const SpriteRenderSystem&) = delete;
 	SpriteRenderSystem& operator=(const SpriteRenderSystem&) = delete;
 
-	void render(VkCommandBuffer cmd, VkDescriptorSet& globalDescriptorSets);
+	// Simulation thread. Packs every sprite into the snapshot, alpha is how far rendering is between the previous and the current simulation step
+	void extract(RenderSnapshot& snapshot, float alpha);
+	// Render thread. Only reads the snapshot, never the ECS
+	void render(VkCommandBuffer cmd, VkDescriptorSet& globalDescriptorSets, const RenderSnapshot& snapshot);
+
+	// With enough sprites, extract asks this hash for the sprites around the camera instead of testing every one
+	void setSpatialHash(const SpatialHashSystem* hash) { spatialHash = hash; }
+	// Visible and culled sprites of the last extract
+	const CullingStats& getCullingStats() const { return cullingStats; }
 
 private:
-    
+	// The sprite quad spans -1..1 around the transform, see simple_shader.vert
+	static constexpr float SPRITE_HALF_EXTENT = 1.0f;
+	static constexpr uint32_t SPATIAL_QUERY_MIN_SPRITES = 2048;
+
+	// World space rectangle seen through the projection and view matrices
+	static AABB visibleRect(const glm::mat4& projection, const glm::mat4& view);
+
+	const SpatialHashSystem* spatialHash = nullptr;
+	CullingStats cullingStats;
+
+	// Interpolated sprites and their packed bounds, kept between frames to avoid reallocating
+	std::vector<SpriteInstance> candidates;
+	std::vector<float> minX, minY, maxX, maxY;
+	std::vector<uint32_t> visible;
 };
\ No newline at end of file
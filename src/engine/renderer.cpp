@@ -1,5 +1,7 @@
 #include "renderer.h"
 #include <cassert>
+#include <thread>
+#include <chrono>
 
 #define VK_CHECK(x)                                                     \
 	do                                                                  \
@@ -122,9 +124,10 @@ void Renderer::recreateSwapChain()
 	//Get the new window extent
 	VkExtent2D extent = window.getExtent();
 	//If there is at least one dimension with length of 0(or sizeless), the program will pause which is during minimization.
+	//This runs on the render thread, events are still polled by the main thread so only wait for the size to change.
 	while (extent.width == 0 || extent.height == 0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
 		extent = window.getExtent();
-		glfwWaitEvents();
 	}
 	//Wait for current swapchain to no longer be used
 	vkDeviceWaitIdle(Device::device());
@@ -0,0 +1,50 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+
+// Axis aligned box in world space
+struct AABB {
+	glm::vec2 min{ 0.0f, 0.0f };
+	glm::vec2 max{ 0.0f, 0.0f };
+
+	static AABB FromCenter(const glm::vec2& center, const glm::vec2& halfExtents) { return { center - halfExtents, center + halfExtents }; }
+
+	glm::vec2 Center() const { return (min + max) * 0.5f; }
+	glm::vec2 HalfExtents() const { return (max - min) * 0.5f; }
+	// Cost metric used by the AABB tree, the 2D analogue of surface area
+	float Perimeter() const { return 2.0f * ((max.x - min.x) + (max.y - min.y)); }
+
+	bool Overlaps(const AABB& o) const { return min.x <= o.max.x && o.min.x <= max.x && min.y <= o.max.y && o.min.y <= max.y; }
+	bool Contains(const AABB& o) const { return min.x <= o.min.x && min.y <= o.min.y && o.max.x <= max.x && o.max.y <= max.y; }
+
+	static AABB Union(const AABB& a, const AABB& b)
+	{
+		return { { (std::min)(a.min.x, b.min.x), (std::min)(a.min.y, b.min.y) }, { (std::max)(a.max.x, b.max.x), (std::max)(a.max.y, b.max.y) } };
+	}
+
+	// Slab test of the segment from + t * delta, t in [0, maxT]. Writes the entry fraction to t
+	bool RayCast(const glm::vec2& from, const glm::vec2& delta, float maxT, float& t) const
+	{
+		float tMin = 0.0f;
+		float tMax = maxT;
+		for (int axis = 0; axis < 2; axis++) {
+			float o = axis == 0 ? from.x : from.y;
+			float d = axis == 0 ? delta.x : delta.y;
+			float lo = axis == 0 ? min.x : min.y;
+			float hi = axis == 0 ? max.x : max.y;
+			if (d == 0.0f) {
+				if (o < lo || o > hi) return false;
+				continue;
+			}
+			float inv = 1.0f / d;
+			float t1 = (lo - o) * inv;
+			float t2 = (hi - o) * inv;
+			if (t1 > t2) std::swap(t1, t2);
+			tMin = (std::max)(tMin, t1);
+			tMax = (std::min)(tMax, t2);
+			if (tMin > tMax) return false;
+		}
+		t = tMin;
+		return true;
+	}
+};
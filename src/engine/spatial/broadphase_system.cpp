@@ -0,0 +1,75 @@
+#include "broadphase_system.h"
+#include "../ecs/entity_components.h"
+
+#include <cmath>
+#include <algorithm>
+
+BroadphaseSystem::BroadphaseSystem(ECS::Coordinator* c, float margin) : coordinator(*c), tree(margin)
+{
+	proxyOf.fill(DynamicAABBTree::NULL_NODE);
+}
+
+AABB BroadphaseSystem::WorldBounds(Entity entity) const
+{
+	auto& transform = coordinator.GetComponent<TransformComponent>(entity);
+	auto& local = coordinator.GetComponent<BoundsComponent>(entity);
+	glm::vec2 scale = transform.getWorldScale();
+	glm::vec2 halfExtents{ local.halfExtents.x * std::abs(scale.x), local.halfExtents.y * std::abs(scale.y) };
+	return AABB::FromCenter(transform.getWorldTranslation() + local.offset, halfExtents);
+}
+
+void BroadphaseSystem::Update(float dt)
+{
+	// Entities that were destroyed or lost one of the components since the last update
+	for (size_t i = 0; i < tracked.size();) {
+		Entity e = tracked[i];
+		if (mEntities.find(e) == mEntities.end()) {
+			tree.DestroyProxy(proxyOf[e]);
+			proxyOf[e] = DynamicAABBTree::NULL_NODE;
+			tracked[i] = tracked.back();
+			tracked.pop_back();
+		}
+		else {
+			i++;
+		}
+	}
+
+	for (Entity e : mEntities) {
+		AABB box = WorldBounds(e);
+		if (proxyOf[e] == DynamicAABBTree::NULL_NODE) {
+			proxyOf[e] = tree.CreateProxy(box, e);
+			tracked.push_back(e);
+		}
+		else {
+			tree.MoveProxy(proxyOf[e], box, box.Center() - bounds[e].Center());
+		}
+		bounds[e] = box;
+	}
+
+	pairs.clear();
+	tree.FindPairs(pairs, parallelPairs);
+}
+
+void BroadphaseSystem::QueryAABB(const AABB& box, std::vector<Entity>& out) const
+{
+	tree.QueryAABB(box, [&](int32_t proxy) {
+		Entity e = tree.GetEntity(proxy);
+		if (bounds[e].Overlaps(box)) out.push_back(e);
+		return true;
+	});
+}
+
+void BroadphaseSystem::QueryRay(const glm::vec2& from, const glm::vec2& to, std::vector<Entity>& out) const
+{
+	std::vector<std::pair<float, Entity>> hits;
+	glm::vec2 delta = to - from;
+	tree.RayCast(from, to, [&](int32_t proxy, float) {
+		Entity e = tree.GetEntity(proxy);
+		float t;
+		if (bounds[e].RayCast(from, delta, 1.0f, t)) hits.push_back({ t, e });
+		// Keep going, every hit is reported
+		return 1.0f;
+	});
+	std::sort(hits.begin(), hits.end());
+	for (auto& hit : hits) out.push_back(hit.second);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <utility>
+
+#include "dynamic_aabb_tree.h"
+#include "../ecs/entity_component_system.h"
+
+// Keeps a DynamicAABBTree proxy for every entity with a TransformComponent and a BoundsComponent and
+// regenerates the overlapping pairs every Update
+class BroadphaseSystem : public ECS::EntitySystem {
+public:
+	BroadphaseSystem(ECS::Coordinator* c, float margin = 0.1f);
+
+	void Update(float dt) override;
+
+	// Splits pair finding over ThreadPool::global() for large scenes
+	void SetParallelPairFinding(bool enabled) { parallelPairs = enabled; }
+
+	// Entity pairs whose fat boxes overlapped at the last Update, lower entity first
+	const std::vector<std::pair<Entity, Entity>>& Pairs() const { return pairs; }
+	const DynamicAABBTree& Tree() const { return tree; }
+
+	// Bounds of entity in world space as of the last Update
+	AABB GetBounds(Entity entity) const { return bounds[entity]; }
+
+	// Entities whose bounds overlap box
+	void QueryAABB(const AABB& box, std::vector<Entity>& out) const;
+	// Entities whose bounds the segment from -> to crosses, nearest first
+	void QueryRay(const glm::vec2& from, const glm::vec2& to, std::vector<Entity>& out) const;
+
+private:
+	AABB WorldBounds(Entity entity) const;
+
+	ECS::Coordinator& coordinator;
+	DynamicAABBTree tree;
+	bool parallelPairs = false;
+
+	std::array<int32_t, MAX_ENTITIES> proxyOf;
+	std::array<AABB, MAX_ENTITIES> bounds;
+	// Entities that currently own a proxy
+	std::vector<Entity> tracked;
+	std::vector<std::pair<Entity, Entity>> pairs;
+};
@@ -0,0 +1,326 @@
+#include "dynamic_aabb_tree.h"
+#include "../thread_pool.h"
+
+#include <cassert>
+#include <algorithm>
+
+DynamicAABBTree::DynamicAABBTree(float margin, float displacementMultiplier) : margin(margin), displacementMultiplier(displacementMultiplier)
+{
+	nodes.reserve(64);
+}
+
+int32_t DynamicAABBTree::AllocateNode()
+{
+	if (freeList == NULL_NODE) {
+		nodes.emplace_back();
+		nodes.back().height = 0;
+		return static_cast<int32_t>(nodes.size() - 1);
+	}
+	int32_t id = freeList;
+	freeList = nodes[id].parentOrNext;
+	nodes[id] = Node{};
+	nodes[id].height = 0;
+	return id;
+}
+
+void DynamicAABBTree::FreeNode(int32_t id)
+{
+	nodes[id].parentOrNext = freeList;
+	nodes[id].height = -1;
+	freeList = id;
+}
+
+int32_t DynamicAABBTree::CreateProxy(const AABB& box, Entity entity)
+{
+	int32_t proxy = AllocateNode();
+	glm::vec2 fat = FatMargin(box);
+	nodes[proxy].box = { box.min - fat, box.max + fat };
+	nodes[proxy].entity = entity;
+	InsertLeaf(proxy);
+	proxyCount++;
+	return proxy;
+}
+
+void DynamicAABBTree::DestroyProxy(int32_t proxy)
+{
+	assert(proxy >= 0 && proxy < int32_t(nodes.size()) && nodes[proxy].IsLeaf() && "Destroying an invalid proxy.");
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	proxyCount--;
+}
+
+bool DynamicAABBTree::MoveProxy(int32_t proxy, const AABB& box, const glm::vec2& displacement)
+{
+	assert(proxy >= 0 && proxy < int32_t(nodes.size()) && nodes[proxy].IsLeaf() && "Moving an invalid proxy.");
+
+	glm::vec2 fat = FatMargin(box);
+	AABB fatBox{ box.min - fat, box.max + fat };
+	// Stretch in the direction of motion so a body moving at constant speed stays inside its fat box for several steps
+	glm::vec2 d = displacement * displacementMultiplier;
+	if (d.x < 0.0f) fatBox.min.x += d.x; else fatBox.max.x += d.x;
+	if (d.y < 0.0f) fatBox.min.y += d.y; else fatBox.max.y += d.y;
+
+	const AABB& treeBox = nodes[proxy].box;
+	if (treeBox.Contains(box)) {
+		// Still inside, unless the fat box has become far too large (the body slowed down or stopped)
+		AABB hugeBox{ fatBox.min - 4.0f * fat, fatBox.max + 4.0f * fat };
+		if (hugeBox.Contains(treeBox)) return false;
+	}
+
+	RemoveLeaf(proxy);
+	nodes[proxy].box = fatBox;
+	InsertLeaf(proxy);
+	return true;
+}
+
+void DynamicAABBTree::InsertLeaf(int32_t leaf)
+{
+	if (root == NULL_NODE) {
+		root = leaf;
+		nodes[root].parentOrNext = NULL_NODE;
+		return;
+	}
+
+	// Descend towards the sibling with the lowest total perimeter cost, stopping when creating a new parent here is
+	// cheaper than pushing the leaf further down
+	AABB leafBox = nodes[leaf].box;
+	int32_t index = root;
+	while (!nodes[index].IsLeaf()) {
+		const Node& node = nodes[index];
+		float area = node.box.Perimeter();
+		float combinedArea = AABB::Union(node.box, leafBox).Perimeter();
+
+		float cost = 2.0f * combinedArea;
+		// Every ancestor grows by the same amount wherever the leaf ends up below this node
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		auto descendCost = [&](int32_t child) {
+			const Node& c = nodes[child];
+			float grown = AABB::Union(leafBox, c.box).Perimeter();
+			return c.IsLeaf() ? grown + inheritanceCost : (grown - c.box.Perimeter()) + inheritanceCost;
+		};
+		float cost1 = descendCost(node.child1);
+		float cost2 = descendCost(node.child2);
+
+		if (cost < cost1 && cost < cost2) break;
+		index = cost1 < cost2 ? node.child1 : node.child2;
+	}
+
+	int32_t sibling = index;
+	int32_t oldParent = nodes[sibling].parentOrNext;
+	int32_t newParent = AllocateNode();
+	nodes[newParent].parentOrNext = oldParent;
+	nodes[newParent].box = AABB::Union(leafBox, nodes[sibling].box);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parentOrNext = newParent;
+	nodes[leaf].parentOrNext = newParent;
+
+	if (oldParent == NULL_NODE) {
+		root = newParent;
+	}
+	else if (nodes[oldParent].child1 == sibling) {
+		nodes[oldParent].child1 = newParent;
+	}
+	else {
+		nodes[oldParent].child2 = newParent;
+	}
+
+	// Refit and rebalance the ancestors
+	index = nodes[leaf].parentOrNext;
+	while (index != NULL_NODE) {
+		index = Balance(index);
+		int32_t child1 = nodes[index].child1;
+		int32_t child2 = nodes[index].child2;
+		nodes[index].height = 1 + (std::max)(nodes[child1].height, nodes[child2].height);
+		nodes[index].box = AABB::Union(nodes[child1].box, nodes[child2].box);
+		index = nodes[index].parentOrNext;
+	}
+}
+
+void DynamicAABBTree::RemoveLeaf(int32_t leaf)
+{
+	if (leaf == root) {
+		root = NULL_NODE;
+		return;
+	}
+
+	int32_t parent = nodes[leaf].parentOrNext;
+	int32_t grandParent = nodes[parent].parentOrNext;
+	int32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	if (grandParent == NULL_NODE) {
+		root = sibling;
+		nodes[sibling].parentOrNext = NULL_NODE;
+		FreeNode(parent);
+		return;
+	}
+
+	// The sibling takes the parent's place
+	if (nodes[grandParent].child1 == parent) nodes[grandParent].child1 = sibling;
+	else nodes[grandParent].child2 = sibling;
+	nodes[sibling].parentOrNext = grandParent;
+	FreeNode(parent);
+
+	int32_t index = grandParent;
+	while (index != NULL_NODE) {
+		index = Balance(index);
+		int32_t child1 = nodes[index].child1;
+		int32_t child2 = nodes[index].child2;
+		nodes[index].box = AABB::Union(nodes[child1].box, nodes[child2].box);
+		nodes[index].height = 1 + (std::max)(nodes[child1].height, nodes[child2].height);
+		index = nodes[index].parentOrNext;
+	}
+}
+
+int32_t DynamicAABBTree::Balance(int32_t iA)
+{
+	Node& A = nodes[iA];
+	if (A.IsLeaf() || A.height < 2) return iA;
+
+	int32_t iB = A.child1;
+	int32_t iC = A.child2;
+	int32_t balance = nodes[iC].height - nodes[iB].height;
+
+	// Promotes the higher child of A (iUp) to A's place, A takes the child's lower grandchild
+	auto rotate = [&](int32_t iUp, int32_t iStay) {
+		Node& up = nodes[iUp];
+		int32_t iF = up.child1;
+		int32_t iG = up.child2;
+
+		up.child1 = iA;
+		up.parentOrNext = A.parentOrNext;
+		A.parentOrNext = iUp;
+
+		if (up.parentOrNext != NULL_NODE) {
+			if (nodes[up.parentOrNext].child1 == iA) nodes[up.parentOrNext].child1 = iUp;
+			else nodes[up.parentOrNext].child2 = iUp;
+		}
+		else {
+			root = iUp;
+		}
+
+		// Keep the taller grandchild under up, hand the other one to A in the slot up used to occupy
+		int32_t iHigh = nodes[iF].height > nodes[iG].height ? iF : iG;
+		int32_t iLow = iHigh == iF ? iG : iF;
+		up.child2 = iHigh;
+		if (A.child1 == iUp) A.child1 = iLow; else A.child2 = iLow;
+		nodes[iLow].parentOrNext = iA;
+
+		A.box = AABB::Union(nodes[iStay].box, nodes[iLow].box);
+		up.box = AABB::Union(A.box, nodes[iHigh].box);
+		A.height = 1 + (std::max)(nodes[iStay].height, nodes[iLow].height);
+		up.height = 1 + (std::max)(A.height, nodes[iHigh].height);
+		return iUp;
+	};
+
+	if (balance > 1) return rotate(iC, iB);
+	if (balance < -1) return rotate(iB, iC);
+	return iA;
+}
+
+void DynamicAABBTree::BuildPairTasks() const
+{
+	// Splits the top of the tree into independent tasks. Only depends on the tree, never on the thread count,
+	// so the serial and the parallel walk visit the same tasks in the same order
+	const size_t targetTasks = 64;
+	pairTasks.clear();
+	if (root == NULL_NODE) return;
+	pairTasks.push_back({ root, root });
+	for (size_t i = 0; i < pairTasks.size() && pairTasks.size() < targetTasks; ) {
+		PairTask task = pairTasks[i];
+		const Node& node = nodes[task.a];
+		if (task.a != task.b || node.IsLeaf()) {
+			i++;
+			continue;
+		}
+		pairTasks[i] = { node.child1, node.child1 };
+		pairTasks.insert(pairTasks.begin() + i + 1, { { node.child2, node.child2 }, { node.child1, node.child2 } });
+	}
+}
+
+void DynamicAABBTree::RunPairTasks(uint32_t begin, uint32_t end, std::vector<std::pair<Entity, Entity>>& pairs) const
+{
+	std::vector<PairTask> stack;
+	stack.reserve(256);
+	for (uint32_t t = begin; t < end; t++) {
+		stack.push_back(pairTasks[t]);
+		while (!stack.empty()) {
+			PairTask task = stack.back();
+			stack.pop_back();
+			const Node& a = nodes[task.a];
+
+			if (task.a == task.b) {
+				if (a.IsLeaf()) continue;
+				// Cross pair first so the pop order stays child1, child2, cross
+				stack.push_back({ a.child1, a.child2 });
+				stack.push_back({ a.child2, a.child2 });
+				stack.push_back({ a.child1, a.child1 });
+				continue;
+			}
+
+			const Node& b = nodes[task.b];
+			if (!a.box.Overlaps(b.box)) continue;
+			if (a.IsLeaf() && b.IsLeaf()) {
+				pairs.push_back(a.entity < b.entity ? std::make_pair(a.entity, b.entity) : std::make_pair(b.entity, a.entity));
+			}
+			else if (b.IsLeaf() || (!a.IsLeaf() && a.box.Perimeter() >= b.box.Perimeter())) {
+				// Descend into the larger box
+				stack.push_back({ a.child2, task.b });
+				stack.push_back({ a.child1, task.b });
+			}
+			else {
+				stack.push_back({ task.a, b.child2 });
+				stack.push_back({ task.a, b.child1 });
+			}
+		}
+	}
+}
+
+void DynamicAABBTree::FindPairs(std::vector<std::pair<Entity, Entity>>& pairs, bool parallel) const
+{
+	BuildPairTasks();
+	uint32_t taskCount = static_cast<uint32_t>(pairTasks.size());
+
+	ThreadPool& pool = ThreadPool::global();
+	// Small trees aren't worth waking the workers for
+	uint32_t ranges = parallel && proxyCount >= 1024 ? pool.rangeCount(taskCount, 1) : 1;
+	if (ranges <= 1) {
+		RunPairTasks(0, taskCount, pairs);
+		return;
+	}
+
+	rangePairs.resize(ranges);
+	pool.parallelFor(taskCount, 1, [&](uint32_t begin, uint32_t end, uint32_t range) {
+		rangePairs[range].clear();
+		RunPairTasks(begin, end, rangePairs[range]);
+	});
+	// Ranges are concatenated in task order, same result as the serial walk
+	for (uint32_t r = 0; r < ranges; r++) {
+		pairs.insert(pairs.end(), rangePairs[r].begin(), rangePairs[r].end());
+	}
+}
+
+int32_t DynamicAABBTree::ValidateNode(int32_t id) const
+{
+	const Node& node = nodes[id];
+	if (node.IsLeaf()) {
+		assert(node.height == 0);
+		return 0;
+	}
+	assert(nodes[node.child1].parentOrNext == id && nodes[node.child2].parentOrNext == id);
+	int32_t h1 = ValidateNode(node.child1);
+	int32_t h2 = ValidateNode(node.child2);
+	assert(node.height == 1 + (std::max)(h1, h2));
+	(void)h1; (void)h2;
+	assert(node.box.Contains(nodes[node.child1].box) && node.box.Contains(nodes[node.child2].box));
+	return node.height;
+}
+
+void DynamicAABBTree::Validate() const
+{
+	if (root == NULL_NODE) return;
+	assert(nodes[root].parentOrNext == NULL_NODE);
+	ValidateNode(root);
+}
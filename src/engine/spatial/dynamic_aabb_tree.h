@@ -0,0 +1,160 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <glm/glm.hpp>
+
+#include "aabb.h"
+#include "../ecs/entity_component_system.h"
+
+// Incremental bounding volume hierarchy over moving boxes (proxies).
+// Leaves store a fattened box so small movements don't touch the tree, inserts pick the sibling with the cheapest
+// perimeter increase and rotations keep the tree balanced. Nodes live in one vector and refer to each other by index,
+// freed nodes are chained into a free list and reused.
+class DynamicAABBTree {
+public:
+	static constexpr int32_t NULL_NODE = -1;
+
+	// margin is added on every side of a leaf, but at most a quarter of the box size so dense piles of small boxes
+	// don't pair with more than their direct neighbours.
+	// Leaves are additionally stretched by displacement * displacementMultiplier
+	explicit DynamicAABBTree(float margin = 0.1f, float displacementMultiplier = 2.0f);
+
+	int32_t CreateProxy(const AABB& box, Entity entity);
+	void DestroyProxy(int32_t proxy);
+	// Returns true if the proxy was reinserted because box left its fat box
+	bool MoveProxy(int32_t proxy, const AABB& box, const glm::vec2& displacement);
+
+	const AABB& GetFatAABB(int32_t proxy) const { return nodes[proxy].box; }
+	Entity GetEntity(int32_t proxy) const { return nodes[proxy].entity; }
+	uint32_t ProxyCount() const { return proxyCount; }
+	int32_t Height() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+
+	// Calls callback(proxy) for every proxy whose fat box overlaps box. Returning false from callback stops the query
+	template<typename F>
+	void QueryAABB(const AABB& box, F&& callback) const
+	{
+		NodeStack stack;
+		stack.Push(root);
+		while (!stack.Empty()) {
+			int32_t id = stack.Pop();
+			if (id == NULL_NODE) continue;
+			const Node& node = nodes[id];
+			if (!node.box.Overlaps(box)) continue;
+			if (node.IsLeaf()) {
+				if (!callback(id)) return;
+			}
+			else {
+				stack.Push(node.child1);
+				stack.Push(node.child2);
+			}
+		}
+	}
+
+	// Walks the segment from -> to. callback(proxy, fraction of the fat box entry) returns the new maximum fraction:
+	// 0 stops, the given fraction clips the ray to this hit, a value above it keeps going without clipping
+	template<typename F>
+	void RayCast(const glm::vec2& from, const glm::vec2& to, F&& callback) const
+	{
+		glm::vec2 delta = to - from;
+		float maxFraction = 1.0f;
+		NodeStack stack;
+		stack.Push(root);
+		while (!stack.Empty()) {
+			int32_t id = stack.Pop();
+			if (id == NULL_NODE) continue;
+			const Node& node = nodes[id];
+			float t;
+			if (!node.box.RayCast(from, delta, maxFraction, t)) continue;
+			if (node.IsLeaf()) {
+				float value = callback(id, t);
+				if (value == 0.0f) return;
+				if (value < maxFraction) maxFraction = value;
+			}
+			else {
+				stack.Push(node.child1);
+				stack.Push(node.child2);
+			}
+		}
+	}
+
+	// Every pair of proxies whose fat boxes overlap, once each. The narrowphase has to confirm them.
+	// The parallel mode splits the leaves over ThreadPool::global(), the result is identical to the serial one
+	void FindPairs(std::vector<std::pair<Entity, Entity>>& pairs, bool parallel = false) const;
+
+	// Debug check of parent links, heights and boxes
+	void Validate() const;
+
+private:
+	struct Node {
+		AABB box;
+		// parent while allocated, next free node while in the free list
+		int32_t parentOrNext = NULL_NODE;
+		int32_t child1 = NULL_NODE;
+		int32_t child2 = NULL_NODE;
+		// 0 for leaves, -1 for free nodes
+		int32_t height = -1;
+		Entity entity = 0;
+
+		bool IsLeaf() const { return child1 == NULL_NODE; }
+	};
+
+	// Traversal stack that only touches the heap for very deep trees
+	class NodeStack {
+	public:
+		void Push(int32_t id)
+		{
+			if (count < INLINE) inlineNodes[count] = id;
+			else spill.push_back(id);
+			count++;
+		}
+		int32_t Pop()
+		{
+			count--;
+			if (count < INLINE) return inlineNodes[count];
+			int32_t id = spill.back();
+			spill.pop_back();
+			return id;
+		}
+		bool Empty() const { return count == 0; }
+	private:
+		static constexpr uint32_t INLINE = 128;
+		int32_t inlineNodes[INLINE];
+		uint32_t count = 0;
+		std::vector<int32_t> spill;
+	};
+
+	glm::vec2 FatMargin(const AABB& box) const
+	{
+		glm::vec2 h = box.HalfExtents();
+		float m = (std::min)(margin, 0.5f * (std::max)(h.x, h.y));
+		return { m, m };
+	}
+
+	int32_t AllocateNode();
+	void FreeNode(int32_t id);
+	void InsertLeaf(int32_t leaf);
+	void RemoveLeaf(int32_t leaf);
+	// Rotates the subtree at a if it is imbalanced, returns the new subtree root
+	int32_t Balance(int32_t a);
+	// Pair finding descends the tree against itself. A task is a node pair, equal ids meaning the pairs inside one subtree
+	struct PairTask {
+		int32_t a;
+		int32_t b;
+	};
+	void BuildPairTasks() const;
+	void RunPairTasks(uint32_t begin, uint32_t end, std::vector<std::pair<Entity, Entity>>& pairs) const;
+	int32_t ValidateNode(int32_t id) const;
+
+	float margin;
+	float displacementMultiplier;
+
+	std::vector<Node> nodes;
+	int32_t root = NULL_NODE;
+	int32_t freeList = NULL_NODE;
+	uint32_t proxyCount = 0;
+
+	// Scratch for FindPairs
+	mutable std::vector<PairTask> pairTasks;
+	mutable std::vector<std::vector<std::pair<Entity, Entity>>> rangePairs;
+};
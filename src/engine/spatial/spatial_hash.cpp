@@ -0,0 +1,202 @@
+#include "spatial_hash.h"
+#include "../ecs/entity_components.h"
+#include "../thread_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+SpatialHash::SpatialHash(float cellSize) : cellSize(cellSize), invCellSize(1.0f / cellSize)
+{
+	assert(cellSize > 0.0f && "Spatial hash cell size must be positive.");
+	cellStart.assign(2, 0);
+}
+
+void SpatialHash::Build(const glm::vec2* positions, const Entity* entities, uint32_t count)
+{
+	// About one bucket per point keeps buckets short without making the histograms huge
+	uint32_t bucketCount = 64;
+	while (bucketCount < count) bucketCount <<= 1;
+	bucketMask = bucketCount - 1;
+
+	sortedEntities.resize(count);
+	sortedPositions.resize(count);
+	pointBuckets.resize(count);
+	cellStart.resize(bucketCount + 1);
+
+	ThreadPool& pool = ThreadPool::global();
+	uint32_t ranges = count >= PARALLEL_MIN_POINTS ? pool.rangeCount(count, PARALLEL_MIN_POINTS / 2) : 1;
+	auto forPoints = [&](const std::function<void(uint32_t, uint32_t, uint32_t)>& func) {
+		if (ranges > 1) pool.parallelFor(count, PARALLEL_MIN_POINTS / 2, func);
+		else func(0, count, 0);
+	};
+
+	// One histogram per range so the ranges can count and later scatter without synchronizing
+	histograms.assign(size_t(ranges) * bucketCount, 0);
+	std::vector<int32_t> rangeBounds(size_t(ranges) * 4);
+
+	forPoints([&](uint32_t begin, uint32_t end, uint32_t range) {
+		uint32_t* histogram = histograms.data() + size_t(range) * bucketCount;
+		int32_t* bounds = rangeBounds.data() + size_t(range) * 4;
+		bounds[0] = bounds[1] = INT32_MAX;
+		bounds[2] = bounds[3] = INT32_MIN;
+		for (uint32_t i = begin; i < end; i++) {
+			int32_t cx = CellOf(positions[i].x);
+			int32_t cy = CellOf(positions[i].y);
+			uint32_t b = BucketOf(cx, cy);
+			pointBuckets[i] = b;
+			histogram[b]++;
+			bounds[0] = (std::min)(bounds[0], cx); bounds[1] = (std::min)(bounds[1], cy);
+			bounds[2] = (std::max)(bounds[2], cx); bounds[3] = (std::max)(bounds[3], cy);
+		}
+	});
+
+	minCell[0] = minCell[1] = INT32_MAX;
+	maxCell[0] = maxCell[1] = INT32_MIN;
+	for (uint32_t r = 0; r < ranges; r++) {
+		const int32_t* bounds = rangeBounds.data() + size_t(r) * 4;
+		minCell[0] = (std::min)(minCell[0], bounds[0]); minCell[1] = (std::min)(minCell[1], bounds[1]);
+		maxCell[0] = (std::max)(maxCell[0], bounds[2]); maxCell[1] = (std::max)(maxCell[1], bounds[3]);
+	}
+
+	// Exclusive prefix sum over (bucket, range) pairs, bucket major, turning every histogram entry into the scatter
+	// offset of that range's first point in that bucket. Split over bucket slices: sum each slice, scan the slice
+	// totals, then let every slice write its offsets starting from its total
+	uint32_t bucketRanges = ranges > 1 ? pool.rangeCount(bucketCount, bucketCount / ranges) : 1;
+	rangeTotals.assign(bucketRanges + 1, 0);
+	auto forBuckets = [&](const std::function<void(uint32_t, uint32_t, uint32_t)>& func) {
+		if (bucketRanges > 1) pool.parallelFor(bucketCount, bucketCount / ranges, func);
+		else func(0, bucketCount, 0);
+	};
+
+	forBuckets([&](uint32_t begin, uint32_t end, uint32_t slice) {
+		uint32_t total = 0;
+		for (uint32_t b = begin; b < end; b++) {
+			for (uint32_t r = 0; r < ranges; r++) total += histograms[size_t(r) * bucketCount + b];
+		}
+		rangeTotals[slice + 1] = total;
+	});
+	for (uint32_t s = 1; s <= bucketRanges; s++) rangeTotals[s] += rangeTotals[s - 1];
+
+	forBuckets([&](uint32_t begin, uint32_t end, uint32_t slice) {
+		uint32_t running = rangeTotals[slice];
+		for (uint32_t b = begin; b < end; b++) {
+			cellStart[b] = running;
+			for (uint32_t r = 0; r < ranges; r++) {
+				uint32_t& entry = histograms[size_t(r) * bucketCount + b];
+				uint32_t n = entry;
+				entry = running;
+				running += n;
+			}
+		}
+	});
+	cellStart[bucketCount] = count;
+
+	// Stable scatter, every range owns its own offsets
+	forPoints([&](uint32_t begin, uint32_t end, uint32_t range) {
+		uint32_t* offsets = histograms.data() + size_t(range) * bucketCount;
+		for (uint32_t i = begin; i < end; i++) {
+			uint32_t dst = offsets[pointBuckets[i]]++;
+			sortedEntities[dst] = entities[i];
+			sortedPositions[dst] = positions[i];
+		}
+	});
+}
+
+void SpatialHash::QueryAABB(const glm::vec2& min, const glm::vec2& max, std::vector<Entity>& out) const
+{
+	ForEachInAABB(min, max, [&out](Entity e, const glm::vec2&) { out.push_back(e); });
+}
+
+void SpatialHash::QueryRadius(const glm::vec2& center, float radius, std::vector<Entity>& out) const
+{
+	float r2 = radius * radius;
+	ForEachInCells(CellOf(center.x - radius), CellOf(center.y - radius), CellOf(center.x + radius), CellOf(center.y + radius), [&](uint32_t i) {
+		glm::vec2 d = sortedPositions[i] - center;
+		if (d.x * d.x + d.y * d.y <= r2) out.push_back(sortedEntities[i]);
+	});
+}
+
+void SpatialHash::QueryNearestK(const glm::vec2& point, uint32_t k, std::vector<Entity>& out) const
+{
+	k = (std::min)(k, Size());
+	if (k == 0) return;
+
+	// Max heap on distance holding the best k so far
+	std::vector<std::pair<float, Entity>> best;
+	best.reserve(k);
+	auto consider = [&](uint32_t i) {
+		glm::vec2 d = sortedPositions[i] - point;
+		float d2 = d.x * d.x + d.y * d.y;
+		if (best.size() < k) {
+			best.push_back({ d2, sortedEntities[i] });
+			std::push_heap(best.begin(), best.end());
+		}
+		else if (d2 < best.front().first) {
+			std::pop_heap(best.begin(), best.end());
+			best.back() = { d2, sortedEntities[i] };
+			std::push_heap(best.begin(), best.end());
+		}
+	};
+
+	// Walk square rings of cells outwards. Every point outside ring r is at least r cells away from the query point
+	int64_t cx = CellOf(point.x);
+	int64_t cy = CellOf(point.y);
+	int64_t maxRing = (std::max)((std::max)(cx - minCell[0], maxCell[0] - cx), (std::max)(cy - minCell[1], maxCell[1] - cy));
+	// Sparse worlds can make the rings visit far more empty cells than there are points, scan everything instead
+	uint64_t cellBudget = uint64_t(Size()) * 4 + 64;
+	uint64_t cellsVisited = 0;
+
+	for (int64_t ring = 0; ring <= maxRing; ring++) {
+		int64_t y0 = (std::max)(cy - ring, int64_t(minCell[1]));
+		int64_t y1 = (std::min)(cy + ring, int64_t(maxCell[1]));
+		int64_t x0 = (std::max)(cx - ring, int64_t(minCell[0]));
+		int64_t x1 = (std::min)(cx + ring, int64_t(maxCell[0]));
+		for (int64_t y = y0; y <= y1; y++) {
+			if (y == cy - ring || y == cy + ring) {
+				for (int64_t x = x0; x <= x1; x++) VisitCell(int32_t(x), int32_t(y), consider);
+				cellsVisited += x1 >= x0 ? uint64_t(x1 - x0 + 1) : 0;
+			}
+			else {
+				if (cx - ring >= minCell[0]) { VisitCell(int32_t(cx - ring), int32_t(y), consider); cellsVisited++; }
+				if (cx + ring <= maxCell[0]) { VisitCell(int32_t(cx + ring), int32_t(y), consider); cellsVisited++; }
+			}
+		}
+
+		float covered = float(ring) * cellSize;
+		if (best.size() == k && best.front().first <= covered * covered) break;
+		if (cellsVisited > cellBudget) {
+			best.clear();
+			for (uint32_t i = 0; i < Size(); i++) consider(i);
+			break;
+		}
+	}
+
+	std::sort_heap(best.begin(), best.end());
+	for (auto& b : best) out.push_back(b.second);
+}
+
+SpatialHashSystem::SpatialHashSystem(ECS::Coordinator* c, float cellSize) : coordinator(*c), hash(cellSize) {}
+
+void SpatialHashSystem::Update(float dt)
+{
+	// mEntities only changes through the coordinator, so comparing the sorted entity list and the gathered positions
+	// against the last build is enough to tell whether anything moved
+	bool changed = !built || entities.size() != mEntities.size();
+	if (!changed) {
+		uint32_t i = 0;
+		for (Entity e : mEntities) {
+			if (entities[i++] != e) { changed = true; break; }
+		}
+	}
+	if (changed) entities.assign(mEntities.begin(), mEntities.end());
+
+	gathered.resize(entities.size());
+	for (size_t i = 0; i < entities.size(); i++) {
+		gathered[i] = coordinator.GetComponent<TransformComponent>(entities[i]).getWorldTranslation();
+	}
+	if (!changed && gathered == positions) return;
+
+	std::swap(positions, gathered);
+	hash.Build(positions.data(), entities.data(), static_cast<uint32_t>(entities.size()));
+	built = true;
+}
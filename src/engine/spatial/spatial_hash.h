@@ -0,0 +1,133 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "../ecs/entity_component_system.h"
+
+// Uniform grid over 2D points. Cells are hashed into a power of two bucket table and the points are counting sorted by
+// bucket, so every bucket is one contiguous range of sortedEntities/sortedPositions. Several cells can share a bucket,
+// queries only accept points whose own cell is the visited cell, which also keeps results free of duplicates.
+class SpatialHash {
+public:
+	explicit SpatialHash(float cellSize);
+
+	// Rebuilds from scratch. positions[i] belongs to entities[i]. Large inputs are sorted on ThreadPool::global()
+	void Build(const glm::vec2* positions, const Entity* entities, uint32_t count);
+
+	uint32_t Size() const { return static_cast<uint32_t>(sortedEntities.size()); }
+	float CellSize() const { return cellSize; }
+
+	// Queries append to out. Points on the boundary are included
+	void QueryAABB(const glm::vec2& min, const glm::vec2& max, std::vector<Entity>& out) const;
+	void QueryRadius(const glm::vec2& center, float radius, std::vector<Entity>& out) const;
+	// Up to k entities, nearest first
+	void QueryNearestK(const glm::vec2& point, uint32_t k, std::vector<Entity>& out) const;
+
+	// Calls func(entity, position) for every point inside [min, max]
+	template<typename F>
+	void ForEachInAABB(const glm::vec2& min, const glm::vec2& max, F&& func) const
+	{
+		ForEachInCells(CellOf(min.x), CellOf(min.y), CellOf(max.x), CellOf(max.y), [&](uint32_t i) {
+			const glm::vec2& p = sortedPositions[i];
+			if (p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y) {
+				func(sortedEntities[i], p);
+			}
+		});
+	}
+
+private:
+	// Inputs below this many points are sorted on the calling thread
+	static constexpr uint32_t PARALLEL_MIN_POINTS = 8192;
+
+	int32_t CellOf(float v) const
+	{
+		// Clamped so far away or non finite points can't overflow the cell coordinates
+		float c = std::floor(v * invCellSize);
+		if (!(c > -1073741824.0f)) return -1073741824;
+		if (c > 1073741824.0f) return 1073741824;
+		return static_cast<int32_t>(c);
+	}
+
+	uint32_t BucketOf(int32_t cx, int32_t cy) const
+	{
+		uint32_t h = static_cast<uint32_t>(cx) * 0x9E3779B1u ^ static_cast<uint32_t>(cy) * 0x85EBCA77u;
+		h ^= h >> 15;
+		return h & bucketMask;
+	}
+
+	// Calls visit(index into the sorted arrays) for every point whose cell lies in [x0, x1] x [y0, y1].
+	// Falls back to visiting every point when the range covers more cells than there are points, callers have to filter
+	template<typename F>
+	void ForEachInCells(int32_t x0, int32_t y0, int32_t x1, int32_t y1, F&& visit) const
+	{
+		if (sortedEntities.empty()) return;
+		x0 = (std::max)(x0, minCell[0]); y0 = (std::max)(y0, minCell[1]);
+		x1 = (std::min)(x1, maxCell[0]); y1 = (std::min)(y1, maxCell[1]);
+		if (x0 > x1 || y0 > y1) return;
+
+		uint64_t cells = uint64_t(int64_t(x1) - x0 + 1) * uint64_t(int64_t(y1) - y0 + 1);
+		if (cells >= sortedEntities.size()) {
+			for (uint32_t i = 0; i < Size(); i++) visit(i);
+			return;
+		}
+		for (int32_t cy = y0; cy <= y1; cy++) {
+			for (int32_t cx = x0; cx <= x1; cx++) {
+				VisitCell(cx, cy, visit);
+			}
+		}
+	}
+
+	template<typename F>
+	void VisitCell(int32_t cx, int32_t cy, F&& visit) const
+	{
+		uint32_t b = BucketOf(cx, cy);
+		for (uint32_t i = cellStart[b]; i < cellStart[b + 1]; i++) {
+			const glm::vec2& p = sortedPositions[i];
+			if (CellOf(p.x) == cx && CellOf(p.y) == cy) visit(i);
+		}
+	}
+
+	float cellSize;
+	float invCellSize;
+
+	uint32_t bucketMask = 0;
+	// bucketCount + 1 offsets into the sorted arrays
+	std::vector<uint32_t> cellStart;
+	std::vector<Entity> sortedEntities;
+	std::vector<glm::vec2> sortedPositions;
+	// Cell bounds of all points, queries are clipped to these
+	int32_t minCell[2] = { 0, 0 };
+	int32_t maxCell[2] = { -1, -1 };
+
+	// Build scratch, kept to avoid reallocating every rebuild
+	std::vector<uint32_t> pointBuckets;
+	std::vector<uint32_t> histograms;
+	std::vector<uint32_t> rangeTotals;
+};
+
+// Keeps a SpatialHash of the world translation of every entity matching its signature (TransformComponent at least).
+// The hash is only rebuilt when an entity moved, was added or was removed since the last Update
+class SpatialHashSystem : public ECS::EntitySystem {
+public:
+	SpatialHashSystem(ECS::Coordinator* c, float cellSize);
+
+	void Update(float dt) override;
+
+	const SpatialHash& Hash() const { return hash; }
+
+	void QueryAABB(const glm::vec2& min, const glm::vec2& max, std::vector<Entity>& out) const { hash.QueryAABB(min, max, out); }
+	void QueryRadius(const glm::vec2& center, float radius, std::vector<Entity>& out) const { hash.QueryRadius(center, radius, out); }
+	void QueryNearestK(const glm::vec2& point, uint32_t k, std::vector<Entity>& out) const { hash.QueryNearestK(point, k, out); }
+
+private:
+	ECS::Coordinator& coordinator;
+	SpatialHash hash;
+
+	// Inputs of the last Build, compared against to skip rebuilding a static world
+	std::vector<Entity> entities;
+	std::vector<glm::vec2> positions;
+	std::vector<glm::vec2> gathered;
+	bool built = false;
+};
@@ -0,0 +1,91 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t workerCount) {
+	if (workerCount == 0) {
+		uint32_t hardware = std::thread::hardware_concurrency();
+		workerCount = hardware > 1 ? hardware - 1 : 1;
+	}
+	workers.reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; i++) {
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	cv.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+ThreadPool& ThreadPool::global() {
+	static ThreadPool pool;
+	return pool;
+}
+
+ThreadPool& ThreadPool::io() {
+	static ThreadPool pool(1);
+	return pool;
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+	std::packaged_task<void()> packaged(std::move(task));
+	std::future<void> future = packaged.get_future();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push(std::move(packaged));
+	}
+	cv.notify_one();
+	return future;
+}
+
+uint32_t ThreadPool::rangeCount(uint32_t count, uint32_t minRangeSize) const {
+	if (count == 0) return 0;
+	minRangeSize = (std::max)(minRangeSize, 1u);
+	uint32_t ranges = (count + minRangeSize - 1) / minRangeSize;
+	return (std::min)(ranges, size());
+}
+
+void ThreadPool::parallelFor(uint32_t count, uint32_t minRangeSize, const std::function<void(uint32_t, uint32_t, uint32_t)>& func) {
+	uint32_t ranges = rangeCount(count, minRangeSize);
+	if (ranges == 0) return;
+
+	auto rangeBegin = [count, ranges](uint32_t r) {
+		return static_cast<uint32_t>(static_cast<uint64_t>(count) * r / ranges);
+	};
+
+	std::vector<std::future<void>> pending;
+	pending.reserve(ranges - 1);
+	for (uint32_t r = 1; r < ranges; r++) {
+		pending.push_back(submit([&func, &rangeBegin, r]() { func(rangeBegin(r), rangeBegin(r + 1), r); }));
+	}
+	// Every range has to finish before func and rangeBegin go out of scope, even when one of them throws
+	try {
+		func(0, rangeBegin(1), 0);
+	}
+	catch (...) {
+		for (std::future<void>& f : pending) f.wait();
+		throw;
+	}
+	for (std::future<void>& f : pending) f.wait();
+	for (std::future<void>& f : pending) f.get();
+}
+
+void ThreadPool::workerLoop() {
+	while (true) {
+		std::packaged_task<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty()) return;
+			task = std::move(tasks.front());
+			tasks.pop();
+		}
+		task();
+	}
+}
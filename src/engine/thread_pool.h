@@ -0,0 +1,46 @@
+#pragma once
+#include <queue>
+#include <mutex>
+#include <future>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+// Fixed set of worker threads shared by the engine so parallel passes don't pay for spawning threads every frame.
+// Tasks must not block on other tasks of the same pool (no nested parallelFor), every worker could end up waiting.
+class ThreadPool {
+public:
+	// 0 picks one worker per hardware thread, minus the calling thread
+	explicit ThreadPool(uint32_t workerCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	static ThreadPool& global();
+	// One worker for blocking file I/O, so parallelFor on the global pool never waits behind a disk write.
+	// Tasks run one at a time in submission order
+	static ThreadPool& io();
+
+	// Workers plus the calling thread
+	uint32_t size() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+	std::future<void> submit(std::function<void()> task);
+
+	// Number of ranges parallelFor splits count into, so callers can size per-range scratch buffers up front
+	uint32_t rangeCount(uint32_t count, uint32_t minRangeSize) const;
+	// Splits [0, count) into rangeCount() contiguous ranges, range r being [r * count / ranges, (r + 1) * count / ranges).
+	// The calling thread runs range 0 and blocks until all ranges are done
+	void parallelFor(uint32_t count, uint32_t minRangeSize, const std::function<void(uint32_t begin, uint32_t end, uint32_t range)>& func);
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread> workers;
+	std::queue<std::packaged_task<void()>> tasks;
+	bool stopping = false;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+};
@@ -2,6 +2,7 @@
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include <atomic>
 
 class Window {
 public:
@@ -19,7 +20,8 @@ public:
     bool shouldClose() { return glfwWindowShouldClose(window); }
 private:
     static void frameBufferResizedCallback(GLFWwindow* window, int width, int height);
-    bool frameBufferResized = false;
-    int width;
-    int height;
+    // Written by the resize callback on the main thread, read by the render thread
+    std::atomic<bool> frameBufferResized{ false };
+    std::atomic<int> width;
+    std::atomic<int> height;
 };
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "inputRecording.h"
+
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+namespace {
+	// Bytes of the frames and hashes of frameCount frames
+	uint64_t recordedSize(uint32_t frameCount, uint32_t hashInterval)
+	{
+		uint64_t hashCount = hashInterval > 0 ? frameCount / hashInterval : 0;
+		return uint64_t(frameCount) * INPUT_FRAME_SIZE + hashCount * sizeof(uint32_t);
+	}
+}
+
+bool InputRecorder::open(const char* path, uint32_t seed, const InputRecordingScene& scene, uint32_t interval)
+{
+	stream.open(path, std::ios::binary | std::ios::trunc);
+	if (!stream.is_open()) {
+		std::cerr << "Failed to create " << path << "\n";
+		return false;
+	}
+	InputRecordingHeader header{};
+	std::memcpy(header.magic, INPUT_RECORDING_MAGIC, sizeof(INPUT_RECORDING_MAGIC));
+	header.version = INPUT_RECORDING_VERSION;
+	header.seed = seed;
+	header.hashInterval = interval;
+	header.scene = scene;
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	hashInterval = interval;
+	frameCount = 0;
+	return stream.good();
+}
+
+void InputRecorder::record(const InputFrame& frame, ECS::Coordinator& world)
+{
+	char bytes[INPUT_FRAME_SIZE];
+	bytes[0] = static_cast<char>(frame.actions);
+	bytes[1] = static_cast<char>(frame.pressedActions);
+	std::memcpy(bytes + 2, &frame.frameTime, sizeof(float));
+	stream.write(bytes, sizeof(bytes));
+	frameCount++;
+	if (hashInterval > 0 && frameCount % hashInterval == 0) {
+		uint32_t hash = world.StateHash();
+		stream.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+	}
+}
+
+void InputRecorder::close(ECS::Coordinator& world)
+{
+	InputRecordingFooter footer{};
+	std::memcpy(footer.magic, INPUT_RECORDING_END, sizeof(INPUT_RECORDING_END));
+	footer.frameCount = frameCount;
+	footer.stateHash = world.StateHash();
+	stream.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+	stream.close();
+	if (stream.fail()) std::cerr << "Failed to write the input recording\n";
+}
+
+bool InputReplay::open(const char* path)
+{
+	std::ifstream stream(path, std::ios::binary);
+	std::vector<char> data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	if (data.size() < sizeof(InputRecordingHeader)) {
+		std::cerr << "Failed to load " << path << "\n";
+		return false;
+	}
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (std::memcmp(header.magic, INPUT_RECORDING_MAGIC, sizeof(INPUT_RECORDING_MAGIC)) != 0 || header.version != INPUT_RECORDING_VERSION) {
+		std::cerr << path << " is not an input recording of this version\n";
+		return false;
+	}
+
+	// The footer is only trusted when its frame count accounts for every byte in between
+	const char* body = data.data() + sizeof(InputRecordingHeader);
+	uint64_t bodySize = data.size() - sizeof(InputRecordingHeader);
+	if (bodySize >= sizeof(InputRecordingFooter)) {
+		std::memcpy(&footer, body + bodySize - sizeof(InputRecordingFooter), sizeof(footer));
+		hasFooter = std::memcmp(footer.magic, INPUT_RECORDING_END, sizeof(INPUT_RECORDING_END)) == 0 &&
+			recordedSize(footer.frameCount, header.hashInterval) == bodySize - sizeof(InputRecordingFooter);
+		if (hasFooter) bodySize -= sizeof(InputRecordingFooter);
+	}
+	if (!hasFooter) std::cout << path << " was cut short, replaying the complete frames without a final check\n";
+
+	frames.clear();
+	hashes.clear();
+	uint64_t offset = 0;
+	while (bodySize - offset >= INPUT_FRAME_SIZE) {
+		InputFrame frame;
+		frame.actions = static_cast<uint8_t>(body[offset]);
+		frame.pressedActions = static_cast<uint8_t>(body[offset + 1]);
+		std::memcpy(&frame.frameTime, body + offset + 2, sizeof(float));
+		offset += INPUT_FRAME_SIZE;
+		if (header.hashInterval > 0 && (frames.size() + 1) % header.hashInterval == 0) {
+			// A frame whose hash was not written yet is dropped, it may not have finished
+			if (bodySize - offset < sizeof(uint32_t)) break;
+			uint32_t hash;
+			std::memcpy(&hash, body + offset, sizeof(hash));
+			hashes.push_back(hash);
+			offset += sizeof(uint32_t);
+		}
+		frames.push_back(frame);
+	}
+	position = 0;
+	mismatch = 0;
+	checked = 0;
+	return true;
+}
+
+bool InputReplay::next(InputFrame& frame)
+{
+	if (position == frames.size()) return false;
+	frame = frames[position++];
+	return true;
+}
+
+bool InputReplay::check(ECS::Coordinator& world)
+{
+	if (mismatch != 0) return false;
+	if (header.hashInterval == 0 || position % header.hashInterval != 0) return true;
+	checked++;
+	if (world.StateHash() != hashes[position / header.hashInterval - 1]) mismatch = position;
+	return mismatch == 0;
+}
+
+bool InputReplay::finish(ECS::Coordinator& world)
+{
+	if (!hasFooter || mismatch != 0) return mismatch == 0;
+	checked++;
+	if (world.StateHash() != footer.stateHash) mismatch = position;
+	return mismatch == 0;
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include "engine/ecs/entity_component_system.h"
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// Everything the simulation reads from the player, one bit per action. Filled by KeyboardMovementController::poll
+enum class InputAction : uint8_t {
+	MoveLeft,
+	MoveRight,
+	MoveUp,
+	MoveDown,
+	RemoveSprite,
+	Save,
+	Load,
+	Count
+};
+
+static_assert(static_cast<uint32_t>(InputAction::Count) <= 8, "InputFrame::actions holds 8 actions");
+
+// Input of one frame together with the measured frame time, which decides how many simulation steps the frame runs
+struct InputFrame {
+	float frameTime = 0.0f;
+	// Held this frame
+	uint8_t actions = 0;
+	// Held this frame but not the one before, for actions that happen once per key press
+	uint8_t pressedActions = 0;
+
+	bool down(InputAction action) const { return (actions >> static_cast<uint32_t>(action)) & 1; }
+	bool pressed(InputAction action) const { return (pressedActions >> static_cast<uint32_t>(action)) & 1; }
+	void set(InputAction action, bool held)
+	{
+		if (held) actions |= uint8_t(1u << static_cast<uint32_t>(action));
+		else actions &= uint8_t(~(1u << static_cast<uint32_t>(action)));
+	}
+};
+
+// Layout of an input recording. Integers and floats are little endian.
+//
+//   InputRecordingHeader
+//   frames, each the actions byte, the pressed actions byte and the frame time as a float. After every hashInterval frames
+//   comes the Coordinator::StateHash of the world at the end of that frame
+//   InputRecordingFooter, missing when the recording was cut short
+//
+// Replaying the frames on the same scene built with the same seed has to reproduce every hash
+constexpr char INPUT_RECORDING_MAGIC[4] = { 'F', 'B', 'I', 'R' };
+constexpr char INPUT_RECORDING_END[4] = { 'F', 'B', 'I', 'E' };
+constexpr uint32_t INPUT_RECORDING_VERSION = 3;
+constexpr uint32_t INPUT_FRAME_SIZE = 6;
+
+// InputRecordingScene::flags
+constexpr uint32_t INPUT_SCENE_GPU_PARTICLES = 1u << 0;
+constexpr uint32_t INPUT_SCENE_RECOVERED = 1u << 1;
+
+// Options the scene was built with. A replay is refused when its own scene differs
+struct InputRecordingScene {
+	uint32_t physicsBodies;
+	uint32_t particles;
+	uint32_t flags;
+	// StateHash of the world before the first frame, catches what the options don't, e.g. a different recovered autosave
+	uint32_t stateHash;
+
+	bool operator==(const InputRecordingScene& other) const
+	{
+		return physicsBodies == other.physicsBodies && particles == other.particles && flags == other.flags && stateHash == other.stateHash;
+	}
+	bool operator!=(const InputRecordingScene& other) const { return !(*this == other); }
+};
+
+struct InputRecordingHeader {
+	char magic[4];
+	uint32_t version;
+	// Seed of std::srand for the scene setup
+	uint32_t seed;
+	uint32_t hashInterval;
+	InputRecordingScene scene;
+};
+
+struct InputRecordingFooter {
+	char magic[4];
+	uint32_t frameCount;
+	// StateHash after the last frame
+	uint32_t stateHash;
+};
+
+static_assert(sizeof(InputRecordingHeader) == 32, "InputRecordingHeader layout changed, bump INPUT_RECORDING_VERSION");
+static_assert(sizeof(InputRecordingFooter) == 12, "InputRecordingFooter layout changed, bump INPUT_RECORDING_VERSION");
+
+// Appends frames to a recording as they are played
+class InputRecorder {
+public:
+	bool open(const char* path, uint32_t seed, const InputRecordingScene& scene, uint32_t hashInterval = 60);
+	bool isOpen() const { return stream.is_open(); }
+
+	// Call once per frame after the frame was simulated, world is hashed every hashInterval frames
+	void record(const InputFrame& frame, ECS::Coordinator& world);
+	// Writes the footer with the hash of the final world and closes the file
+	void close(ECS::Coordinator& world);
+
+private:
+	std::ofstream stream;
+	uint32_t hashInterval = 0;
+	uint32_t frameCount = 0;
+};
+
+// Feeds a recording back frame by frame and compares the hashes of the replayed world with the recorded ones
+class InputReplay {
+public:
+	// Reads the whole recording, false when it is missing or malformed
+	bool open(const char* path);
+
+	uint32_t seed() const { return header.seed; }
+	const InputRecordingScene& scene() const { return header.scene; }
+	uint32_t frameCount() const { return static_cast<uint32_t>(frames.size()); }
+
+	// Next recorded frame, false after the last one
+	bool next(InputFrame& frame);
+	// Call after the frame returned by next was simulated. Returns false once the world no longer matches the
+	// recording, firstMismatch() then tells the frame where it diverged
+	bool check(ECS::Coordinator& world);
+	// Compares the final world with the footer, true when the recording has no footer
+	bool finish(ECS::Coordinator& world);
+
+	// 1 based frame number of the first hash that did not match, 0 while everything matched
+	uint32_t firstMismatch() const { return mismatch; }
+	// Recorded hashes that were compared so far
+	uint32_t checkedHashes() const { return checked; }
+
+private:
+	InputRecordingHeader header{};
+	std::vector<InputFrame> frames;
+	// hashes[i] belongs to frame (i + 1) * hashInterval
+	std::vector<uint32_t> hashes;
+	bool hasFooter = false;
+	InputRecordingFooter footer{};
+	uint32_t position = 0;
+	uint32_t mismatch = 0;
+	uint32_t checked = 0;
+};
@@ -3,15 +3,31 @@
 
 #define ECSCoordiantor ECS::Coordinator::GetCoordinator()
 
-bool KeyboardMovementController::move(GLFWwindow* window, float dt, Entity ent)
+InputFrame KeyboardMovementController::poll(GLFWwindow* window, float frameTime)
+{
+	InputFrame input{};
+	input.frameTime = frameTime;
+	input.set(InputAction::MoveLeft, glfwGetKey(window, keys.moveLeft) == GLFW_PRESS);
+	input.set(InputAction::MoveRight, glfwGetKey(window, keys.moveRight) == GLFW_PRESS);
+	input.set(InputAction::MoveUp, glfwGetKey(window, keys.moveUp) == GLFW_PRESS);
+	input.set(InputAction::MoveDown, glfwGetKey(window, keys.moveDown) == GLFW_PRESS);
+	input.set(InputAction::RemoveSprite, glfwGetKey(window, keys.removeSprite) == GLFW_PRESS);
+	input.set(InputAction::Save, glfwGetKey(window, keys.save) == GLFW_PRESS);
+	input.set(InputAction::Load, glfwGetKey(window, keys.load) == GLFW_PRESS);
+	input.pressedActions = input.actions & ~previousActions;
+	previousActions = input.actions;
+	return input;
+}
+
+bool KeyboardMovementController::move(const InputFrame& input, float dt, Entity ent)
 {
 	bool updated = false;
 	glm::vec2 moveDir{ 0.0f };
 	
-	if (glfwGetKey(window, keys.moveRight) == GLFW_PRESS) moveDir += glm::vec2(1, 0);
-	if (glfwGetKey(window, keys.moveLeft) == GLFW_PRESS) moveDir -= glm::vec2(1, 0);
-	if (glfwGetKey(window, keys.moveUp) == GLFW_PRESS) moveDir += glm::vec2(0, 1);
-	if (glfwGetKey(window, keys.moveDown) == GLFW_PRESS) moveDir -= glm::vec2(0, 1);
+	if (input.down(InputAction::MoveRight)) moveDir += glm::vec2(1, 0);
+	if (input.down(InputAction::MoveLeft)) moveDir -= glm::vec2(1, 0);
+	if (input.down(InputAction::MoveUp)) moveDir += glm::vec2(0, 1);
+	if (input.down(InputAction::MoveDown)) moveDir -= glm::vec2(0, 1);
 	
 	TransformComponent& tc = ECSCoordiantor->GetComponent<TransformComponent>(ent);
 
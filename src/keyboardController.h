@@ -1,6 +1,7 @@
 #include "engine/window.h"
 #include "engine/ecs/entity_component_system.h"
 #include "engine/ecs/entity_components.h"
+#include "inputRecording.h"
 class KeyboardMovementController {
 public:
 	struct KeyMappings {
@@ -8,12 +9,22 @@ public:
 		int moveRight = GLFW_KEY_D;
 		int moveUp = GLFW_KEY_W;
 		int moveDown = GLFW_KEY_S;
+		int removeSprite = GLFW_KEY_Q;
+		int save = GLFW_KEY_E;
+		int load = GLFW_KEY_T;
 	};
 
+	// Reads every mapped key into one frame of input. The simulation only sees the keyboard through these frames,
+	// so they can be recorded and replayed, see inputRecording.h. Keys down since the previous poll are marked pressed
+	InputFrame poll(GLFWwindow* window, float frameTime);
+
 	//edits value of the TransformComponent of the entity to move
-	bool move(GLFWwindow* window, float dt, Entity ent);
+	bool move(const InputFrame& input, float dt, Entity ent);
 	bool pressed(GLFWwindow* window, int GLFW_KEY);
 
 	KeyMappings keys{};
 	float moveSpeed{ 5.0f };
+
+private:
+	uint8_t previousActions = 0;
 };
\ No newline at end of file
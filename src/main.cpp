@@ -14,13 +14,53 @@
 #include <string>
 #include <vector>
 #include <unordered_set>
+#include <cctype>
 
 #include "engine/window.h"
 #include "engine/device.h"
 #include "App.h"
 
-int main() {
+int main(int argc, char** argv) {
 	App app{};
+	// --physics-benchmark [body count]
+	// --particle-benchmark [particle count]
+	// --gpu-particle-benchmark [particle count]
+	// --save-benchmark
+	// --autosave [interval in seconds]
+	// --recover
+	// --record-input [path]
+	// --replay-input [path]
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--physics-benchmark") {
+			uint32_t bodies = 10000;
+			if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) bodies = static_cast<uint32_t>(std::stoul(argv[++i]));
+			app.setPhysicsBenchmark(bodies);
+		}
+		else if (std::string(argv[i]) == "--particle-benchmark" || std::string(argv[i]) == "--gpu-particle-benchmark") {
+			bool gpu = std::string(argv[i]) == "--gpu-particle-benchmark";
+			uint32_t particles = 1000000;
+			if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) particles = static_cast<uint32_t>(std::stoul(argv[++i]));
+			app.setParticleBenchmark(particles, gpu);
+		}
+		else if (std::string(argv[i]) == "--save-benchmark") {
+			app.setSaveBenchmark(true);
+		}
+		else if (std::string(argv[i]) == "--autosave") {
+			float interval = 5.0f;
+			if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) interval = std::stof(argv[++i]);
+			app.setAutosave(interval);
+		}
+		else if (std::string(argv[i]) == "--recover") {
+			app.setRecover(true);
+		}
+		else if (std::string(argv[i]) == "--record-input" || std::string(argv[i]) == "--replay-input") {
+			bool replay = std::string(argv[i]) == "--replay-input";
+			std::string path = "input.rec";
+			if (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0) path = argv[++i];
+			if (replay) app.setReplayInput(path);
+			else app.setRecordInput(path);
+		}
+	}
 	try {
 		app.run();
 
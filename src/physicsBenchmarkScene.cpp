@@ -0,0 +1,59 @@
+#include "physicsBenchmarkScene.h"
+#include "engine/ecs/entity_components.h"
+
+#include <cmath>
+
+std::vector<Entity> createPhysicsBenchmarkScene(ECS::Coordinator& coordinator, uint32_t bodyCount)
+{
+	const float radius = 0.05f;
+	const float spacing = 2.5f * radius;
+	const float containerHalfWidth = 9.0f;
+
+	// Ground and walls are colliders without a body, the physics system treats them as static
+	auto addWall = [&](glm::vec2 center, glm::vec2 halfExtents) {
+		Entity wall = coordinator.CreateEntity();
+		coordinator.AddComponent(wall, TransformComponent{ center.x, center.y, 0 });
+		coordinator.AddComponent(wall, BoundsComponent{ halfExtents });
+		coordinator.AddComponent(wall, ColliderComponent::MakeAABB(halfExtents));
+	};
+	addWall({ 0.0f, -9.5f }, { containerHalfWidth, 0.5f });
+	addWall({ -containerHalfWidth - 0.5f, 0.0f }, { 0.5f, 10.0f });
+	addWall({ containerHalfWidth + 0.5f, 0.0f }, { 0.5f, 10.0f });
+
+	// Half circles, half boxes, in a grid starting just above the ground
+	uint32_t columns = static_cast<uint32_t>(2.0f * containerHalfWidth / spacing) - 1;
+	auto gridPositions = [&](uint32_t first, uint32_t count) {
+		std::vector<glm::vec2> positions(count);
+		for (uint32_t i = 0; i < count; i++) {
+			uint32_t n = first + i;
+			// Every other row is shifted so the stacks don't stand perfectly upright
+			float shift = (n / columns) % 2 ? 0.5f * radius : 0.0f;
+			positions[i] = { -containerHalfWidth + spacing * (1 + n % columns) + shift, -8.9f + spacing * (n / columns) };
+		}
+		return positions;
+	};
+
+	MassComponent material{};
+	material.mass = 1.0f;
+	material.restitution = 0.1f;
+
+	ECS::Prefab circle = coordinator.CreatePrefab();
+	circle.Add(TransformComponent{}).Add(BoundsComponent{ { radius, radius } }).Add(ColliderComponent::MakeCircle(radius))
+		.Add(VelocityComponent{}).Add(material);
+	ECS::Prefab box = coordinator.CreatePrefab();
+	box.Add(TransformComponent{}).Add(BoundsComponent{ { radius, radius } }).Add(ColliderComponent::MakeAABB({ radius, radius }))
+		.Add(VelocityComponent{}).Add(material);
+
+	uint32_t circleCount = bodyCount / 2;
+	std::vector<glm::vec2> circlePositions = gridPositions(0, circleCount);
+	std::vector<glm::vec2> boxPositions = gridPositions(circleCount, bodyCount - circleCount);
+
+	std::vector<Entity> bodies = coordinator.Instantiate(circle, circleCount, {
+		circle.Patch(&TransformComponent::setTranslation, circlePositions.data())
+	});
+	std::vector<Entity> boxes = coordinator.Instantiate(box, bodyCount - circleCount, {
+		box.Patch(&TransformComponent::setTranslation, boxPositions.data())
+	});
+	bodies.insert(bodies.end(), boxes.begin(), boxes.end());
+	return bodies;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include "engine/ecs/entity_component_system.h"
+
+#include <vector>
+
+// Stress scene for the physics module: bodyCount small circles and boxes dropped into a walled container.
+// Expects TransformComponent, BoundsComponent, ColliderComponent, VelocityComponent and MassComponent to be registered
+std::vector<Entity> createPhysicsBenchmarkScene(ECS::Coordinator& coordinator, uint32_t bodyCount = 10000);
@@ -0,0 +1,95 @@
+#include "saveBenchmark.h"
+#include "engine/ecs/save_format.h"
+#include "engine/compression/crc32c.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+	constexpr int CODEC_ITERATIONS = 20;
+
+	double millisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	double gigabytesPerSecond(uint64_t bytes, double milliseconds)
+	{
+		return milliseconds > 0.0 ? bytes / (milliseconds * 1.0e6) : 0.0;
+	}
+}
+
+void runSaveBenchmark(ECS::Coordinator& coordinator, const char* path)
+{
+	auto start = std::chrono::steady_clock::now();
+	auto snapshot = coordinator.CaptureSnapshot();
+	double captureTime = millisecondsSince(start);
+
+	uint64_t rawBytes = 0;
+	for (auto const& block : snapshot->blocks) rawBytes += block.data->size();
+
+	// Codec alone, every block on the calling thread
+	uint64_t storedBytes = 0;
+	double encodeTime = 0.0;
+	double decodeTime = 0.0;
+	std::vector<char> stored;
+	std::vector<char> decoded;
+	for (auto const& block : snapshot->blocks) {
+		ECS::SaveBlockEntry entry = block.entry;
+		entry.encoding = ECS::SaveBlockEncoding::Lz;
+		entry.filter = ECS::SaveBlockFilter::DeltaShuffle;
+
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < CODEC_ITERATIONS; i++) {
+			entry.encoding = ECS::SaveBlockEncoding::Lz;
+			ECS::EncodeSaveBlock(*block.data, entry, stored);
+		}
+		encodeTime += millisecondsSince(start) / CODEC_ITERATIONS;
+		storedBytes += entry.size;
+		if (entry.encoding == ECS::SaveBlockEncoding::Raw) continue;
+
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < CODEC_ITERATIONS; i++) ECS::DecodeSaveBlock(entry, stored.data(), decoded);
+		decodeTime += millisecondsSince(start) / CODEC_ITERATIONS;
+		if (decoded != *block.data) std::cout << "Save benchmark: block " << block.entry.name << " did not round trip\n";
+	}
+
+	// Whole files, raw and compressed
+	double writeTime[2];
+	double loadTime[2];
+	for (int compressed = 0; compressed < 2; compressed++) {
+		for (auto& block : snapshot->blocks) {
+			block.entry.encoding = compressed ? ECS::SaveBlockEncoding::Lz : ECS::SaveBlockEncoding::Raw;
+		}
+		start = std::chrono::steady_clock::now();
+		ECS::WriteSaveFile(*snapshot, path);
+		writeTime[compressed] = millisecondsSince(start);
+
+		start = std::chrono::steady_clock::now();
+		coordinator.Deserialize(path);
+		loadTime[compressed] = millisecondsSince(start);
+	}
+	std::remove(path);
+
+	// Checksums alone, and the world hash used for desync checks
+	start = std::chrono::steady_clock::now();
+	uint32_t checksum = 0;
+	for (int i = 0; i < CODEC_ITERATIONS; i++) {
+		for (auto const& block : snapshot->blocks) checksum ^= compression::crc32c(block.data->data(), block.data->size());
+	}
+	double checksumTime = millisecondsSince(start) / CODEC_ITERATIONS;
+	start = std::chrono::steady_clock::now();
+	uint32_t hash = 0;
+	for (int i = 0; i < CODEC_ITERATIONS; i++) hash = coordinator.StateHash();
+	double hashTime = millisecondsSince(start) / CODEC_ITERATIONS;
+
+	std::cout << "Save benchmark: " << snapshot->blocks[0].entry.count << " entities, " << rawBytes << " bytes raw, "
+		<< storedBytes << " compressed (" << (storedBytes > 0 ? double(rawBytes) / storedBytes : 0.0) << "x)\n";
+	std::cout << "  capture " << captureTime << "ms, compress " << gigabytesPerSecond(rawBytes, encodeTime)
+		<< " GB/s, decompress " << gigabytesPerSecond(rawBytes, decodeTime) << " GB/s\n";
+	std::cout << "  raw file: write " << writeTime[0] << "ms, load " << loadTime[0] << "ms\n";
+	std::cout << "  compressed file: write " << writeTime[1] << "ms, load " << loadTime[1] << "ms\n";
+	std::cout << "  crc32c " << gigabytesPerSecond(rawBytes, checksumTime) << " GB/s" << (compression::crc32cHardware() ? "" : " (table)")
+		<< ", state hash " << hashTime << "ms (" << std::hex << hash << std::dec << ")\n";
+}
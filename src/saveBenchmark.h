@@ -0,0 +1,6 @@
+#pragma once
+#include "engine/ecs/entity_component_system.h"
+
+// Saves and loads the current world raw and compressed and prints the compression ratio, the codec throughput
+// and the write and load times of both files. The world is reloaded from its own save, so it ends up unchanged
+void runSaveBenchmark(ECS::Coordinator& coordinator, const char* path = "saveBenchmark.dat");